@@ -0,0 +1,706 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Accuracy against speed.
+ *
+ * Every function listed in checks[] is run over random and adversarial
+ * inputs and compared with the same calculation done in double precision.
+ * For each function and class of input this prints
+ *     - the max and mean error in units in the last place (ULP) of the
+ *       float nearest the reference, per component,
+ *     - the max and mean relative error, normwise over the whole result so
+ *       that components that cancel to nearly zero don't swamp it,
+ *     - how many results were NaN or infinite where the reference wasn't,
+ *     - and the time per call of the float function alone.
+ *
+ * Usage: ./accuracy [inputs per class]
+ *
+ * The unit tests check hand-picked cases; this is for deciding whether a
+ * fast path is good enough, so it never fails, it only reports.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "matrix.h"
+
+enum { CHUNK = 4096, MAX_IN = 32, MAX_OUT = 16 };
+
+/*
+ * Classes of input
+ */
+
+enum input_class {
+	UNIFORM,        /* uniform in [-10, 10] */
+	WIDE,           /* random sign and exponent from 2^-60 to 2^60 */
+	DENORMAL,       /* half the values are denormal */
+	DEGENERATE,     /* nearly singular matrices, nearly parallel vectors */
+	NUM_CLASSES,
+};
+
+static const char *class_names[NUM_CLASSES] = {
+	"uniform",
+	"wide",
+	"denormal",
+	"degenerate",
+};
+
+/* How the inputs of a function are laid out, for making degenerate ones */
+enum shape {
+	SHAPE_VECTORS,  /* some number of equal-sized vectors */
+	SHAPE_MATRIX,   /* one or more column-major square matrices */
+	SHAPE_ANGLES,   /* angles in radians */
+};
+
+struct check {
+	const char *name;
+	enum shape shape;
+	int dim;        /* size of the vectors or matrices */
+	int in;         /* floats in */
+	int out;        /* floats out */
+	void (*run)(const float *in, float *out);
+	void (*ref)(const float *in, double *out);
+};
+
+/*
+ * Random numbers: xorshift64*, so that runs are repeatable.
+ */
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15u;
+
+static uint64_t
+rng(void) {
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+
+	return rng_state * 0x2545f4914f6cdd1du;
+}
+
+/* uniform in [0, 1) */
+static double
+rng_unit(void) {
+	return (double) (rng() >> 11) * 0x1.0p-53;
+}
+
+static float
+rng_uniform(float lo, float hi) {
+	return (float) (lo + (hi - lo) * rng_unit());
+}
+
+static float
+rng_sign(void) {
+	return rng() & 1 ? -1.0f : 1.0f;
+}
+
+static float
+rng_wide(void) {
+	return rng_sign() * ldexpf(rng_uniform(1.0f, 2.0f), (int) (rng() % 121) - 60);
+}
+
+static float
+rng_denormal(void) {
+	if (rng() & 1)
+		return rng_sign() * FLT_MIN * rng_uniform(0.0f, 1.0f);
+
+	return rng_uniform(-1.0f, 1.0f);
+}
+
+static void
+generate(const struct check *c, enum input_class class, float *in) {
+	for (int i = 0; i < c->in; i++) {
+		switch (class) {
+		case UNIFORM:
+		case DEGENERATE:
+			in[i] = rng_uniform(-10.0f, 10.0f);
+			break;
+		case WIDE:
+			in[i] = rng_wide();
+			break;
+		case DENORMAL:
+			in[i] = rng_denormal();
+			break;
+		case NUM_CLASSES:
+			break;
+		}
+	}
+
+	if (class != DEGENERATE)
+		return;
+
+	switch (c->shape) {
+	case SHAPE_VECTORS:
+		/* every vector is a tiny perturbation of the first */
+		for (int i = c->dim; i + c->dim <= c->in; i += c->dim) {
+			for (int k = 0; k < c->dim; k++)
+				in[i + k] = in[k] * (1.0f + rng_uniform(-1e-6f, 1e-6f));
+		}
+		break;
+
+	case SHAPE_MATRIX:
+		/* the last column of each is almost a combination of the others */
+		for (int m = 0; m + c->dim * c->dim <= c->in; m += c->dim * c->dim) {
+			float *last = in + m + (c->dim - 1) * c->dim;
+
+			for (int k = 0; k < c->dim; k++) {
+				float sum = 0.0f;
+
+				for (int j = 0; j < c->dim - 1; j++)
+					sum += in[m + j * c->dim + k] * (float) (j + 1);
+
+				last[k] = sum * (1.0f + rng_uniform(-1e-6f, 1e-6f));
+			}
+		}
+		break;
+
+	case SHAPE_ANGLES:
+		/* close to multiples of pi/4, where the range reduction is hardest */
+		for (int i = 0; i < c->in; i++)
+			in[i] = (float) (((double) (rng() % 20001) - 10000.0) * 0.78539816339744830962) + rng_uniform(-1e-4f, 1e-4f);
+		break;
+	}
+}
+
+/*
+ * Reference implementations, in double precision
+ */
+
+static void
+ref_matrix_mult(int n, const double *a, const double *b, double *out) {
+	for (int col = 0; col < n; col++) {
+		for (int row = 0; row < n; row++) {
+			double sum = 0.0;
+
+			for (int k = 0; k < n; k++)
+				sum += a[k * n + row] * b[col * n + k];
+
+			out[col * n + row] = sum;
+		}
+	}
+}
+
+/* Gaussian elimination with partial pivoting; returns the determinant */
+static double
+ref_invert(int n, const double *m, double *inv) {
+	double a[4][8];
+	double det = 1.0;
+
+	for (int row = 0; row < n; row++) {
+		for (int col = 0; col < n; col++) {
+			a[row][col] = m[col * n + row];
+			a[row][n + col] = row == col;
+		}
+	}
+
+	for (int k = 0; k < n; k++) {
+		int pivot = k;
+
+		for (int row = k + 1; row < n; row++) {
+			if (fabs(a[row][k]) > fabs(a[pivot][k]))
+				pivot = row;
+		}
+
+		if (pivot != k) {
+			for (int col = 0; col < 2 * n; col++) {
+				const double t = a[k][col];
+				a[k][col] = a[pivot][col];
+				a[pivot][col] = t;
+			}
+			det = -det;
+		}
+
+		det *= a[k][k];
+
+		if (fabs(a[k][k]) < DBL_MIN)
+			return 0.0;
+
+		for (int row = 0; row < n; row++) {
+			if (row == k)
+				continue;
+
+			const double f = a[row][k] / a[k][k];
+
+			for (int col = k; col < 2 * n; col++)
+				a[row][col] -= f * a[k][col];
+		}
+	}
+
+	if (inv != NULL) {
+		for (int row = 0; row < n; row++) {
+			for (int col = 0; col < n; col++)
+				inv[col * n + row] = a[row][n + col] / a[row][row];
+		}
+	}
+
+	return det;
+}
+
+static void
+widen(const float *in, double *out, int n) {
+	for (int i = 0; i < n; i++)
+		out[i] = in[i];
+}
+
+static vec3
+load3(const float *in) {
+	return vec3(in[0], in[1], in[2]);
+}
+
+static vec4
+load4(const float *in) {
+	return vec4(in[0], in[1], in[2], in[3]);
+}
+
+static mat3
+load_m3(const float *in) {
+	return mat3(in[0], in[1], in[2], in[3], in[4], in[5], in[6], in[7], in[8]);
+}
+
+static mat4
+load_m4(const float *in) {
+	return mat4(load4(in), load4(in + 4), load4(in + 8), load4(in + 12));
+}
+
+static void
+store_m4(mat4 m, float *out) {
+	for (int col = 0; col < 4; col++) {
+		for (int row = 0; row < 4; row++)
+			out[col * 4 + row] = m.cols[col]._v[row];
+	}
+}
+
+/*
+ * The checks
+ */
+
+static void
+run_dotv4(const float *in, float *out) {
+	out[0] = dot(load4(in), load4(in + 4));
+}
+
+static void
+ref_dotv4(const float *in, double *out) {
+	double a[8];
+	widen(in, a, 8);
+	out[0] = a[0] * a[4] + a[1] * a[5] + a[2] * a[6] + a[3] * a[7];
+}
+
+static void
+run_lengthv4(const float *in, float *out) {
+	out[0] = length(load4(in));
+}
+
+static void
+ref_lengthv4(const float *in, double *out) {
+	double a[4];
+	widen(in, a, 4);
+	out[0] = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2] + a[3] * a[3]);
+}
+
+static void
+run_normalizev3(const float *in, float *out) {
+	const vec3 v = normalize(load3(in));
+
+	out[0] = v.x;
+	out[1] = v.y;
+	out[2] = v.z;
+}
+
+static void
+ref_normalizev3(const float *in, double *out) {
+	double a[3];
+	widen(in, a, 3);
+
+	const double len = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+
+	for (int i = 0; i < 3; i++)
+		out[i] = a[i] / len;
+}
+
+static void
+run_cross(const float *in, float *out) {
+	const vec3 v = cross(load3(in), load3(in + 3));
+
+	out[0] = v.x;
+	out[1] = v.y;
+	out[2] = v.z;
+}
+
+static void
+ref_cross(const float *in, double *out) {
+	double a[6];
+	widen(in, a, 6);
+
+	out[0] = a[1] * a[5] - a[2] * a[4];
+	out[1] = a[2] * a[3] - a[0] * a[5];
+	out[2] = a[0] * a[4] - a[1] * a[3];
+}
+
+static void
+run_mixv4(const float *in, float *out) {
+	const vec4 v = mix(load4(in), load4(in + 4), fabsf(fmodf(in[8], 1.0f)));
+
+	for (int i = 0; i < 4; i++)
+		out[i] = v._v[i];
+}
+
+static void
+ref_mixv4(const float *in, double *out) {
+	const double t = fabsf(fmodf(in[8], 1.0f));
+
+	for (int i = 0; i < 4; i++)
+		out[i] = (double) in[i] * (1.0 - t) + (double) in[i + 4] * t;
+}
+
+static void
+run_multm4(const float *in, float *out) {
+	store_m4(mult(load_m4(in), load_m4(in + 16)), out);
+}
+
+static void
+ref_multm4(const float *in, double *out) {
+	double a[32];
+	widen(in, a, 32);
+	ref_matrix_mult(4, a, a + 16, out);
+}
+
+static void
+run_determinantm3(const float *in, float *out) {
+	out[0] = determinant(load_m3(in));
+}
+
+static void
+ref_determinantm3(const float *in, double *out) {
+	double a[9];
+	widen(in, a, 9);
+	out[0] = ref_invert(3, a, NULL);
+}
+
+static void
+run_determinantm4(const float *in, float *out) {
+	out[0] = determinant(load_m4(in));
+}
+
+static void
+ref_determinantm4(const float *in, double *out) {
+	double a[16];
+	widen(in, a, 16);
+	out[0] = ref_invert(4, a, NULL);
+}
+
+static void
+run_inversem4(const float *in, float *out) {
+	store_m4(inverse(load_m4(in)), out);
+}
+
+static void
+ref_inversem4(const float *in, double *out) {
+	double a[16];
+	widen(in, a, 16);
+
+	if (!(fabs(ref_invert(4, a, out)) > 0.0)) {
+		for (int i = 0; i < 16; i++)
+			out[i] = NAN;
+	}
+}
+
+static void
+run_sincosv4(const float *in, float *out) {
+	vec4 s, c;
+
+	sincosv4(load4(in), &s, &c);
+
+	for (int i = 0; i < 4; i++) {
+		out[i] = s._v[i];
+		out[i + 4] = c._v[i];
+	}
+}
+
+static void
+run_libm_sincos(const float *in, float *out) {
+	for (int i = 0; i < 4; i++) {
+		out[i] = sinf(in[i]);
+		out[i + 4] = cosf(in[i]);
+	}
+}
+
+static void
+ref_sincos(const float *in, double *out) {
+	for (int i = 0; i < 4; i++) {
+		out[i] = sin((double) in[i]);
+		out[i + 4] = cos((double) in[i]);
+	}
+}
+
+static void
+run_eulerm3(const float *in, float *out) {
+	const vec3 angles = load3(in);
+	mat3 m;
+
+	eulerm3_array(&m, &angles, 1);
+
+	for (int col = 0; col < 3; col++) {
+		for (int row = 0; row < 3; row++)
+			out[col * 3 + row] = m.cols[col]._v[row];
+	}
+}
+
+static void
+ref_eulerm3(const float *in, double *out) {
+	const double sx = sin((double) in[0]), cx = cos((double) in[0]);
+	const double sy = sin((double) in[1]), cy = cos((double) in[1]);
+	const double sz = sin((double) in[2]), cz = cos((double) in[2]);
+
+	const double m[9] = {
+		cz * cy, sz * cy, -sy,
+		cz * sy * sx - sz * cx, sz * sy * sx + cz * cx, cy * sx,
+		cz * sy * cx + sz * sx, sz * sy * cx - cz * sx, cy * cx,
+	};
+
+	for (int i = 0; i < 9; i++)
+		out[i] = m[i];
+}
+
+/* Only the upper triangle of in is used, as in eigensymm3_array() */
+static void
+run_eigensymm3(const float *in, float *out) {
+	const mat3 m = load_m3(in);
+	vec3 values;
+	mat3 vectors;
+
+	eigensymm3_array(&values, &vectors, &m, 1);
+
+	for (int i = 0; i < 3; i++)
+		out[i] = values._v[i];
+}
+
+/* Cyclic Jacobi in double, run until nothing is left off the diagonal */
+static void
+ref_eigensymm3(const float *in, double *out) {
+	double a[3][3];
+
+	for (int col = 0; col < 3; col++) {
+		for (int row = 0; row <= col; row++)
+			a[row][col] = a[col][row] = in[col * 3 + row];
+	}
+
+	for (int sweep = 0; sweep < 50; sweep++) {
+		const double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+
+		if (!(off > 0.0))
+			break;
+
+		for (int p = 0; p < 2; p++) {
+			for (int q = p + 1; q < 3; q++) {
+				if (!(fabs(a[p][q]) > 0.0))
+					continue;
+
+				const double tau = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+				const double t = (tau >= 0.0 ? 1.0 : -1.0) / (fabs(tau) + sqrt(1.0 + tau * tau));
+				const double c = 1.0 / sqrt(1.0 + t * t), s = t * c;
+
+				/* A = J^T A J, all of it */
+				for (int k = 0; k < 3; k++) {
+					const double kp = a[k][p], kq = a[k][q];
+					a[k][p] = c * kp - s * kq;
+					a[k][q] = s * kp + c * kq;
+				}
+				for (int k = 0; k < 3; k++) {
+					const double pk = a[p][k], qk = a[q][k];
+					a[p][k] = c * pk - s * qk;
+					a[q][k] = s * pk + c * qk;
+				}
+			}
+		}
+	}
+
+	/* largest first */
+	double v[3] = { a[0][0], a[1][1], a[2][2] };
+
+	for (int i = 0; i < 3; i++) {
+		for (int j = i + 1; j < 3; j++) {
+			if (v[j] > v[i]) {
+				const double t = v[i];
+				v[i] = v[j];
+				v[j] = t;
+			}
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+		out[i] = v[i];
+}
+
+static const struct check checks[] = {
+	{ "dotv4",           SHAPE_VECTORS, 4,  8,  1, run_dotv4,         ref_dotv4 },
+	{ "lengthv4",        SHAPE_VECTORS, 4,  4,  1, run_lengthv4,      ref_lengthv4 },
+	{ "normalizev3",     SHAPE_VECTORS, 3,  3,  3, run_normalizev3,   ref_normalizev3 },
+	{ "cross",           SHAPE_VECTORS, 3,  6,  3, run_cross,         ref_cross },
+	{ "mixv4",           SHAPE_VECTORS, 4,  9,  4, run_mixv4,         ref_mixv4 },
+	{ "multm4",          SHAPE_MATRIX,  4, 32, 16, run_multm4,        ref_multm4 },
+	{ "determinantm3",   SHAPE_MATRIX,  3,  9,  1, run_determinantm3, ref_determinantm3 },
+	{ "determinantm4",   SHAPE_MATRIX,  4, 16,  1, run_determinantm4, ref_determinantm4 },
+	{ "inversem4",       SHAPE_MATRIX,  4, 16, 16, run_inversem4,     ref_inversem4 },
+	{ "sincosv4",        SHAPE_ANGLES,  4,  4,  8, run_sincosv4,      ref_sincos },
+	{ "sinf, cosf",      SHAPE_ANGLES,  4,  4,  8, run_libm_sincos,   ref_sincos },
+	{ "eulerm3_array",   SHAPE_ANGLES,  3,  3,  9, run_eulerm3,       ref_eulerm3 },
+	{ "eigensymm3_array", SHAPE_MATRIX, 3,  9,  3, run_eigensymm3,    ref_eigensymm3 },
+};
+
+/*
+ * Measuring
+ */
+
+struct errors {
+	double max_ulp, sum_ulp;
+	double max_rel, sum_rel;
+	size_t compared;        /* results where the reference is finite */
+	size_t nonfinite;       /* of those, where the float result isn't */
+	double seconds;
+};
+
+static double
+now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/* The size of one unit in the last place of the float nearest x */
+static double
+ulp(double x) {
+	const float f = (float) fabs(x);
+
+	if (f < FLT_MIN)
+		return 0x1.0p-149;
+
+	return nextafterf(f, INFINITY) - f;
+}
+
+static void
+compare(const struct check *c, const float *out, const double *ref, struct errors *e) {
+	double norm = 0.0, diff = 0.0;
+
+	for (int i = 0; i < c->out; i++) {
+		/* no float could get this right, so don't count it */
+		if (!isfinite(ref[i]) || !isfinite((float) ref[i]))
+			return;
+	}
+
+	e->compared++;
+
+	for (int i = 0; i < c->out; i++) {
+		if (!isfinite(out[i])) {
+			e->nonfinite++;
+			return;
+		}
+	}
+
+	for (int i = 0; i < c->out; i++) {
+		const double err = fabs((double) out[i] - ref[i]);
+		const double u = err / ulp(ref[i]);
+
+		e->sum_ulp += u / c->out;
+		if (u > e->max_ulp)
+			e->max_ulp = u;
+
+		norm = fmax(norm, fabs(ref[i]));
+		diff = fmax(diff, err);
+	}
+
+	const double rel = norm > 0.0 ? diff / norm : diff;
+
+	e->sum_rel += rel;
+	if (rel > e->max_rel)
+		e->max_rel = rel;
+}
+
+static void
+measure(const struct check *c, enum input_class class, size_t count, struct errors *e) {
+	static float in[CHUNK][MAX_IN];
+	static float out[CHUNK][MAX_OUT];
+	double ref[MAX_OUT];
+
+	*e = (struct errors) { 0 };
+
+	for (size_t done = 0; done < count; done += CHUNK) {
+		const size_t n = count - done < CHUNK ? count - done : CHUNK;
+
+		for (size_t i = 0; i < n; i++)
+			generate(c, class, in[i]);
+
+		const double start = now();
+
+		for (size_t i = 0; i < n; i++)
+			c->run(in[i], out[i]);
+
+		e->seconds += now() - start;
+
+		for (size_t i = 0; i < n; i++) {
+			c->ref(in[i], ref);
+			compare(c, out[i], ref, e);
+		}
+	}
+}
+
+int
+main(int argc, char **argv) {
+	const size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+
+	printf("%zu inputs per class\n\n", count);
+	printf("%-16s %-10s %12s %10s %12s %12s %9s %9s\n",
+		"function", "inputs", "max ulp", "mean ulp", "max rel", "mean rel", "nonfinite", "ns/call");
+
+	for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+		for (int class = 0; class < NUM_CLASSES; class++) {
+			struct errors e;
+
+			measure(&checks[i], class, count, &e);
+
+			/* the errors are over the finite results; with none there are none to show */
+			if (e.compared <= e.nonfinite) {
+				printf("%-16s %-10s %12s %10s %12s %12s %9zu %9.2f\n",
+					checks[i].name,
+					class_names[class],
+					"-", "-", "-", "-",
+					e.nonfinite,
+					e.seconds * 1e9 / (double) count);
+				continue;
+			}
+
+			const double compared = (double) (e.compared - e.nonfinite);
+
+			printf("%-16s %-10s %12.4g %10.3g %12.4g %12.4g %9zu %9.2f\n",
+				checks[i].name,
+				class_names[class],
+				e.max_ulp,
+				e.sum_ulp / compared,
+				e.max_rel,
+				e.sum_rel / compared,
+				e.nonfinite,
+				e.seconds * 1e9 / (double) count);
+		}
+	}
+}
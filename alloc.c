@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+
+static_assert(ALLOC_ALIGNMENT % _Alignof(mat4) == 0, "alignment too small for the types");
+
+/* Round up to the alignment, or 0 if that overflows */
+static size_t
+round_up(size_t size) {
+	if (size > SIZE_MAX - (ALLOC_ALIGNMENT - 1))
+		return 0;
+
+	return (size + ALLOC_ALIGNMENT - 1) & ~(size_t) (ALLOC_ALIGNMENT - 1);
+}
+
+void *
+alloc_aligned(size_t size) {
+	/* aligned_alloc() wants a multiple of the alignment, and never 0 */
+	const size_t rounded = round_up(size > 0 ? size : 1);
+
+	return rounded > 0 ? aligned_alloc(ALLOC_ALIGNMENT, rounded) : NULL;
+}
+
+void
+alloc_free(void *p) {
+	free(p);
+}
+
+void *
+alloc_aligned_array(size_t size, size_t n) {
+	if (size > 0 && n > SIZE_MAX / size)
+		return NULL;
+
+	return alloc_aligned(size * n);
+}
+
+/*
+ * Arenas
+ */
+
+int
+arena_init(struct arena *a, size_t size) {
+	*a = (struct arena) { 0 };
+
+	a->base = alloc_aligned(size);
+	if (a->base == NULL)
+		return -1;
+
+	a->size = size;
+	return 0;
+}
+
+void
+arena_destroy(struct arena *a) {
+	alloc_free(a->base);
+	*a = (struct arena) { 0 };
+}
+
+void *
+arena_alloc(struct arena *a, size_t size) {
+	const size_t rounded = round_up(size);
+
+	/* comparing against what's left can't overflow */
+	if (rounded < size || rounded > a->size - a->used)
+		return NULL;
+
+	void *p = a->base + a->used;
+
+	a->used += rounded;
+	if (a->used > a->peak)
+		a->peak = a->used;
+
+	return p;
+}
+
+void *
+arena_alloc_array(struct arena *a, size_t size, size_t n) {
+	if (size > 0 && n > SIZE_MAX / size)
+		return NULL;
+
+	return arena_alloc(a, size * n);
+}
+
+void
+arena_reset(struct arena *a) {
+	a->used = 0;
+}
+
+/*
+ * Pools
+ *
+ * Free objects hold the pointer to the next free one. The objects that have
+ * never been handed out aren't on the list, they are taken from the end, so
+ * that setting up a pool doesn't touch all of its memory.
+ */
+
+int
+pool_init(struct pool *p, size_t size, size_t capacity) {
+	*p = (struct pool) { 0 };
+
+	const size_t rounded = round_up(size > sizeof(void *) ? size : sizeof(void *));
+
+	if (rounded == 0 || (capacity > 0 && rounded > SIZE_MAX / capacity))
+		return -1;
+
+	p->base = alloc_aligned(rounded * capacity);
+	if (p->base == NULL)
+		return -1;
+
+	p->size = rounded;
+	p->capacity = capacity;
+	p->unused = capacity;
+
+	return 0;
+}
+
+void
+pool_destroy(struct pool *p) {
+	alloc_free(p->base);
+	*p = (struct pool) { 0 };
+}
+
+void *
+pool_alloc(struct pool *p) {
+	void *object;
+
+	if (p->free_list != NULL) {
+		object = p->free_list;
+		p->free_list = *(void **) object;
+	} else if (p->unused > 0) {
+		object = p->base + p->size * (p->capacity - p->unused);
+		p->unused--;
+	} else {
+		return NULL;
+	}
+
+	p->used++;
+	if (p->used > p->peak)
+		p->peak = p->used;
+
+	return object;
+}
+
+void
+pool_free(struct pool *p, void *object) {
+	if (object == NULL)
+		return;
+
+	assert((unsigned char *) object >= p->base
+		&& (size_t) ((unsigned char *) object - p->base) < p->size * p->capacity);
+
+	*(void **) object = p->free_list;
+	p->free_list = object;
+	p->used--;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Aligned memory for arrays of vectors and matrices.
+ *
+ * vec4 and mat4 hold v4f_t, which must be 16 byte aligned, and a malloc()
+ * that only promises 8 bytes (or a cast from a float array) gives faulting
+ * or split loads. Everything here is aligned to ALLOC_ALIGNMENT, a cache
+ * line, which also covers 32 byte AVX loads and keeps arrays handed to
+ * different threads off each other's cache lines.
+ *
+ * There are three ways to get it:
+ *
+ *  - alloc_array() for long-lived arrays, released with alloc_free().
+ *
+ *  - An arena for temporary arrays: a fixed block that is handed out from
+ *    the front and taken back all at once with arena_reset(), e.g. at the
+ *    end of each frame. Nothing is freed individually.
+ *
+ *  - A pool for many objects of one size that come and go in any order.
+ *
+ * Arenas and pools never grow, so their pointers stay valid until a reset,
+ * and they return NULL when they are full. Both record their peak use, which
+ * is what to size them by. None of them are thread safe: use one per thread.
+ */
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ALLOC_ALIGNMENT 64
+
+/* size bytes, or NULL if there isn't enough memory */
+void *alloc_aligned(size_t size);
+void alloc_free(void *p);
+
+/* n elements of TYPE, or NULL, e.g. mat4 *m = alloc_array(mat4, n); */
+#define alloc_array(TYPE, N) ((TYPE *) alloc_aligned_array(sizeof(TYPE), (N)))
+void *alloc_aligned_array(size_t size, size_t n);
+
+/*
+ * Arenas
+ */
+
+struct arena {
+	unsigned char *base;
+	size_t size;
+	size_t used;
+	size_t peak;
+};
+
+/* 0 on success, -1 if there isn't enough memory */
+int arena_init(struct arena *a, size_t size);
+void arena_destroy(struct arena *a);
+
+/* size bytes, or NULL if the arena is full */
+void *arena_alloc(struct arena *a, size_t size);
+
+/* e.g. vec4 *tmp = arena_array(&frame, vec4, n); */
+#define arena_array(A, TYPE, N) ((TYPE *) arena_alloc_array((A), sizeof(TYPE), (N)))
+void *arena_alloc_array(struct arena *a, size_t size, size_t n);
+
+/* Take back everything, keeping the peak */
+void arena_reset(struct arena *a);
+
+/*
+ * Pools
+ */
+
+struct pool {
+	unsigned char *base;
+	size_t size;            /* of each object, rounded up to the alignment */
+	size_t capacity;
+
+	void *free_list;
+	size_t unused;          /* objects past the end of those ever handed out */
+
+	size_t used;
+	size_t peak;
+};
+
+/* 0 on success, -1 if there isn't enough memory */
+int pool_init(struct pool *p, size_t size, size_t capacity);
+void pool_destroy(struct pool *p);
+
+/* One object, or NULL if the pool is full */
+void *pool_alloc(struct pool *p);
+void pool_free(struct pool *p, void *object);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "anim.h"
+#include "profile.h"
+#include "simd.h"
+
+/* What a track with no keys holds */
+static const vec4 identity[ANIM_CHANNELS] = {
+	[ANIM_TRANSLATION] = {{ 0.0f, 0.0f, 0.0f, 0.0f }},
+	[ANIM_ROTATION] = {{ 0.0f, 0.0f, 0.0f, 1.0f }},
+	[ANIM_SCALE] = {{ 1.0f, 1.0f, 1.0f, 0.0f }},
+};
+
+int
+anim_clip_init(struct anim_clip *c, size_t bones, size_t keys, enum anim_interpolation rotation) {
+	*c = (struct anim_clip) {
+		.bones = bones,
+		.rotation = rotation,
+		.capacity = keys,
+	};
+
+	if (bones > SIZE_MAX / ANIM_CHANNELS || keys > UINT32_MAX)
+		return -1;
+
+	const size_t tracks = bones * ANIM_CHANNELS;
+
+	c->first = alloc_array(uint32_t, tracks);
+	c->count = alloc_array(uint32_t, tracks);
+	c->cursor = alloc_array(uint32_t, tracks);
+	c->times = alloc_array(float, keys);
+	c->values = alloc_array(vec4, keys);
+
+	if (c->first == NULL || c->count == NULL || c->cursor == NULL || c->times == NULL || c->values == NULL) {
+		anim_clip_destroy(c);
+		return -1;
+	}
+
+	memset(c->count, 0, tracks * sizeof(uint32_t));
+	memset(c->cursor, 0, tracks * sizeof(uint32_t));
+
+	return 0;
+}
+
+void
+anim_clip_destroy(struct anim_clip *c) {
+	alloc_free(c->first);
+	alloc_free(c->count);
+	alloc_free(c->cursor);
+	alloc_free(c->times);
+	alloc_free(c->values);
+
+	*c = (struct anim_clip) { 0 };
+}
+
+int
+anim_clip_track(struct anim_clip *c, size_t bone, enum anim_channel channel,
+		const float *times, const vec4 *values, size_t count) {
+	const size_t track = bone * ANIM_CHANNELS + channel;
+
+	if (bone >= c->bones || channel >= ANIM_CHANNELS || c->count[track] != 0 || count > c->capacity - c->keys)
+		return -1;
+
+	memcpy(c->times + c->keys, times, count * sizeof(float));
+	memcpy(c->values + c->keys, values, count * sizeof(vec4));
+
+	c->first[track] = (uint32_t) c->keys;
+	c->count[track] = (uint32_t) count;
+	c->cursor[track] = 0;
+	c->keys += count;
+
+	return 0;
+}
+
+/*
+ * The keys either side of the time, and how far between them it is. The
+ * cursor is the last key at or before the time, or 0 before the first.
+ */
+static inline float
+track_keys(struct anim_clip *c, size_t track, float time, const vec4 **a, const vec4 **b) {
+	const uint32_t count = c->count[track];
+
+	if (count == 0) {
+		*a = *b = &identity[track % ANIM_CHANNELS];
+		return 0.0f;
+	}
+
+	const float *t = c->times + c->first[track];
+	const vec4 *v = c->values + c->first[track];
+	uint32_t k = c->cursor[track];
+
+	if (time < t[k]) {
+		/* backwards: search [0, k) for the last key at or before the time */
+		uint32_t lo = 0, hi = k;
+
+		while (lo < hi) {
+			const uint32_t mid = lo + (hi - lo) / 2;
+
+			if (t[mid] <= time)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		k = lo > 0 ? lo - 1 : 0;
+	} else {
+		/* forwards, usually no more than a key or two */
+		while (k + 1 < count && t[k + 1] <= time)
+			k++;
+	}
+
+	c->cursor[track] = k;
+
+	if (time <= t[k] || k + 1 == count) {
+		*a = *b = &v[k];
+		return 0.0f;
+	}
+
+	*a = &v[k];
+	*b = &v[k + 1];
+
+	return (time - t[k]) / (t[k + 1] - t[k]);
+}
+
+static inline void
+load_lanes(v4f_t out[4], const vec4 *v[4]) {
+	v4f_t v0 = v[0]->_v, v1 = v[1]->_v, v2 = v[2]->_v, v3 = v[3]->_v;
+
+	v4f_transpose(&v0, &v1, &v2, &v3);
+
+	out[0] = v0;
+	out[1] = v1;
+	out[2] = v2;
+	out[3] = v3;
+}
+
+/* Rotations from a to b, a component per vector and a rotation per lane */
+static inline void
+interpolate_rotations(v4f_t r[4], const v4f_t a[4], v4f_t b[4], v4f_t u, enum anim_interpolation how) {
+	v4f_t d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+
+	/* q and -q are the same rotation: take the short way round */
+	const v4u_t flip = (v4u_t) d & (v4u_t) v4f_splat(-0.0f);
+
+	for (int j = 0; j < 4; j++)
+		b[j] = (v4f_t) ((v4u_t) b[j] ^ flip);
+	d = v4f_abs(d);
+
+	v4f_t wa = 1.0f - u, wb = u;
+
+	if (how == ANIM_SLERP) {
+		/* close together, slerp is nlerp and the division below isn't safe */
+		const v4i_t near = d > 0.9995f;
+
+		const v4f_t theta = {
+			acosf(fminf(d[0], 1.0f)), acosf(fminf(d[1], 1.0f)),
+			acosf(fminf(d[2], 1.0f)), acosf(fminf(d[3], 1.0f)),
+		};
+
+		v4f_t sin_theta, sin_a, sin_b, unused;
+		v4f_sincos(theta, &sin_theta, &unused);
+		v4f_sincos((1.0f - u) * theta, &sin_a, &unused);
+		v4f_sincos(u * theta, &sin_b, &unused);
+
+		const v4f_t inv = 1.0f / v4f_select(near, v4f_splat(1.0f), sin_theta);
+
+		wa = v4f_select(near, wa, sin_a * inv);
+		wb = v4f_select(near, wb, sin_b * inv);
+	}
+
+	for (int j = 0; j < 4; j++)
+		r[j] = a[j] * wa + b[j] * wb;
+
+	/* needed for nlerp, and cleans up rounding for slerp */
+	const v4f_t len = v4f_sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + r[3] * r[3]);
+
+	for (int j = 0; j < 4; j++)
+		r[j] /= len;
+}
+
+/* Sample bones [i, i + count), count <= 4, into out[0] to out[count - 1] */
+static inline void
+sample_block(struct anim_clip *c, size_t i, size_t count, float time, struct trs *out) {
+	for (int channel = 0; channel < ANIM_CHANNELS; channel++) {
+		const vec4 *a[4], *b[4];
+		v4f_t u = { 0.0f };
+
+		for (size_t k = 0; k < 4; k++) {
+			if (k < count)
+				u[k] = track_keys(c, (i + k) * ANIM_CHANNELS + channel, time, &a[k], &b[k]);
+			else
+				a[k] = b[k] = &identity[channel];
+		}
+
+		v4f_t va[4], vb[4], r[4];
+		load_lanes(va, a);
+		load_lanes(vb, b);
+
+		if (channel == ANIM_ROTATION) {
+			interpolate_rotations(r, va, vb, u, c->rotation);
+		} else {
+			for (int j = 0; j < 3; j++)
+				r[j] = va[j] + (vb[j] - va[j]) * u;
+			r[3] = v4f_splat(0.0f);
+		}
+
+		v4f_transpose(&r[0], &r[1], &r[2], &r[3]);
+
+		for (size_t k = 0; k < count; k++) {
+			switch (channel) {
+			case ANIM_TRANSLATION: out[k].translation._v = r[k]; break;
+			case ANIM_ROTATION: out[k].rotation._v = r[k]; break;
+			case ANIM_SCALE: out[k].scale._v = r[k]; break;
+			}
+		}
+	}
+}
+
+void
+anim_sample_trs(struct anim_clip *c, float time, struct trs *out) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < c->bones; i += 4)
+		sample_block(c, i, BLOCK_COUNT(i, c->bones), time, out + i);
+}
+
+void
+anim_sample_mat4(struct anim_clip *c, float time, mat4 *out) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < c->bones; i += 4) {
+		const size_t count = BLOCK_COUNT(i, c->bones);
+		struct trs pose[4];
+
+		sample_block(c, i, count, time, pose);
+		trs_compose_array(out + i, pose, count);
+	}
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Keyframed animation of many bones.
+ *
+ * A clip has a translation, rotation and scale track for each bone. The keys
+ * of all the tracks are kept in one array, each track's together, and each
+ * track remembers the key it was last sampled at. Playing forwards, finding
+ * the keys either side of the time is then a step or two from there rather
+ * than a binary search; jumping backwards falls back to the search.
+ *
+ * Translation and scale are interpolated linearly, rotation by nlerp or
+ * slerp, four bones at a time in the lanes of a vector. Before the first key
+ * a track holds its first value and after the last its last. A track with no
+ * keys holds the identity.
+ *
+ *     struct anim_clip clip;
+ *
+ *     anim_clip_init(&clip, bones, keys, ANIM_SLERP);
+ *     anim_clip_track(&clip, bone, ANIM_ROTATION, times, rotations, count);
+ *     ...
+ *     anim_sample_mat4(&clip, t, pose);
+ */
+
+#ifndef ANIM_H
+#define ANIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matrix.h"
+#include "trs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum anim_channel {
+	ANIM_TRANSLATION,
+	ANIM_ROTATION,
+	ANIM_SCALE,
+	ANIM_CHANNELS,
+};
+
+enum anim_interpolation {
+	ANIM_NLERP,     /* normalised lerp: faster, but not at constant speed */
+	ANIM_SLERP,
+};
+
+struct anim_clip {
+	size_t bones;
+	enum anim_interpolation rotation;
+
+	/* for each track, bone * ANIM_CHANNELS + channel */
+	uint32_t *first;
+	uint32_t *count;
+	uint32_t *cursor;
+
+	/* the keys of all the tracks */
+	float *times;
+	vec4 *values;
+	size_t keys;
+	size_t capacity;
+};
+
+/* Room for the given number of keys in all: 0 on success, -1 if there isn't enough memory */
+int anim_clip_init(struct anim_clip *c, size_t bones, size_t keys, enum anim_interpolation rotation);
+void anim_clip_destroy(struct anim_clip *c);
+
+/*
+ * Copy in the keys of one track, with times in increasing order.
+ * Translations and scales are the xyz of the values, rotations are unit
+ * quaternions. Returns -1 if the clip is out of room or the track already has
+ * keys, otherwise 0.
+ */
+int anim_clip_track(struct anim_clip *c, size_t bone, enum anim_channel channel,
+	const float *times, const vec4 *values, size_t count);
+
+/* The pose of every bone at the given time */
+void anim_sample_trs(struct anim_clip *c, float time, struct trs *out);
+void anim_sample_mat4(struct anim_clip *c, float time, mat4 *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1019 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmarks of the batched kernels against the obvious scalar code.
+ *
+ * Each benchmark runs its body over the same arrays enough times to take a
+ * measurable amount of time, and reports nanoseconds per element. The
+ * results are summed into a checksum so the work can't be optimised away.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "matrix.h"
+#include "mesh.h"
+#include "anim.h"
+#include "depth.h"
+#include "jobs.h"
+#include "normal.h"
+#include "obb.h"
+#include "palette.h"
+#include "profile.h"
+#include "stream.h"
+#include "transforms.h"
+#include "trs.h"
+
+enum { N = 4096, REPS = 500 };
+
+static volatile float sink;
+
+static double
+now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static void
+report(const char *name, double seconds, size_t elements) {
+	printf("%-36s %8.2f ns/element\n", name, seconds * 1e9 / (double) elements);
+}
+
+#define BENCH(NAME, ELEMENTS, BODY) do {                               \
+		const double start_ = now();                           \
+		for (int rep_ = 0; rep_ < REPS; rep_++) {              \
+			BODY;                                          \
+		}                                                      \
+		report(NAME, now() - start_, (size_t) (ELEMENTS) * REPS); \
+	} while (0)
+
+static float
+frand(float lo, float hi) {
+	return lo + (hi - lo) * ((float) rand() / (float) RAND_MAX);
+}
+
+/*
+ * Sines and rotations
+ */
+
+static mat3
+scalar_euler(vec3 a) {
+	const float sx = sinf(a.x), cx = cosf(a.x);
+	const float sy = sinf(a.y), cy = cosf(a.y);
+	const float sz = sinf(a.z), cz = cosf(a.z);
+
+	return mat3(
+		cz * cy, sz * cy, -sy,
+		cz * sy * sx - sz * cx, sz * sy * sx + cz * cx, cy * sx,
+		cz * sy * cx + sz * sx, sz * sy * cx - cz * sx, cy * cx
+	);
+}
+
+static mat3
+scalar_axis_angle(vec3 axis, float angle) {
+	const float s = sinf(angle), c = cosf(angle), t = 1.0f - c;
+	const float x = axis.x, y = axis.y, z = axis.z;
+
+	return mat3(
+		t * x * x + c, t * x * y + s * z, t * x * z - s * y,
+		t * x * y - s * z, t * y * y + c, t * y * z + s * x,
+		t * x * z + s * y, t * y * z - s * x, t * z * z + c
+	);
+}
+
+static void
+bench_rotations(void) {
+	static float x[N], s[N], c[N], angle[N];
+	static vec3 angles[N], axes[N];
+	static mat3 m3[N];
+	static quat q[N];
+
+	for (int i = 0; i < N; i++) {
+		x[i] = frand(-10.0f, 10.0f);
+		angle[i] = frand(-3.2f, 3.2f);
+		angles[i] = vec3(frand(-3.2f, 3.2f), frand(-3.2f, 3.2f), frand(-3.2f, 3.2f));
+		axes[i] = normalize(vec3(frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), frand(-1.0f, 1.0f)));
+	}
+
+	BENCH("sinf, cosf", N, {
+		for (int i = 0; i < N; i++) {
+			s[i] = sinf(x[i]);
+			c[i] = cosf(x[i]);
+		}
+		sink += s[rep_ % N] + c[rep_ % N];
+	});
+
+	BENCH("sincos_array", N, {
+		sincos_array(s, c, x, N);
+		sink += s[rep_ % N] + c[rep_ % N];
+	});
+
+	BENCH("euler mat3, libm", N, {
+		for (int i = 0; i < N; i++)
+			m3[i] = scalar_euler(angles[i]);
+		sink += m3[rep_ % N].cols[0].x;
+	});
+
+	BENCH("eulerm3_array", N, {
+		eulerm3_array(m3, angles, N);
+		sink += m3[rep_ % N].cols[0].x;
+	});
+
+	BENCH("eulerq_array", N, {
+		eulerq_array(q, angles, N);
+		sink += q[rep_ % N].x;
+	});
+
+	BENCH("axis-angle mat3, libm", N, {
+		for (int i = 0; i < N; i++)
+			m3[i] = scalar_axis_angle(axes[i], angle[i]);
+		sink += m3[rep_ % N].cols[0].x;
+	});
+
+	BENCH("axis_anglem3_array", N, {
+		axis_anglem3_array(m3, axes, angle, N);
+		sink += m3[rep_ % N].cols[0].x;
+	});
+
+	BENCH("axis_angleq_array", N, {
+		axis_angleq_array(q, axes, angle, N);
+		sink += q[rep_ % N].x;
+	});
+}
+
+/*
+ * Row-major conversion
+ */
+
+static void
+bench_row_major(void) {
+	static mat4 m[N];
+	static float rows[16 * N];
+
+	for (int i = 0; i < N; i++)
+		m[i] = mat4(frand(-1.0f, 1.0f));
+
+	BENCH("row-major, scalar", N, {
+		for (int i = 0; i < N; i++)
+			for (int r = 0; r < 4; r++)
+				for (int c = 0; c < 4; c++)
+					rows[16 * i + 4 * r + c] = m[i].cols[c]._v[r];
+		sink += rows[rep_ % N];
+	});
+
+	BENCH("to_row_majorm4_array", N, {
+		to_row_majorm4_array(rows, m, N);
+		sink += rows[rep_ % N];
+	});
+
+	BENCH("from_row_majorm4_array", N, {
+		from_row_majorm4_array(m, rows, N);
+		sink += m[rep_ % N].cols[0].x;
+	});
+
+	BENCH("to_row_major_affinem4_array", N, {
+		to_row_major_affinem4_array(rows, m, N);
+		sink += rows[rep_ % N];
+	});
+}
+
+/*
+ * 2D affine transforms
+ */
+
+static void
+bench_mat3x2(void) {
+	static mat3 parents3[N], locals3[N], world3[N];
+	static mat3x2 parents[N], locals[N], world[N];
+	static vec3 corners3[N], out3[N];
+	static vec2 corners[N], out[N];
+
+	for (int i = 0; i < N; i++) {
+		const float a = frand(-3.0f, 3.0f), s = frand(0.5f, 2.0f);
+
+		parents[i] = mat3x2(s * cosf(a), s * sinf(a), -s * sinf(a), s * cosf(a), frand(-100.0f, 100.0f), frand(-100.0f, 100.0f));
+		locals[i] = mat3x2(1.0f, 0.0f, 0.0f, 1.0f, frand(-10.0f, 10.0f), frand(-10.0f, 10.0f));
+		parents3[i] = mat3(parents[i]);
+		locals3[i] = mat3(locals[i]);
+		corners[i] = vec2(frand(-1.0f, 1.0f), frand(-1.0f, 1.0f));
+		corners3[i] = vec3(corners[i], 1.0f);
+	}
+
+	BENCH("sprite world, multm3", N, {
+		for (int i = 0; i < N; i++)
+			world3[i] = multm3(parents3[i], locals3[i]);
+		sink += world3[rep_ % N].cols[2].x;
+	});
+
+	BENCH("sprite world, multm3x2_array", N, {
+		multm3x2_array(world, parents, locals, N);
+		sink += world[rep_ % N].cols[2].x;
+	});
+
+	BENCH("sprite inverse, inversem3x2_array", N, {
+		inversem3x2_array(world, parents, N);
+		sink += world[rep_ % N].cols[2].x;
+	});
+
+	BENCH("sprite corners, multm3v3", N, {
+		for (int i = 0; i < N; i++)
+			out3[i] = multm3v3(parents3[0], corners3[i]);
+		sink += out3[rep_ % N].x;
+	});
+
+	BENCH("sprite corners, multm3x2v2_array", N, {
+		multm3x2v2_array(out, parents[0], corners, N);
+		sink += out[rep_ % N].x;
+	});
+}
+
+/*
+ * TRS
+ */
+
+static mat4
+scalar_trs(const struct trs *t) {
+	const float x = t->rotation.x, y = t->rotation.y, z = t->rotation.z, w = t->rotation.w;
+
+	const mat4 r = mat4(
+		1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f,
+		2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f,
+		2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	);
+	const mat4 s = mat4(
+		t->scale.x, 0.0f, 0.0f, 0.0f,
+		0.0f, t->scale.y, 0.0f, 0.0f,
+		0.0f, 0.0f, t->scale.z, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	);
+	mat4 m = mult(r, s);
+	m.cols[3] = vec4(t->translation, 1.0f);
+
+	return m;
+}
+
+static void
+bench_trs(void) {
+	static vec3 angles[N];
+	static quat q[N];
+	static struct trs t[N];
+	static mat4 m[N];
+
+	for (int i = 0; i < N; i++)
+		angles[i] = vec3(frand(-3.2f, 3.2f), frand(-3.2f, 3.2f), frand(-3.2f, 3.2f));
+	eulerq_array(q, angles, N);
+
+	for (int i = 0; i < N; i++)
+		t[i] = (struct trs) { vec3(frand(-9.0f, 9.0f), frand(-9.0f, 9.0f), frand(-9.0f, 9.0f)), q[i], vec3(frand(0.5f, 2.0f)) };
+
+	BENCH("TRS to mat4, scalar", N, {
+		for (int i = 0; i < N; i++)
+			m[i] = scalar_trs(&t[i]);
+		sink += m[rep_ % N].cols[0].x;
+	});
+
+	BENCH("trs_compose_array", N, {
+		trs_compose_array(m, t, N);
+		sink += m[rep_ % N].cols[0].x;
+	});
+
+	BENCH("trs_decompose_array", N, {
+		trs_decompose_array(t, m, N);
+		sink += t[rep_ % N].scale.x;
+	});
+}
+
+/*
+ * Transform stores
+ */
+
+/* As objects tend to be: each allocated alone, and visited in no particular order */
+struct object {
+	struct trs local;
+	char other[200];
+	mat4 world;
+};
+
+static void
+bench_transforms(void) {
+	static struct object *objects[N];
+	static vec3 angles[N];
+	static quat q[N];
+	struct transforms t;
+
+	if (transforms_init(&t, N) != 0) {
+		perror("transforms_init");
+		return;
+	}
+
+	for (int i = 0; i < N; i++)
+		angles[i] = vec3(frand(-3.2f, 3.2f), frand(-3.2f, 3.2f), frand(-3.2f, 3.2f));
+	eulerq_array(q, angles, N);
+
+	for (int i = 0; i < N; i++) {
+		const vec3 position = vec3(frand(-9.0f, 9.0f), frand(-9.0f, 9.0f), frand(-9.0f, 9.0f));
+		objects[i] = malloc(sizeof(struct object));
+		objects[i]->local = (struct trs) { position, q[i], vec3(1.0f) };
+		transforms_add(&t, position, q[i], vec3(1.0f));
+	}
+
+	for (int i = N - 1; i > 0; i--) {
+		const int j = rand() % (i + 1);
+		struct object *o = objects[i];
+		objects[i] = objects[j];
+		objects[j] = o;
+	}
+
+	BENCH("world mat4, objects on the heap", N, {
+		for (int i = 0; i < N; i++)
+			objects[i]->world = scalar_trs(&objects[i]->local);
+		sink += objects[rep_ % N]->world.cols[0].x;
+	});
+
+	BENCH("world mat4, transforms_update", N, {
+		transforms_update(&t);
+		sink += t.world[rep_ % N].cols[0].x;
+	});
+
+	for (int i = 0; i < N; i++)
+		free(objects[i]);
+	transforms_destroy(&t);
+}
+
+/*
+ * Animation
+ */
+
+static void
+bench_anim(void) {
+	enum { BONES = 1024, KEYS = 64 };
+
+	static float times[KEYS];
+	static vec4 values[KEYS], rotations[KEYS];
+	static vec3 angles[KEYS];
+	static struct trs pose[BONES];
+	static mat4 m[BONES];
+
+	for (int k = 0; k < KEYS; k++) {
+		times[k] = (float) k / 30.0f;
+		values[k] = vec4(frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), 0.0f);
+		angles[k] = vec3(frand(-3.2f, 3.2f), frand(-3.2f, 3.2f), frand(-3.2f, 3.2f));
+	}
+	eulerq_array(rotations, angles, KEYS);
+
+	for (int how = ANIM_NLERP; how <= ANIM_SLERP; how++) {
+		struct anim_clip clip;
+
+		if (anim_clip_init(&clip, BONES, 2 * BONES * KEYS, how) != 0)
+			return;
+
+		for (int b = 0; b < BONES; b++) {
+			anim_clip_track(&clip, b, ANIM_TRANSLATION, times, values, KEYS);
+			anim_clip_track(&clip, b, ANIM_ROTATION, times, rotations, KEYS);
+		}
+
+		/* a frame at a time, forwards, as a game plays it */
+		float t = 0.0f;
+
+		BENCH(how == ANIM_SLERP ? "anim_sample_trs, slerp" : "anim_sample_trs, nlerp", BONES, {
+			anim_sample_trs(&clip, t, pose);
+			t = t < 2.0f ? t + 1.0f / 240.0f : 0.0f;
+			sink += pose[rep_ % BONES].rotation.x;
+		});
+
+		BENCH(how == ANIM_SLERP ? "anim_sample_mat4, slerp" : "anim_sample_mat4, nlerp", BONES, {
+			anim_sample_mat4(&clip, t, m);
+			t = t < 2.0f ? t + 1.0f / 240.0f : 0.0f;
+			sink += m[rep_ % BONES].cols[0].x;
+		});
+
+		anim_clip_destroy(&clip);
+	}
+}
+
+/*
+ * Linear systems
+ */
+
+static void
+bench_solve(void) {
+	static mat4 a[N];
+	static vec4 b[N], x[N];
+	static bool singular[N];
+
+	for (int i = 0; i < N; i++) {
+		a[i] = mat4(4.0f);
+		for (int c = 0; c < 4; c++)
+			a[i].cols[c] = add(a[i].cols[c], vec4(frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), frand(-1.0f, 1.0f)));
+		b[i] = vec4(frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), frand(-1.0f, 1.0f));
+	}
+
+	BENCH("mat4 solve, inversem4 and mult", N, {
+		for (int i = 0; i < N; i++)
+			x[i] = mult(inverse(a[i]), b[i]);
+		sink += x[rep_ % N].x;
+	});
+
+	BENCH("solvem4_array", N, {
+		solvem4_array(x, a, b, N, false, singular);
+		sink += x[rep_ % N].x;
+	});
+
+	BENCH("solvem4_array, pivoting", N, {
+		solvem4_array(x, a, b, N, true, singular);
+		sink += x[rep_ % N].x;
+	});
+}
+
+/*
+ * Re-orthonormalization
+ */
+
+static mat3
+scalar_orthonormalize(mat3 m) {
+	const vec3 x = normalize(m.cols[0]);
+	const vec3 y = normalize(sub(m.cols[1], scale(x, dot(x, m.cols[1]))));
+
+	return (mat3) {{ x, y, cross(x, y) }};
+}
+
+static void
+bench_orthonormalize(void) {
+	static vec3 angles[N];
+	static mat3 r[N], m[N];
+
+	for (int i = 0; i < N; i++)
+		angles[i] = vec3(frand(-3.0f, 3.0f), frand(-3.0f, 3.0f), frand(-3.0f, 3.0f));
+	eulerm3_array(r, angles, N);
+
+	for (int i = 0; i < N; i++)
+		for (int c = 0; c < 3; c++)
+			r[i].cols[c] = add(r[i].cols[c], vec3(frand(-1e-3f, 1e-3f), frand(-1e-3f, 1e-3f), frand(-1e-3f, 1e-3f)));
+
+	BENCH("mat3 normalize and cross", N, {
+		for (int i = 0; i < N; i++)
+			m[i] = scalar_orthonormalize(r[i]);
+		sink += m[rep_ % N].cols[0].x;
+	});
+
+	BENCH("orthonormalizem3_array, Gram-Schmidt", N, {
+		orthonormalizem3_array(m, r, N, ORTHONORMALIZE_GRAM_SCHMIDT);
+		sink += m[rep_ % N].cols[0].x;
+	});
+
+	BENCH("orthonormalizem3_array, polar step", N, {
+		orthonormalizem3_array(m, r, N, ORTHONORMALIZE_POLAR_STEP);
+		sink += m[rep_ % N].cols[0].x;
+	});
+
+	BENCH("orthonormalizem3_array, polar", N, {
+		orthonormalizem3_array(m, r, N, ORTHONORMALIZE_POLAR);
+		sink += m[rep_ % N].cols[0].x;
+	});
+}
+
+/*
+ * Oriented box overlap
+ */
+
+/* The 15 axes one by one, with the library's dot and cross */
+static bool
+scalar_obb_overlap(const struct obb *a, const struct obb *b) {
+	const vec3 t = sub(b->center, a->center);
+	vec3 axes[15];
+
+	for (int i = 0; i < 3; i++) {
+		axes[i] = a->axes.cols[i];
+		axes[3 + i] = b->axes.cols[i];
+		for (int j = 0; j < 3; j++)
+			axes[6 + 3 * i + j] = cross(a->axes.cols[i], b->axes.cols[j]);
+	}
+
+	for (int k = 0; k < 15; k++) {
+		float ra = 0.0f, rb = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			ra += a->half_extents._v[i] * fabsf(dot(a->axes.cols[i], axes[k]));
+			rb += b->half_extents._v[i] * fabsf(dot(b->axes.cols[i], axes[k]));
+		}
+		if (fabsf(dot(t, axes[k])) > ra + rb)
+			return false;
+	}
+
+	return true;
+}
+
+static void
+bench_obb(void) {
+	static vec3 centers[N], half[N], angles[N];
+	static mat3 axes[N];
+	static struct obb each[N];
+	static bool overlap[N];
+	static float depth[N];
+
+	for (int i = 0; i < N; i++) {
+		centers[i] = vec3(frand(-4.0f, 4.0f), frand(-4.0f, 4.0f), frand(-4.0f, 4.0f));
+		half[i] = vec3(frand(0.2f, 1.5f), frand(0.2f, 1.5f), frand(0.2f, 1.5f));
+		angles[i] = vec3(frand(-3.0f, 3.0f), frand(-3.0f, 3.0f), frand(-3.0f, 3.0f));
+	}
+	eulerm3_array(axes, angles, N);
+
+	for (int i = 0; i < N; i++)
+		each[i] = (struct obb) { centers[i], half[i], axes[i] };
+
+	const struct obb_arrays boxes = { centers, half, axes };
+	const struct obb_arrays shifted = { centers + 1, half + 1, axes + 1 };
+	const struct obb player = { vec3(0.0f), vec3(1.0f, 2.0f, 0.5f), axes[0] };
+
+	BENCH("OBB one to many, scalar", N, {
+		for (int i = 0; i < N; i++)
+			overlap[i] = scalar_obb_overlap(&player, &each[i]);
+		sink += overlap[rep_ % N];
+	});
+
+	BENCH("OBB one to many, obb_overlap_array", N, {
+		sink += (float) obb_overlap_array(overlap, NULL, &player, boxes, N);
+	});
+
+	BENCH("OBB one to many, with depth", N, {
+		sink += (float) obb_overlap_array(overlap, depth, &player, boxes, N);
+	});
+
+	BENCH("OBB pairs, obb_overlap_pairs_array", N - 1, {
+		sink += (float) obb_overlap_pairs_array(overlap, NULL, boxes, shifted, N - 1);
+	});
+}
+
+/*
+ * Palette uploads
+ */
+
+static void
+bench_palette(void) {
+	static mat4 bones[N], gpu[N];
+	struct palette p;
+
+	for (int i = 0; i < N; i++)
+		bones[i] = mat4(frand(0.5f, 2.0f));
+
+	if (palette_init(&p, N, 0.0f, 8) != 0) {
+		perror("palette_init");
+		return;
+	}
+	palette_update(&p, bones);
+
+	size_t moved = 0;
+
+	BENCH("mat4 palette, memcpy everything", N, {
+		bones[rand() % N].cols[3].x += 1.0f;
+		memcpy(gpu, bones, sizeof(bones));
+		sink += gpu[rep_ % N].cols[0].x;
+	});
+
+	/* about 1% of the matrices change each frame, in small clumps */
+	BENCH("mat4 palette, update and copy dirty", N, {
+		for (int i = 0; i < N / 100; i += 4) {
+			const int first = rand() % (N - 4);
+			for (int j = 0; j < 4; j++)
+				bones[first + j].cols[3].x += 1.0f;
+		}
+		palette_update(&p, bones);
+		moved += palette_copy_dirty(&p, gpu);
+		sink += gpu[rep_ % N].cols[0].x;
+	});
+
+	printf("%-36s %8.1f%% of the bytes\n", "mat4 palette, copied",
+		100.0 * (double) moved / ((double) sizeof(bones) * REPS));
+
+	palette_destroy(&p);
+}
+
+/*
+ * Transparency ordering
+ */
+
+struct keyed {
+	float depth;
+	uint32_t index;
+};
+
+static int
+compare_keyed(const void *a, const void *b) {
+	const float da = ((const struct keyed *) a)->depth, db = ((const struct keyed *) b)->depth;
+
+	return (da < db) - (da > db);
+}
+
+static void
+bench_depth(void) {
+	enum { MAX = 1000000 };
+	static const size_t sizes[] = { 10000, 100000, MAX };
+	static vec3 positions[MAX];
+	static struct keyed keyed[MAX];
+	static uint32_t order[MAX];
+	struct depth_sort s;
+
+	if (depth_sort_init(&s, MAX) != 0) {
+		perror("depth_sort_init");
+		return;
+	}
+
+	const vec3 angles = vec3(0.1f, 0.7f, 0.0f);
+	mat4 view;
+	eulerm4_array(&view, &angles, 1);
+	const vec4 row = vec4(view.cols[0].z, view.cols[1].z, view.cols[2].z, view.cols[3].z);
+
+	for (int i = 0; i < MAX; i++)
+		positions[i] = vec3(frand(-100.0f, 100.0f), frand(-10.0f, 10.0f), frand(-100.0f, 100.0f));
+
+	/* the same total work at each size */
+	for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+		const size_t n = sizes[k], reps = 5 * MAX / n;
+		char name[64];
+
+		snprintf(name, sizeof(name), "depth sort %zuk, dotv4 and qsort", n / 1000);
+		double start = now();
+		for (size_t rep = 0; rep < reps; rep++) {
+			for (size_t i = 0; i < n; i++)
+				keyed[i] = (struct keyed) { -dotv4(row, vec4(positions[i], 1.0f)), (uint32_t) i };
+			qsort(keyed, n, sizeof(keyed[0]), compare_keyed);
+			sink += (float) keyed[rep % n].index;
+		}
+		report(name, now() - start, n * reps);
+
+		snprintf(name, sizeof(name), "depth sort %zuk, depth_sort_view", n / 1000);
+		start = now();
+		for (size_t rep = 0; rep < reps; rep++) {
+			depth_sort_view(&s, order, view, positions, n, DEPTH_BACK_TO_FRONT);
+			sink += (float) order[rep % n];
+		}
+		report(name, now() - start, n * reps);
+	}
+
+	depth_sort_destroy(&s);
+}
+
+/*
+ * Normal encodings
+ */
+
+/* One vector at a time, as a vertex shader or a naive exporter would */
+static void
+oct16_encode_scalar(int16_t *dst, const vec3 *src, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		const float s = fabsf(src[i].x) + fabsf(src[i].y) + fabsf(src[i].z);
+		float u = src[i].x / s, v = src[i].y / s;
+
+		if (src[i].z < 0.0f) {
+			const float fu = copysignf(1.0f - fabsf(v), u);
+			v = copysignf(1.0f - fabsf(u), v);
+			u = fu;
+		}
+
+		dst[2 * i] = (int16_t) lroundf(u * 32767.0f);
+		dst[2 * i + 1] = (int16_t) lroundf(v * 32767.0f);
+	}
+}
+
+static void
+bench_normal(void) {
+	static vec3 normals[N], decoded[N];
+	static int16_t codes[N * 4];
+	static const struct {
+		const char *encode, *decode;
+		enum normal_format format;
+	} formats[] = {
+		{ "normal encode, oct16", "normal decode, oct16", NORMAL_OCT16 },
+		{ "normal encode, oct8", "normal decode, oct8", NORMAL_OCT8 },
+		{ "normal encode, snorm16", "normal decode, snorm16", NORMAL_SNORM16 },
+		{ "normal encode, snorm8", "normal decode, snorm8", NORMAL_SNORM8 },
+	};
+
+	for (int i = 0; i < N; i++)
+		normals[i] = normalize(vec3(frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), frand(-1.0f, 1.0f)));
+
+	BENCH("normal encode, oct16 one at a time", N, {
+		oct16_encode_scalar(codes, normals, N);
+		sink += codes[rep_ % N];
+	});
+
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+		BENCH(formats[f].encode, N, {
+			normal_encode_array(codes, formats[f].format, normals, N);
+			sink += codes[rep_ % N];
+		});
+
+		BENCH(formats[f].decode, N, {
+			normal_decode_array(decoded, formats[f].format, codes, N);
+			sink += decoded[rep_ % N].x;
+		});
+	}
+}
+
+/*
+ * Mesh normals
+ */
+
+static void
+bench_mesh(void) {
+	enum { W = 256, VERTICES = W * W, TRIANGLES = 2 * (W - 1) * (W - 1) };
+	static uint32_t indices[3 * TRIANGLES];
+	static vec3 positions[VERTICES], normals[VERTICES];
+	static vec2 uvs[VERTICES];
+	static vec4 tangents[VERTICES];
+	struct mesh m;
+
+	size_t t = 0;
+	for (uint32_t y = 0; y + 1 < W; y++) {
+		for (uint32_t x = 0; x + 1 < W; x++) {
+			const uint32_t v = y * W + x;
+			const uint32_t quad[6] = { v, v + 1, v + W + 1, v, v + W + 1, v + W };
+			memcpy(&indices[3 * t], quad, sizeof(quad));
+			t += 2;
+		}
+	}
+
+	for (int i = 0; i < VERTICES; i++) {
+		positions[i] = vec3((float) (i % W), (float) (i / W), frand(-1.0f, 1.0f));
+		uvs[i] = vec2(positions[i].x, positions[i].y);
+	}
+
+	if (mesh_init(&m, indices, TRIANGLES, VERTICES, true) != 0) {
+		perror("mesh_init");
+		return;
+	}
+	m.positions = positions;
+	m.normals = normals;
+
+	BENCH("mesh normals, a triangle at a time", VERTICES, {
+		memset(normals, 0, sizeof(normals));
+		for (size_t i = 0; i < TRIANGLES; i++) {
+			const uint32_t *c = &indices[3 * i];
+			const vec3 n = cross(sub(positions[c[1]], positions[c[0]]), sub(positions[c[2]], positions[c[0]]));
+
+			normals[c[0]] = add(normals[c[0]], n);
+			normals[c[1]] = add(normals[c[1]], n);
+			normals[c[2]] = add(normals[c[2]], n);
+		}
+		for (int i = 0; i < VERTICES; i++)
+			normals[i] = normalize(normals[i]);
+		sink += normals[rep_ % VERTICES].z;
+	});
+
+	BENCH("mesh normals, mesh_update", VERTICES, {
+		mesh_update(&m);
+		sink += normals[rep_ % VERTICES].z;
+	});
+
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	struct jobs_pool pool;
+	struct jobs_graph g;
+
+	if (jobs_pool_init(&pool, cpus > 0 ? (size_t) cpus : 1) != 0) {
+		perror("jobs_pool_init");
+		mesh_destroy(&m);
+		return;
+	}
+
+	jobs_graph_init(&g);
+	jobs_stage(&g, "faces", mesh_update_faces, &m, m.triangle_count, 4096);
+	jobs_access(&g, JOBS_READ | JOBS_WHOLE, m.positions);
+	jobs_access(&g, JOBS_WRITE, m.face_normals);
+	jobs_stage(&g, "vertices", mesh_update_vertices, &m, m.vertex_count, 4096);
+	jobs_access(&g, JOBS_READ | JOBS_WHOLE, m.face_normals);
+	jobs_access(&g, JOBS_WRITE, m.normals);
+
+	BENCH("mesh normals, jobs", VERTICES, {
+		jobs_run(&pool, &g);
+		sink += normals[rep_ % VERTICES].z;
+	});
+
+	m.uvs = uvs;
+	m.tangents = tangents;
+
+	BENCH("mesh tangents too, mesh_update", VERTICES, {
+		mesh_update(&m);
+		sink += tangents[rep_ % VERTICES].x;
+	});
+
+	jobs_graph_destroy(&g);
+	jobs_pool_destroy(&pool);
+	mesh_destroy(&m);
+}
+
+/*
+ * Job graphs
+ */
+
+struct frame {
+	struct trs *local;
+	mat4 *world;
+	vec4 *points, *moved;
+	float *rows;
+};
+
+static void
+frame_world(void *arg, size_t first, size_t count) {
+	struct frame *f = arg;
+	trs_compose_array(f->world + first, f->local + first, count);
+}
+
+static void
+frame_points(void *arg, size_t first, size_t count) {
+	struct frame *f = arg;
+	for (size_t i = first; i < first + count; i++)
+		f->moved[i] = multm4v4(f->world[i], f->points[i]);
+}
+
+static void
+frame_pack(void *arg, size_t first, size_t count) {
+	struct frame *f = arg;
+	to_row_major_affinem4_array(f->rows + 12 * first, f->world + first, count);
+}
+
+static void
+frame_stages(struct jobs_graph *g, struct frame *f, int stage, size_t chunk) {
+	if (stage < 0 || stage == 0) {
+		jobs_stage(g, "world", frame_world, f, N, chunk);
+		jobs_access(g, JOBS_READ, f->local);
+		jobs_access(g, JOBS_WRITE, f->world);
+	}
+	if (stage < 0 || stage == 1) {
+		jobs_stage(g, "points", frame_points, f, N, chunk);
+		jobs_access(g, JOBS_READ, f->world);
+		jobs_access(g, JOBS_READ, f->points);
+		jobs_access(g, JOBS_WRITE, f->moved);
+	}
+	if (stage < 0 || stage == 2) {
+		jobs_stage(g, "pack", frame_pack, f, N, chunk);
+		jobs_access(g, JOBS_READ, f->world);
+		jobs_access(g, JOBS_WRITE, f->rows);
+	}
+}
+
+static void
+bench_jobs(void) {
+	static struct trs local[N];
+	static mat4 world[N];
+	static vec4 points[N], moved[N];
+	static float rows[12 * N];
+	struct frame f = { local, world, points, moved, rows };
+
+	for (int i = 0; i < N; i++) {
+		local[i] = (struct trs) { vec3(frand(-9.0f, 9.0f), 0.0f, 0.0f), vec4(0.0f, 0.0f, 0.0f, 1.0f), vec3(1.0f) };
+		points[i] = vec4(frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), 1.0f);
+	}
+
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	struct jobs_pool pool;
+
+	if (jobs_pool_init(&pool, cpus > 0 ? (size_t) cpus : 1) != 0) {
+		perror("jobs_pool_init");
+		return;
+	}
+
+	struct jobs_graph whole, stages[3];
+
+	jobs_graph_init(&whole);
+	frame_stages(&whole, &f, -1, 256);
+
+	for (int s = 0; s < 3; s++) {
+		jobs_graph_init(&stages[s]);
+		frame_stages(&stages[s], &f, s, 256);
+	}
+
+	BENCH("frame stages, one thread", N, {
+		frame_world(&f, 0, N);
+		frame_points(&f, 0, N);
+		frame_pack(&f, 0, N);
+		sink += rows[rep_ % N];
+	});
+
+	BENCH("frame stages, barrier between each", N, {
+		for (int s = 0; s < 3; s++)
+			jobs_run(&pool, &stages[s]);
+		sink += rows[rep_ % N];
+	});
+
+	BENCH("frame stages, job graph", N, {
+		jobs_run(&pool, &whole);
+		sink += rows[rep_ % N];
+	});
+
+	if (getenv("JOBS_TRACE") != NULL) {
+		FILE *trace = fopen(getenv("JOBS_TRACE"), "w");
+
+		if (trace != NULL) {
+			jobs_trace_write(&whole, trace);
+			fclose(trace);
+		}
+		jobs_report(&whole, stdout);
+	}
+
+	jobs_graph_destroy(&whole);
+	for (int s = 0; s < 3; s++)
+		jobs_graph_destroy(&stages[s]);
+	jobs_pool_destroy(&pool);
+}
+
+/*
+ * Streaming transforms
+ */
+
+static void
+bench_stream(void) {
+	static float points[3 * N];
+	static vec4 v[N];
+
+	const int chunks = 1024; // N points each, 48 MiB in all
+
+	for (int i = 0; i < 3 * N; i++)
+		points[i] = frand(-100.0f, 100.0f);
+
+	for (int i = 0; i < N; i++)
+		v[i] = vec4(points[3 * i], points[3 * i + 1], points[3 * i + 2], 1.0f);
+
+	const mat4 m = mat4(
+		0.0f, 1.0f, 0.0f, 0.0f,
+		-1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		10.0f, 20.0f, 30.0f, 1.0f
+	);
+
+	BENCH("multm4v4_array", N, {
+		multm4v4_array(v, m, v, N);
+		sink += v[rep_ % N].x;
+	});
+
+	FILE *in = tmpfile();
+	FILE *out = tmpfile();
+
+	if (in == NULL || out == NULL) {
+		perror("tmpfile");
+		return;
+	}
+
+	for (int i = 0; i < chunks; i++)
+		fwrite(points, sizeof(points), 1, in);
+	rewind(in);
+
+	struct stream_stats stats;
+
+	if (stream_transform(in, out, m, STREAM_VEC3, 0, &stats) != 0)
+		perror("stream_transform");
+	else
+		printf("%-36s %8.2f MB/s (%llu points)\n", "stream_transform, vec3",
+			stats.mb_per_second, (unsigned long long) stats.records);
+
+	fclose(in);
+	fclose(out);
+}
+
+int
+main(void) {
+	srand(1);
+
+	bench_rotations();
+	bench_row_major();
+	bench_mat3x2();
+	bench_trs();
+	bench_transforms();
+	bench_anim();
+	bench_solve();
+	bench_orthonormalize();
+	bench_obb();
+	bench_palette();
+	bench_depth();
+	bench_normal();
+	bench_jobs();
+	bench_mesh();
+	bench_stream();
+
+#ifdef MATRIX_PROFILE
+	printf("\n");
+	profile_report(stdout);
+#endif
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmarks of the matrix.hpp operators and expression templates against
+ * the same work done with the C functions, as bench.c does for the kernels.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "matrix.hpp"
+
+enum { N = 4096, REPS = 500 };
+
+static volatile float sink;
+
+static double
+now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static void
+report(const char *name, double seconds, size_t elements) {
+	printf("%-36s %8.2f ns/element\n", name, seconds * 1e9 / (double) elements);
+}
+
+#define BENCH(NAME, ELEMENTS, BODY) do {                               \
+		const double start_ = now();                           \
+		for (int rep_ = 0; rep_ < REPS; rep_++) {              \
+			BODY;                                          \
+		}                                                      \
+		report(NAME, now() - start_, (size_t) (ELEMENTS) * REPS); \
+	} while (0)
+
+static float
+frand(float lo, float hi) {
+	return lo + (hi - lo) * ((float) rand() / (float) RAND_MAX);
+}
+
+static vec4
+vrand(void) {
+	return vec4(frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), frand(-1.0f, 1.0f), frand(-1.0f, 1.0f));
+}
+
+static mat4
+mrand(void) {
+	return mat4(vrand(), vrand(), vrand(), vrand());
+}
+
+/*
+ * a * s + b
+ */
+
+static void
+bench_scale_add(void) {
+	static vec4 a[N], b[N], tmp[N], out[N];
+	const float s = frand(0.5f, 2.0f);
+
+	for (int i = 0; i < N; i++) {
+		a[i] = vrand();
+		b[i] = vrand();
+	}
+
+	BENCH("a * s + b, addv4(scalev4())", N, {
+		for (int i = 0; i < N; i++)
+			out[i] = addv4(scalev4(a[i], s), b[i]);
+		sink += out[rep_ % N].x;
+	});
+
+	BENCH("a * s + b, C arrays", N, {
+		scalev4_array(tmp, a, s, N);
+		addv4_array(out, tmp, b, N);
+		sink += out[rep_ % N].x;
+	});
+
+	BENCH("a * s + b, operators", N, {
+		for (int i = 0; i < N; i++)
+			out[i] = a[i] * s + b[i];
+		sink += out[rep_ % N].x;
+	});
+
+	BENCH("a * s + b, expression", N, {
+		glsl::view(out, N) = glsl::view(a, N) * s + glsl::view(b, N);
+		sink += out[rep_ % N].x;
+	});
+}
+
+/*
+ * P * V * M * v
+ */
+
+static void
+bench_transform(void) {
+	static vec4 v[N], out[N];
+	const mat4 p = mrand(), view = mrand(), m = mrand();
+
+	for (int i = 0; i < N; i++)
+		v[i] = vrand();
+
+	BENCH("P * V * M * v, multm4 each", N, {
+		for (int i = 0; i < N; i++)
+			out[i] = multm4v4(multm4(multm4(p, view), m), v[i]);
+		sink += out[rep_ % N].x;
+	});
+
+	BENCH("P * V * M * v, multm4v4_array", N, {
+		multm4v4_array(out, multm4(multm4(p, view), m), v, N);
+		sink += out[rep_ % N].x;
+	});
+
+	BENCH("P * V * M * v, operators", N, {
+		for (int i = 0; i < N; i++)
+			out[i] = p * view * m * v[i];
+		sink += out[rep_ % N].x;
+	});
+
+	BENCH("P * V * M * v, expression", N, {
+		glsl::view(out, N) = p * view * m * glsl::view(v, N);
+		sink += out[rep_ % N].x;
+	});
+}
+
+int
+main(void) {
+	srand(1);
+
+	bench_scale_add();
+	bench_transform();
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "depth.h"
+#include "profile.h"
+#include "simd.h"
+
+/* 11, 11 and 10 bits */
+#define RADIX_BITS 11
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_PASSES 3
+
+void
+depth_view_array(float *dst, mat4 view, const vec3 *positions, size_t n) {
+	PROFILE_FUNCTION();
+
+	/* the third row, negated */
+	const v4f_t rx = v4f_splat(-view.cols[0].z), ry = v4f_splat(-view.cols[1].z);
+	const v4f_t rz = v4f_splat(-view.cols[2].z), rw = v4f_splat(-view.cols[3].z);
+
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		v4f_t p[4];
+
+		v4f_gather(p, &positions[i]._v, sizeof(vec3), count, v4f_splat(0.0f));
+
+		const v4f_t d = rx * p[0] + ry * p[1] + rz * p[2] + rw;
+
+		if (count == 4)
+			v4f_store(&dst[i], d);
+		else
+			for (size_t k = 0; k < count; k++)
+				dst[i + k] = d[k];
+	}
+}
+
+int
+depth_sort_init(struct depth_sort *s, size_t capacity) {
+	*s = (struct depth_sort) { 0 };
+
+	/* indices are 32 bits */
+	if (capacity > UINT32_MAX) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	s->depth = alloc_array(float, capacity);
+	s->keys = alloc_array(uint32_t, capacity);
+	s->scratch_keys = alloc_array(uint32_t, capacity);
+	s->scratch_order = alloc_array(uint32_t, capacity);
+	s->counts = alloc_array(uint32_t, RADIX_PASSES * RADIX_SIZE);
+
+	if (s->depth == NULL || s->keys == NULL || s->scratch_keys == NULL || s->scratch_order == NULL
+			|| s->counts == NULL) {
+		depth_sort_destroy(s);
+		return -1;
+	}
+
+	s->capacity = capacity;
+
+	return 0;
+}
+
+void
+depth_sort_destroy(struct depth_sort *s) {
+	alloc_free(s->depth);
+	alloc_free(s->keys);
+	alloc_free(s->scratch_keys);
+	alloc_free(s->scratch_order);
+	alloc_free(s->counts);
+
+	*s = (struct depth_sort) { 0 };
+}
+
+/*
+ * Floats as unsigned integers in the same order: negative floats have their
+ * bits flipped, since their magnitude grows the other way, and positive
+ * ones their sign bit set to put them above. Flipping them all again
+ * reverses the order.
+ */
+static inline v4u_t
+float_keys(v4f_t d, uint32_t reverse) {
+	const v4u_t u = (v4u_t) d;
+	const v4u_t negative = (v4u_t) ((v4i_t) u >> 31);
+
+	return u ^ (negative | 0x80000000u) ^ reverse;
+}
+
+static inline uint32_t
+digit(uint32_t key, int pass) {
+	return (key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1);
+}
+
+int
+depth_sort_array(struct depth_sort *s, uint32_t *order, const float *depth, size_t n, enum depth_direction direction) {
+	PROFILE_FUNCTION();
+
+	if (n > s->capacity) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	uint32_t (*counts)[RADIX_SIZE] = (uint32_t (*)[RADIX_SIZE]) s->counts;
+	const uint32_t reverse = direction == DEPTH_BACK_TO_FRONT ? 0xffffffffu : 0;
+
+	memset(counts, 0, RADIX_PASSES * RADIX_SIZE * sizeof(uint32_t));
+
+	/* the keys, and the histograms of every pass in the same loop */
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		v4f_t d = { 0 };
+
+		if (count == 4)
+			d = v4f_load(&depth[i]);
+		else
+			for (size_t k = 0; k < count; k++)
+				d[k] = depth[i + k];
+
+		const v4u_t keys = float_keys(d, reverse);
+
+		for (size_t k = 0; k < count; k++) {
+			s->keys[i + k] = keys[k];
+			for (int pass = 0; pass < RADIX_PASSES; pass++)
+				counts[pass][digit(keys[k], pass)]++;
+		}
+	}
+
+	/* passes where every key has the same digit change nothing */
+	int passes[RADIX_PASSES], pass_count = 0;
+	for (int pass = 0; pass < RADIX_PASSES; pass++)
+		if (n > 0 && counts[pass][digit(s->keys[0], pass)] != n)
+			passes[pass_count++] = pass;
+
+	if (pass_count == 0) {
+		for (size_t i = 0; i < n; i++)
+			order[i] = (uint32_t) i;
+		return 0;
+	}
+
+	/* ping-pong between the buffers so that the last pass writes order */
+	uint32_t *keys = s->keys, *other_keys = s->scratch_keys;
+	const uint32_t *from = NULL;    /* the identity, for the first pass */
+
+	for (int p = 0; p < pass_count; p++) {
+		const int pass = passes[p];
+		uint32_t *to = (pass_count - p) % 2 ? order : s->scratch_order;
+		uint32_t offset = 0;
+
+		for (int b = 0; b < RADIX_SIZE; b++) {
+			const uint32_t c = counts[pass][b];
+			counts[pass][b] = offset;
+			offset += c;
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			const uint32_t key = keys[i];
+			const uint32_t j = counts[pass][digit(key, pass)]++;
+
+			other_keys[j] = key;
+			to[j] = from ? from[i] : (uint32_t) i;
+		}
+
+		from = to;
+		uint32_t *t = keys;
+		keys = other_keys;
+		other_keys = t;
+	}
+
+	return 0;
+}
+
+int
+depth_sort_view(struct depth_sort *s, uint32_t *order, mat4 view, const vec3 *positions, size_t n, enum depth_direction direction) {
+	if (n > s->capacity) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	depth_view_array(s->depth, view, positions, n);
+
+	return depth_sort_array(s, order, s->depth, n, direction);
+}
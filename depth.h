@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Ordering transparent objects by their distance from the camera.
+ *
+ * The depth of a point is its distance in front of the camera along the
+ * view direction, -z in view space, taken from the third row of the view
+ * matrix for four points at a time. The indices are then ordered by a radix
+ * sort of the depths as integer keys, which unlike qsort is linear in the
+ * count and makes no calls per comparison:
+ *
+ *     struct depth_sort s;
+ *     depth_sort_init(&s, capacity);
+ *
+ *     depth_sort_view(&s, order, view, positions, n, DEPTH_BACK_TO_FRONT);
+ *     for (size_t i = 0; i < n; i++)
+ *         draw(objects[order[i]]);
+ *
+ * The sort is stable, so objects at the same depth keep their order. A NaN
+ * depth sorts beyond the infinity of its sign.
+ */
+
+#ifndef DEPTH_H
+#define DEPTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum depth_direction {
+	DEPTH_BACK_TO_FRONT,    /* farthest first, for blending */
+	DEPTH_FRONT_TO_BACK,    /* nearest first, for early depth rejection */
+};
+
+/* The buffers for sorting up to capacity depths, kept from frame to frame */
+struct depth_sort {
+	float *depth;           /* as computed by depth_sort_view */
+	uint32_t *keys;
+	uint32_t *scratch_keys;
+	uint32_t *scratch_order;
+	uint32_t *counts;       /* a histogram for each radix pass */
+	size_t capacity;
+};
+
+/* dst[i] = -(view * vec4(positions[i], 1)).z */
+void depth_view_array(float *dst, mat4 view, const vec3 *positions, size_t n);
+
+/* 0 on success, -1 if there isn't enough memory */
+int depth_sort_init(struct depth_sort *s, size_t capacity);
+void depth_sort_destroy(struct depth_sort *s);
+
+/* The indices of the n depths in order: 0 on success, -1 with errno EINVAL if n is over capacity */
+int depth_sort_array(struct depth_sort *s, uint32_t *order, const float *depth, size_t n, enum depth_direction direction);
+
+/* Both, with the depths left in s->depth */
+int depth_sort_view(struct depth_sort *s, uint32_t *order, mat4 view, const vec3 *positions, size_t n, enum depth_direction direction);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,579 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "alloc.h"
+#include "jobs.h"
+
+struct jobs_worker {
+	struct jobs_pool *pool;
+	size_t index;
+};
+
+static uint64_t
+now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+/*
+ * Graphs
+ */
+
+void
+jobs_graph_init(struct jobs_graph *g) {
+	*g = (struct jobs_graph) { 0 };
+}
+
+static void
+free_jobs(struct jobs_graph *g) {
+	alloc_free(g->job_stage);
+	alloc_free(g->predecessors);
+	alloc_free(g->remaining);
+	alloc_free(g->successor_start);
+	alloc_free(g->successors);
+	alloc_free(g->trace);
+
+	g->job_stage = NULL;
+	g->predecessors = NULL;
+	g->remaining = NULL;
+	g->successor_start = NULL;
+	g->successors = NULL;
+	g->trace = NULL;
+	g->job_count = 0;
+	g->built = false;
+}
+
+void
+jobs_graph_destroy(struct jobs_graph *g) {
+	free_jobs(g);
+
+	*g = (struct jobs_graph) { 0 };
+}
+
+int
+jobs_stage(struct jobs_graph *g, const char *name, jobs_fn *fn, void *arg, size_t n, size_t chunk) {
+	if (g->stage_count == JOBS_MAX_STAGES) {
+		errno = E2BIG;
+		return -1;
+	}
+
+	if (chunk == 0 || chunk > n)
+		chunk = n > 0 ? n : 1;
+
+	g->stages[g->stage_count++] = (struct jobs_stage_info) {
+		.name = name, .fn = fn, .arg = arg, .n = n, .chunk = chunk,
+	};
+	g->built = false;
+
+	return 0;
+}
+
+int
+jobs_access(struct jobs_graph *g, unsigned access, const void *array) {
+	if (g->stage_count == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct jobs_stage_info *s = &g->stages[g->stage_count - 1];
+
+	if (s->access_count == JOBS_MAX_ACCESSES) {
+		errno = E2BIG;
+		return -1;
+	}
+
+	s->accesses[s->access_count].array = array;
+	s->accesses[s->access_count].access = access;
+	s->access_count++;
+	g->built = false;
+
+	return 0;
+}
+
+static size_t
+chunks(const struct jobs_stage_info *s) {
+	return (s->n + s->chunk - 1) / s->chunk;
+}
+
+struct edges {
+	uint32_t (*pairs)[2];   /* predecessor, successor */
+	size_t count, capacity;
+};
+
+static int
+add_edge(struct edges *e, size_t from, size_t to) {
+	if (e->count == e->capacity) {
+		const size_t capacity = e->capacity > 0 ? 2 * e->capacity : 256;
+		void *pairs = realloc(e->pairs, capacity * sizeof(e->pairs[0]));
+
+		if (pairs == NULL)
+			return -1;
+
+		e->pairs = pairs;
+		e->capacity = capacity;
+	}
+
+	e->pairs[e->count][0] = (uint32_t) from;
+	e->pairs[e->count][1] = (uint32_t) to;
+	e->count++;
+
+	return 0;
+}
+
+/* Whether b must wait for a, and whether for all of it */
+static bool
+depends(const struct jobs_stage_info *a, const struct jobs_stage_info *b, bool *whole) {
+	bool hazard = false;
+
+	*whole = false;
+
+	for (size_t i = 0; i < a->access_count; i++) {
+		for (size_t j = 0; j < b->access_count; j++) {
+			const unsigned access = a->accesses[i].access | b->accesses[j].access;
+
+			if (a->accesses[i].array != b->accesses[j].array || !(access & JOBS_WRITE))
+				continue;
+
+			hazard = true;
+			*whole |= (access & JOBS_WHOLE) != 0;
+		}
+	}
+
+	return hazard;
+}
+
+/* The edges from each stage to those after it that use its arrays */
+static int
+find_edges(const struct jobs_graph *g, struct edges *e) {
+	for (size_t sb = 0; sb < g->stage_count; sb++) {
+		const struct jobs_stage_info *b = &g->stages[sb];
+
+		for (size_t sa = 0; sa < sb; sa++) {
+			const struct jobs_stage_info *a = &g->stages[sa];
+			bool whole;
+
+			if (!depends(a, b, &whole) || a->n == 0)
+				continue;
+
+			for (size_t kb = 0; kb < chunks(b); kb++) {
+				const size_t first = kb * b->chunk;
+				const size_t last = first + b->chunk < b->n ? first + b->chunk - 1 : b->n - 1;
+				size_t ka0 = 0, ka1 = chunks(a) - 1;
+
+				/* the chunks of a with the same elements */
+				if (!whole) {
+					if (first >= a->n)
+						continue;
+
+					ka0 = first / a->chunk;
+					ka1 = last / a->chunk < ka1 ? last / a->chunk : ka1;
+				}
+
+				for (size_t ka = ka0; ka <= ka1; ka++)
+					if (add_edge(e, a->first_job + ka, b->first_job + kb) != 0)
+						return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int
+build(struct jobs_graph *g) {
+	free_jobs(g);
+
+	size_t count = 0;
+	for (size_t s = 0; s < g->stage_count; s++) {
+		g->stages[s].first_job = count;
+		count += chunks(&g->stages[s]);
+	}
+
+	if (count >= UINT32_MAX) {
+		errno = E2BIG;
+		return -1;
+	}
+
+	struct edges e = { 0 };
+
+	g->job_count = count;
+	g->job_stage = alloc_array(uint32_t, count);
+	g->predecessors = alloc_array(uint32_t, count);
+	g->remaining = alloc_array(atomic_uint, count);
+	g->successor_start = alloc_array(size_t, count + 1);
+	g->trace = alloc_array(struct jobs_trace, count);
+
+	if (g->job_stage == NULL || g->predecessors == NULL || g->remaining == NULL
+			|| g->successor_start == NULL || g->trace == NULL || find_edges(g, &e) != 0)
+		goto fail;
+
+	g->successors = alloc_array(uint32_t, e.count);
+	if (g->successors == NULL)
+		goto fail;
+
+	for (size_t s = 0; s < g->stage_count; s++)
+		for (size_t k = 0; k < chunks(&g->stages[s]); k++)
+			g->job_stage[g->stages[s].first_job + k] = (uint32_t) s;
+
+	/* successors grouped by predecessor, by counting sort */
+	for (size_t j = 0; j <= count; j++)
+		g->successor_start[j] = 0;
+	for (size_t j = 0; j < count; j++)
+		g->predecessors[j] = 0;
+
+	for (size_t i = 0; i < e.count; i++) {
+		g->successor_start[e.pairs[i][0] + 1]++;
+		g->predecessors[e.pairs[i][1]]++;
+	}
+
+	for (size_t j = 0; j < count; j++)
+		g->successor_start[j + 1] += g->successor_start[j];
+
+	for (size_t i = 0; i < e.count; i++) {
+		/* successor_start[j] moves along to successor_start[j + 1] as they are placed... */
+		g->successors[g->successor_start[e.pairs[i][0]]++] = e.pairs[i][1];
+	}
+
+	/* ...and back */
+	for (size_t j = count; j > 0; j--)
+		g->successor_start[j] = g->successor_start[j - 1];
+	g->successor_start[0] = 0;
+
+	free(e.pairs);
+	g->built = true;
+
+	return 0;
+
+fail:
+	free(e.pairs);
+	free_jobs(g);
+	return -1;
+}
+
+/*
+ * Pools
+ */
+
+static void
+push(struct jobs_pool *p, size_t worker, uint32_t job) {
+	struct jobs_deque *d = &p->deques[worker];
+
+	pthread_mutex_lock(&d->lock);
+	d->jobs[d->tail++] = job;
+	pthread_mutex_unlock(&d->lock);
+
+	atomic_fetch_add(&p->queued, 1);
+
+	pthread_mutex_lock(&p->lock);
+	pthread_cond_signal(&p->work);
+	pthread_mutex_unlock(&p->lock);
+}
+
+/* The newest of our own jobs, or the oldest of someone else's */
+static bool
+take(struct jobs_deque *d, bool steal, uint32_t *job) {
+	bool found = false;
+
+	pthread_mutex_lock(&d->lock);
+
+	if (d->head < d->tail) {
+		*job = steal ? d->jobs[d->head++] : d->jobs[--d->tail];
+		found = true;
+	}
+
+	pthread_mutex_unlock(&d->lock);
+
+	return found;
+}
+
+static bool
+next_job(struct jobs_pool *p, size_t worker, uint32_t *job) {
+	if (take(&p->deques[worker], false, job))
+		return true;
+
+	for (size_t i = 1; i < p->workers; i++)
+		if (take(&p->deques[(worker + i) % p->workers], true, job))
+			return true;
+
+	return false;
+}
+
+static void
+execute(struct jobs_pool *p, size_t worker, uint32_t job) {
+	struct jobs_graph *g = p->graph;
+	const uint32_t stage = g->job_stage[job];
+	const struct jobs_stage_info *s = &g->stages[stage];
+	const size_t first = (job - s->first_job) * s->chunk;
+	const size_t count = s->n - first < s->chunk ? s->n - first : s->chunk;
+
+	const uint64_t start = now_ns();
+	s->fn(s->arg, first, count);
+	const uint64_t end = now_ns();
+
+	g->trace[job] = (struct jobs_trace) {
+		stage, (uint32_t) worker, first, count, start - g->started, end - g->started,
+	};
+
+	/* what this was the last thing holding up runs next, here */
+	for (size_t i = g->successor_start[job]; i < g->successor_start[job + 1]; i++) {
+		const uint32_t next = g->successors[i];
+
+		if (atomic_fetch_sub_explicit(&g->remaining[next], 1, memory_order_acq_rel) == 1)
+			push(p, worker, next);
+	}
+
+	if (atomic_fetch_sub(&p->pending, 1) == 1) {
+		pthread_mutex_lock(&p->lock);
+		pthread_cond_broadcast(&p->done);
+		pthread_mutex_unlock(&p->lock);
+	}
+}
+
+static void *
+worker_main(void *arg) {
+	const struct jobs_worker *w = arg;
+	struct jobs_pool *p = w->pool;
+
+	for (;;) {
+		uint32_t job;
+
+		if (next_job(p, w->index, &job)) {
+			atomic_fetch_sub(&p->queued, 1);
+			execute(p, w->index, job);
+			continue;
+		}
+
+		pthread_mutex_lock(&p->lock);
+		while (!p->quit && atomic_load(&p->queued) == 0)
+			pthread_cond_wait(&p->work, &p->lock);
+		const bool quit = p->quit;
+		pthread_mutex_unlock(&p->lock);
+
+		if (quit)
+			return NULL;
+	}
+}
+
+/* Stop and wait for the first started workers, then free everything */
+static void
+release(struct jobs_pool *p, size_t started) {
+	pthread_mutex_lock(&p->lock);
+	p->quit = true;
+	pthread_cond_broadcast(&p->work);
+	pthread_mutex_unlock(&p->lock);
+
+	for (size_t i = 0; i < started; i++)
+		pthread_join(p->threads[i], NULL);
+
+	for (size_t i = 0; i < p->workers; i++) {
+		pthread_mutex_destroy(&p->deques[i].lock);
+		alloc_free(p->deques[i].jobs);
+	}
+
+	pthread_cond_destroy(&p->done);
+	pthread_cond_destroy(&p->work);
+	pthread_mutex_destroy(&p->lock);
+
+	alloc_free(p->threads);
+	alloc_free(p->worker_args);
+	alloc_free(p->deques);
+
+	*p = (struct jobs_pool) { 0 };
+}
+
+int
+jobs_pool_init(struct jobs_pool *p, size_t workers) {
+	*p = (struct jobs_pool) { 0 };
+
+	if (workers == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	p->threads = alloc_array(pthread_t, workers);
+	p->worker_args = alloc_array(struct jobs_worker, workers);
+	p->deques = alloc_array(struct jobs_deque, workers);
+
+	if (p->threads == NULL || p->worker_args == NULL || p->deques == NULL) {
+		alloc_free(p->threads);
+		alloc_free(p->worker_args);
+		alloc_free(p->deques);
+		return -1;
+	}
+
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->work, NULL);
+	pthread_cond_init(&p->done, NULL);
+
+	/* the workers look in each other's deques, so they all exist first */
+	p->workers = workers;
+
+	for (size_t i = 0; i < workers; i++) {
+		p->deques[i] = (struct jobs_deque) { .jobs = NULL };
+		pthread_mutex_init(&p->deques[i].lock, NULL);
+	}
+
+	for (size_t i = 0; i < workers; i++) {
+		p->worker_args[i] = (struct jobs_worker) { p, i };
+
+		const int error = pthread_create(&p->threads[i], NULL, worker_main, &p->worker_args[i]);
+
+		if (error != 0) {
+			release(p, i);
+			errno = error;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void
+jobs_pool_destroy(struct jobs_pool *p) {
+	release(p, p->workers);
+}
+
+int
+jobs_run(struct jobs_pool *p, struct jobs_graph *g) {
+	if (!g->built && build(g) != 0)
+		return -1;
+
+	if (g->job_count == 0)
+		return 0;
+
+	/* the workers are idle, but may still look in the deques */
+	for (size_t i = 0; i < p->workers; i++) {
+		struct jobs_deque *d = &p->deques[i];
+		uint32_t *jobs = NULL;
+
+		if (p->capacity < g->job_count) {
+			jobs = alloc_array(uint32_t, g->job_count);
+			if (jobs == NULL)
+				return -1;
+		}
+
+		pthread_mutex_lock(&d->lock);
+		if (jobs != NULL) {
+			alloc_free(d->jobs);
+			d->jobs = jobs;
+		}
+		d->head = d->tail = 0;
+		pthread_mutex_unlock(&d->lock);
+	}
+
+	if (p->capacity < g->job_count)
+		p->capacity = g->job_count;
+
+	for (size_t j = 0; j < g->job_count; j++)
+		atomic_init(&g->remaining[j], g->predecessors[j]);
+
+	p->graph = g;
+	atomic_store(&p->pending, g->job_count);
+	g->started = now_ns();
+
+	/* the jobs waiting for nothing, dealt out */
+	size_t worker = 0;
+
+	for (size_t j = 0; j < g->job_count; j++) {
+		if (g->predecessors[j] == 0) {
+			push(p, worker, (uint32_t) j);
+			worker = (worker + 1) % p->workers;
+		}
+	}
+
+	pthread_mutex_lock(&p->lock);
+	while (atomic_load(&p->pending) > 0)
+		pthread_cond_wait(&p->done, &p->lock);
+	pthread_mutex_unlock(&p->lock);
+
+	return 0;
+}
+
+/*
+ * Traces
+ */
+
+/* A JSON string, with quotes, backslashes and control characters escaped */
+static void
+write_string(FILE *f, const char *s) {
+	fputc('"', f);
+
+	for (; *s != '\0'; s++) {
+		const unsigned char c = (unsigned char) *s;
+
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+
+	fputc('"', f);
+}
+
+int
+jobs_trace_write(const struct jobs_graph *g, FILE *f) {
+	fprintf(f, "{\"traceEvents\":[\n");
+
+	for (size_t j = 0; j < g->job_count; j++) {
+		const struct jobs_trace *t = &g->trace[j];
+
+		fprintf(f, "{\"name\":");
+		write_string(f, g->stages[t->stage].name);
+		fprintf(f, ",\"cat\":\"jobs\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+			"\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"first\":%zu,\"count\":%zu}}%s\n",
+			(unsigned) t->worker,
+			(double) t->start * 1e-3, (double) (t->end - t->start) * 1e-3,
+			t->first, t->count, j + 1 < g->job_count ? "," : "");
+	}
+
+	fprintf(f, "]}\n");
+
+	return ferror(f) ? -1 : 0;
+}
+
+void
+jobs_report(const struct jobs_graph *g, FILE *f) {
+	for (size_t s = 0; s < g->stage_count && g->built; s++) {
+		const struct jobs_stage_info *stage = &g->stages[s];
+		const size_t count = chunks(stage);
+		uint64_t busy = 0, start = UINT64_MAX, end = 0;
+
+		for (size_t k = 0; k < count; k++) {
+			const struct jobs_trace *t = &g->trace[stage->first_job + k];
+
+			busy += t->end - t->start;
+			start = t->start < start ? t->start : start;
+			end = t->end > end ? t->end : end;
+		}
+
+		if (count == 0)
+			start = 0;
+
+		fprintf(f, "%-16s %6zu jobs %10.3f ms busy, from %8.3f to %8.3f ms\n", stage->name, count,
+			(double) busy * 1e-6, (double) start * 1e-6, (double) end * 1e-6);
+	}
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * A job graph for the stages of a frame, run on a pool of worker threads.
+ *
+ * Each stage is a function over n elements, split into chunks, and declares
+ * the arrays it reads and writes. A stage's chunk only waits for the chunks
+ * of earlier stages that touch the same elements of the same arrays, so a
+ * later stage starts on the first chunks while an earlier one is still on the
+ * last, rather than everything waiting at a barrier between stages:
+ *
+ *     jobs_stage(&g, "world", compose, &scene, n, 256);
+ *     jobs_access(&g, JOBS_READ, scene.local);
+ *     jobs_access(&g, JOBS_WRITE, scene.world);
+ *
+ *     jobs_stage(&g, "skin", skin, &scene, n, 256);
+ *     jobs_access(&g, JOBS_READ, scene.world);      // chunk i after world's chunk i
+ *     jobs_access(&g, JOBS_READ | JOBS_WHOLE, scene.palette);
+ *     jobs_access(&g, JOBS_WRITE, scene.skinned);
+ *
+ *     jobs_run(&pool, &g);                           // every frame
+ *
+ * Stages are ordered as declared. Two stages depend on each other where they
+ * share an array and one of them writes it. The elements are matched by index:
+ * element i of every array for element i of the stage. JOBS_WHOLE is for an
+ * array used other than element by element, which makes the dependency on or
+ * of the whole stage.
+ *
+ * Each worker has a deque of ready jobs. A job that a finished one makes
+ * ready goes on the same worker's deque, and is the next it runs, so a chunk
+ * tends to go through the stages on one core while its data is in the cache.
+ * An idle worker steals the oldest job of another.
+ *
+ * Every run records when each job started and finished, and on which worker,
+ * which jobs_trace_write() saves for chrome://tracing or Perfetto.
+ *
+ * The functions return 0 on success, or -1 with errno set.
+ */
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* As in snapshot.h, C++ sees the atomic members as std::atomic */
+#ifdef __cplusplus
+#include <atomic>
+using std::atomic_size_t;
+using std::atomic_uint;
+#else
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JOBS_MAX_STAGES 32
+#define JOBS_MAX_ACCESSES 8
+
+/* The elements [first, first + count) of the stage */
+typedef void jobs_fn(void *arg, size_t first, size_t count);
+
+enum jobs_access {
+	JOBS_READ = 1,
+	JOBS_WRITE = 2,
+	JOBS_WHOLE = 4,
+};
+
+struct jobs_trace {
+	uint32_t stage;
+	uint32_t worker;
+	size_t first;
+	size_t count;
+	uint64_t start;         /* nanoseconds from the start of the run */
+	uint64_t end;
+};
+
+struct jobs_stage_info {
+	const char *name;
+	jobs_fn *fn;
+	void *arg;
+	size_t n;
+	size_t chunk;
+	size_t first_job;
+
+	struct {
+		const void *array;
+		unsigned access;
+	} accesses[JOBS_MAX_ACCESSES];
+	size_t access_count;
+};
+
+struct jobs_graph {
+	struct jobs_stage_info stages[JOBS_MAX_STAGES];
+	size_t stage_count;
+
+	/* built from the stages by the first run after they change */
+	bool built;
+	size_t job_count;
+	uint32_t *job_stage;
+	uint32_t *predecessors;         /* of each job */
+	atomic_uint *remaining;         /* predecessors yet to finish in this run */
+	size_t *successor_start;        /* job j's are successors[successor_start[j]] up to j + 1's */
+	uint32_t *successors;
+
+	struct jobs_trace *trace;       /* job_count of them, from the last run */
+	uint64_t started;               /* the clock at the start of the last run */
+};
+
+struct jobs_deque {
+	pthread_mutex_t lock;
+	uint32_t *jobs;
+	size_t head, tail;              /* steal from the head, push and pop at the tail */
+};
+
+struct jobs_worker;
+
+struct jobs_pool {
+	pthread_t *threads;
+	struct jobs_worker *worker_args;
+	struct jobs_deque *deques;
+	size_t workers;
+	size_t capacity;                /* of each deque */
+
+	struct jobs_graph *graph;
+	atomic_size_t queued;           /* jobs in the deques */
+	atomic_size_t pending;          /* jobs of the run yet to finish */
+
+	pthread_mutex_t lock;
+	pthread_cond_t work;            /* something was queued, or quit */
+	pthread_cond_t done;            /* pending reached 0 */
+	bool quit;
+};
+
+void jobs_graph_init(struct jobs_graph *g);
+void jobs_graph_destroy(struct jobs_graph *g);
+
+/*
+ * Add a stage after the others, of n elements in chunks of chunk, or one
+ * chunk if it is 0. The name isn't copied. E2BIG if there are too many.
+ */
+int jobs_stage(struct jobs_graph *g, const char *name, jobs_fn *fn, void *arg, size_t n, size_t chunk);
+
+/* Declare an array the last stage uses, with a combination of enum jobs_access; E2BIG if there are too many */
+int jobs_access(struct jobs_graph *g, unsigned access, const void *array);
+
+/* Start workers threads, which wait for jobs_run() */
+int jobs_pool_init(struct jobs_pool *p, size_t workers);
+void jobs_pool_destroy(struct jobs_pool *p);
+
+/* Run every job of the graph, returning when they have all finished */
+int jobs_run(struct jobs_pool *p, struct jobs_graph *g);
+
+/* The last run's trace, in the Trace Event Format, with the stage names escaped */
+int jobs_trace_write(const struct jobs_graph *g, FILE *f);
+
+/* For each stage of the last run: jobs, time spent in them, and from the first start to the last end */
+void jobs_report(const struct jobs_graph *g, FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapfile.h"
+
+size_t
+mapfile_element_size(enum mapfile_type type) {
+	switch (type) {
+	case MAPFILE_VEC2: return sizeof(vec2);
+	case MAPFILE_VEC3: return sizeof(vec3);
+	case MAPFILE_VEC4: return sizeof(vec4);
+	case MAPFILE_MAT2: return sizeof(mat2);
+	case MAPFILE_MAT3: return sizeof(mat3);
+	case MAPFILE_MAT4: return sizeof(mat4);
+	}
+
+	return 0;
+}
+
+int
+mapfile_write(const char *path, enum mapfile_type type, const void *data, size_t count) {
+	const size_t element_size = mapfile_element_size(type);
+
+	if (element_size == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct mapfile_header header = {
+		.magic = MAPFILE_MAGIC,
+		.byte_order = MAPFILE_BYTE_ORDER,
+		.version = MAPFILE_VERSION,
+		.type = (uint16_t) type,
+		.count = count,
+		.element_size = (uint32_t) element_size,
+		.alignment = MAPFILE_ALIGNMENT,
+		.data_offset = sizeof(header),
+	};
+
+	/*
+	 * Written beside the target and renamed over it, so that a process
+	 * with the old file mapped keeps its pages rather than getting SIGBUS
+	 * as the file is truncated under it.
+	 */
+	const size_t length = strlen(path);
+	char *tmp = malloc(length + sizeof(".tmp"));
+	if (tmp == NULL)
+		return -1;
+
+	memcpy(tmp, path, length);
+	memcpy(tmp + length, ".tmp", sizeof(".tmp"));
+
+	FILE *f = fopen(tmp, "wb");
+	if (f == NULL) {
+		free(tmp);
+		return -1;
+	}
+
+	/* fwrite() mustn't be given NULL, even for nothing */
+	const bool failed = fwrite(&header, sizeof(header), 1, f) != 1
+		|| (count > 0 && fwrite(data, element_size, count, f) != count)
+		|| fflush(f) != 0
+		|| fsync(fileno(f)) != 0;
+	const int saved = errno;
+
+	if (fclose(f) != 0 || failed || rename(tmp, path) != 0) {
+		const int error = failed ? saved : errno;
+		remove(tmp);
+		free(tmp);
+		errno = error;
+		return -1;
+	}
+
+	free(tmp);
+	return 0;
+}
+
+static bool
+valid_header(const struct mapfile_header *h, size_t file_size) {
+	if (memcmp(h->magic, MAPFILE_MAGIC, sizeof(h->magic)) != 0)
+		return false;
+
+	if (h->byte_order != MAPFILE_BYTE_ORDER || h->version != MAPFILE_VERSION)
+		return false;
+
+	const size_t element_size = mapfile_element_size(h->type);
+
+	if (element_size == 0 || h->element_size != element_size)
+		return false;
+
+	/* a power of two, so that every alignment it claims covers MAPFILE_ALIGNMENT */
+	if (h->alignment < MAPFILE_ALIGNMENT || (h->alignment & (h->alignment - 1)) != 0)
+		return false;
+
+	if (h->data_offset % h->alignment != 0 || h->data_offset % MAPFILE_ALIGNMENT != 0)
+		return false;
+
+	/* the elements can't overlap the header */
+	if (h->data_offset < sizeof(struct mapfile_header))
+		return false;
+
+	/* the elements must fit in the file, without overflowing on the way */
+	if (h->data_offset > file_size)
+		return false;
+
+	return h->count <= (file_size - h->data_offset) / element_size;
+}
+
+int
+mapfile_open(const char *path, struct mapfile *mf) {
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		const int saved = errno;
+		close(fd);
+		errno = saved;
+		return -1;
+	}
+
+	if ((size_t) st.st_size < sizeof(struct mapfile_header)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	const size_t size = (size_t) st.st_size;
+
+	/* private and writable: changes are copied on write, never written back */
+	void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+	/* the mapping keeps its own reference to the file */
+	const int saved = errno;
+	close(fd);
+
+	if (base == MAP_FAILED) {
+		errno = saved;
+		return -1;
+	}
+
+	const struct mapfile_header *h = base;
+
+	if (!valid_header(h, size)) {
+		munmap(base, size);
+		errno = EINVAL;
+		return -1;
+	}
+
+	*mf = (struct mapfile) {
+		.type = h->type,
+		.count = h->count,
+		.data = (char *) base + h->data_offset,
+		.base = base,
+		.size = size,
+	};
+
+	return 0;
+}
+
+void
+mapfile_close(struct mapfile *mf) {
+	if (mf->base != NULL)
+		munmap(mf->base, mf->size);
+
+	*mf = (struct mapfile) { 0 };
+}
+
+void *
+mapfile_data(const struct mapfile *mf, enum mapfile_type type) {
+	return mf->type == type ? mf->data : NULL;
+}
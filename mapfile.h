@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Binary files of vectors or matrices that can be used without loading them.
+ *
+ * A file is a 64 byte header followed by the elements exactly as they are
+ * laid out in memory, including the padding of vec3 and mat3. Because the
+ * header is a multiple of the alignment and mmap() returns page-aligned
+ * memory, the mapped elements can be used in place, e.g.
+ *
+ *     struct mapfile mf;
+ *
+ *     if (mapfile_open("instances.bin", &mf) == 0) {
+ *         mat4 *m = mapfile_data(&mf, MAPFILE_MAT4);
+ *         ...m[0] to m[mf.count - 1]...
+ *         mapfile_close(&mf);
+ *     }
+ *
+ * and the pages are only read from disk as they are touched. The mapping is
+ * private, so the elements may be changed without changing the file.
+ *
+ * Files are in the byte order of the machine that wrote them. Opening a file
+ * of the other byte order fails rather than silently swapping, since that
+ * would need a copy.
+ *
+ * The functions return 0 on success, or -1 with errno set on failure. EINVAL
+ * means the file isn't one of these, or is of an unsupported version or a
+ * foreign byte order.
+ */
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAPFILE_MAGIC "MATGLSL"
+#define MAPFILE_VERSION 1
+
+/* Written in the machine's own order, so it reads back wrong on the other */
+#define MAPFILE_BYTE_ORDER 0x01020304u
+
+/* The alignment of the elements: a cache line, which covers any SIMD load */
+#define MAPFILE_ALIGNMENT 64
+
+enum mapfile_type {
+	MAPFILE_VEC2 = 1,
+	MAPFILE_VEC3,
+	MAPFILE_VEC4,
+	MAPFILE_MAT2,
+	MAPFILE_MAT3,
+	MAPFILE_MAT4,
+};
+
+/* As it is on disk */
+struct mapfile_header {
+	char magic[8];
+	uint32_t byte_order;
+	uint16_t version;
+	uint16_t type;
+	uint64_t count;
+	uint32_t element_size;
+	uint32_t alignment;
+	uint64_t data_offset;
+	uint8_t reserved[24];
+};
+static_assert(sizeof(struct mapfile_header) == MAPFILE_ALIGNMENT, "wrong size for mapfile header");
+
+struct mapfile {
+	enum mapfile_type type;
+	size_t count;
+
+	void *data;
+
+	/* the whole mapping */
+	void *base;
+	size_t size;
+};
+
+/* Size in bytes of one element of the given type, or 0 if there is no such type */
+size_t mapfile_element_size(enum mapfile_type);
+
+/*
+ * Write count elements of the given type to path, replacing the file. They go
+ * to path.tmp first, which is renamed over path once it is on disk, so anyone
+ * with the old file mapped keeps seeing the old contents.
+ */
+int mapfile_write(const char *path, enum mapfile_type type, const void *data, size_t count);
+
+/* Map the file at path and check its header */
+int mapfile_open(const char *path, struct mapfile *mf);
+
+void mapfile_close(struct mapfile *mf);
+
+/* The elements, or NULL if they aren't of the given type */
+void *mapfile_data(const struct mapfile *mf, enum mapfile_type type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -17,6 +17,8 @@
 #include <tgmath.h>
 
 #include "matrix.h"
+#include "profile.h"
+#include "simd.h"
 
 // FIXME: should use SSE/instrinsics for vector calculations
 
@@ -27,16 +29,19 @@
 
 vec2
 vec2f1(float x) {
+	PROFILE_FUNCTION();
 	return (vec2) {{ x, x }};
 }
 
 vec3
 vec3f1(float x) {
+	PROFILE_FUNCTION();
 	return (vec3) {{ x, x, x }};
 }
 
 vec4
 vec4f1(float x) {
+	PROFILE_FUNCTION();
 	return (vec4) {{ x, x, x, x }};
 }
 
@@ -46,73 +51,90 @@ vec4f1(float x) {
 
 vec2
 vec2f2(float x, float y) {
+	PROFILE_FUNCTION();
 	return (vec2) {{ x, y }};
 }
 
 vec3
 vec3f3(float x, float y, float z) {
+	PROFILE_FUNCTION();
 	return (vec3) {{ x, y, z }};
 }
 
 vec4
 vec4f4(float x, float y, float z, float w) {
+	PROFILE_FUNCTION();
 	return (vec4) {{ x, y, z, w }};
 }
 
 /*
  * Constructor from other vectors
+ *
+ * Each of these is a single shuffle of the source vectors' lanes. Where a
+ * vec3 is made, the unused fourth lane is filled with zero, the same as the
+ * scalar constructors.
  */
 
 vec2
 vec2v3(vec3 v) {
-	return (vec2) {{ v.x, v.y }};
+	PROFILE_FUNCTION();
+	return (vec2) { __builtin_shufflevector(v._v, v._v, 0, 1) };
 }
 
 vec2
 vec2v4(vec4 v) {
-	return (vec2) {{ v.x, v.y }};
+	PROFILE_FUNCTION();
+	return (vec2) { __builtin_shufflevector(v._v, v._v, 0, 1) };
 }
 
 
 vec3
 vec3v2f1(vec2 v, float z) {
-	return (vec3) {{ v.x, v.y, z }};
+	PROFILE_FUNCTION();
+	return (vec3) { __builtin_shufflevector(v._v, (v2f_t) { z, 0.0f }, 0, 1, 2, 3) };
 }
 
 vec3
 vec3f1v2(float x, vec2 v) {
-	return (vec3) {{ x, v.x, v.y }};
+	PROFILE_FUNCTION();
+	return (vec3) { __builtin_shufflevector((v2f_t) { x, 0.0f }, v._v, 0, 2, 3, 1) };
 }
 
 vec3
 vec3v4(vec4 v) {
-	return (vec3) {{ v.x, v.y, v.z }};
+	PROFILE_FUNCTION();
+	return (vec3) { __builtin_shufflevector(v._v, (v4f_t) { 0.0f }, 0, 1, 2, 4) };
 }
 
 
 vec4
 vec4v3f1(vec3 v, float w) {
-	return (vec4) {{ v.x, v.y, v.z, w }};
+	PROFILE_FUNCTION();
+	return (vec4) { __builtin_shufflevector(v._v, (v4f_t) { w }, 0, 1, 2, 4) };
 }
 
 vec4
 vec4f1v3(float x, vec3 v) {
-	return (vec4) {{ x, v.x, v.y, v.z }};
+	PROFILE_FUNCTION();
+	return (vec4) { __builtin_shufflevector((v4f_t) { x }, v._v, 0, 4, 5, 6) };
 }
 
 vec4
 vec4v2v2(vec2 a, vec2 b) {
-	return (vec4) {{ a.x, a.y, b.x, b.y }};
+	PROFILE_FUNCTION();
+	return (vec4) { __builtin_shufflevector(a._v, b._v, 0, 1, 2, 3) };
 }
 
 vec4
 vec4v2f2(vec2 v, float z, float w) {
-	return (vec4) {{ v.x, v.y, z, w }};
+	PROFILE_FUNCTION();
+	return (vec4) { __builtin_shufflevector(v._v, (v2f_t) { z, w }, 0, 1, 2, 3) };
 }
 
 vec4
 vec4f2v2(float x, float y, vec2 v) {
-	return (vec4) {{ x, y, v.x, v.y }};
+	PROFILE_FUNCTION();
+	return (vec4) { __builtin_shufflevector((v2f_t) { x, y }, v._v, 0, 1, 2, 3) };
 }
 
 /*
@@ -121,6 +143,7 @@ vec4f2v2(float x, float y, vec2 v) {
 
 mat2
 mat2f1(float x) {
+	PROFILE_FUNCTION();
 	return (mat2) {{
 		vec2(x, 0.0f),
 		vec2(0.0f, x),
@@ -129,6 +152,7 @@ mat2f1(float x) {
 
 mat3
 mat3f1(float x) {
+	PROFILE_FUNCTION();
 	return (mat3) {{
 		vec3(x, 0.0f, 0.0f),
 		vec3(0.0f, x, 0.0f),
@@ -138,6 +162,7 @@ mat3f1(float x) {
 
 mat4
 mat4f1(float x) {
+	PROFILE_FUNCTION();
 	return (mat4) {{
 		vec4(x, 0.0f, 0.0f, 0.0f),
 		vec4(0.0f, x, 0.0f, 0.0f),
@@ -146,31 +171,51 @@ mat4f1(float x) {
 	}};
 }
 
+mat3x2
+mat3x2f1(float x) {
+	PROFILE_FUNCTION();
+	return (mat3x2) {{
+		vec2(x, 0.0f),
+		vec2(0.0f, x),
+		vec2(0.0f, 0.0f),
+	}};
+}
+
 /*
  * From vectors
  */
 
 mat2
 mat2v2(vec2 a, vec2 b) {
+	PROFILE_FUNCTION();
 	return (mat2) {{ a, b }};
 }
 
 mat3
 mat3v3(vec3 a, vec3 b, vec3 c) {
+	PROFILE_FUNCTION();
 	return (mat3) {{ a, b, c }};
 }
 
 mat4
 mat4v4(vec4 a, vec4 b, vec4 c, vec4 d) {
+	PROFILE_FUNCTION();
 	return (mat4) {{ a, b, c, d }};
 }
 
+mat3x2
+mat3x2v2(vec2 a, vec2 b, vec2 c) {
+	PROFILE_FUNCTION();
+	return (mat3x2) {{ a, b, c }};
+}
+
 /*
  * From other matrices
  */
 
 mat3
 mat3m2(mat2 m) {
+	PROFILE_FUNCTION();
 	return (mat3) {{
 		vec3(m.cols[0], 0.0f),
 		vec3(m.cols[1], 0.0f),
@@ -180,6 +225,7 @@ mat3m2(mat2 m) {
 
 mat4
 mat4m2(mat2 m) {
+	PROFILE_FUNCTION();
 	return (mat4) {{
 		vec4(m.cols[0], 0.0f, 0.0f),
 		vec4(m.cols[1], 0.0f, 0.0f),
@@ -190,6 +236,7 @@ mat4m2(mat2 m) {
 
 mat4
 mat4m3(mat3 m) {
+	PROFILE_FUNCTION();
 	return (mat4) {{
 		vec4(m.cols[0], 0.0f),
 		vec4(m.cols[1], 0.0f),
@@ -198,6 +245,38 @@ mat4m3(mat3 m) {
 	}};
 }
 
+mat3x2
+mat3x2m3(mat3 m) {
+	PROFILE_FUNCTION();
+	return (mat3x2) {{
+		vec2(m.cols[0]),
+		vec2(m.cols[1]),
+		vec2(m.cols[2]),
+	}};
+}
+
+mat3
+mat3m3x2(mat3x2 m) {
+	PROFILE_FUNCTION();
+	return (mat3) {{
+		vec3(m.cols[0], 0.0f),
+		vec3(m.cols[1], 0.0f),
+		vec3(m.cols[2], 1.0f),
+	}};
+}
+
+/* The translation goes in the last column, and z passes through */
+mat4
+mat4m3x2(mat3x2 m) {
+	PROFILE_FUNCTION();
+	return (mat4) {{
+		vec4(m.cols[0], 0.0f, 0.0f),
+		vec4(m.cols[1], 0.0f, 0.0f),
+		vec4(0.0f, 0.0f, 1.0f, 0.0f),
+		vec4(m.cols[2], 0.0f, 1.0f),
+	}};
+}
+
 /*
  * Fill matrix directly
  */
@@ -207,6 +286,7 @@ mat2f4(
 		float x1, float y1,
 		float x2, float y2
 	) {
+	PROFILE_FUNCTION();
 	return (mat2) {{
 		vec2(x1, y1),
 		vec2(x2, y2),
@@ -219,6 +299,7 @@ mat3f9(
 		float x2, float y2, float z2,
 		float x3, float y3, float z3
 	) {
+	PROFILE_FUNCTION();
 	return (mat3) {{
 		vec3(x1, y1, z1),
 		vec3(x2, y2, z2),
@@ -233,6 +314,7 @@ mat4f16(
 		float x3, float y3, float z3, float w3,
 		float x4, float y4, float z4, float w4
 	) {
+	PROFILE_FUNCTION();
 	return (mat4) {{
 		vec4(x1, y1, z1, w1),
 		vec4(x2, y2, z2, w2),
@@ -241,22 +323,39 @@ mat4f16(
 	}};
 }
 
+mat3x2
+mat3x2f6(
+		float x1, float y1,
+		float x2, float y2,
+		float x3, float y3
+	) {
+	PROFILE_FUNCTION();
+	return (mat3x2) {{
+		vec2(x1, y1),
+		vec2(x2, y2),
+		vec2(x3, y3),
+	}};
+}
+
 /*
  * Dot product
  */
 
 float
 dotv2(vec2 a, vec2 b) {
+	PROFILE_FUNCTION();
 	return (a.x * b.x) + (a.y * b.y);
 }
 
 float
 dotv3(vec3 a, vec3 b) {
+	PROFILE_FUNCTION();
 	return (a.x * b.x) + (a.y * b.y) + (a.z * b.z);
 }
 
 float
 dotv4(vec4 a, vec4 b) {
+	PROFILE_FUNCTION();
 	return (a.x * b.x) + (a.y * b.y) + (a.z * b.z) + (a.w * b.w);
 }
 
@@ -265,6 +364,7 @@ dotv4(vec4 a, vec4 b) {
  */
 vec3
 cross(vec3 a, vec3 b) {
+	PROFILE_FUNCTION();
 	return vec3(
 			a.y * b.z - a.z * b.y,
 			a.z * b.x - a.x * b.z,
@@ -278,16 +378,19 @@ cross(vec3 a, vec3 b) {
 
 float
 lengthv2(vec2 a) {
+	PROFILE_FUNCTION();
 	return sqrt(dot(a, a));
 }
 
 float
 lengthv3(vec3 a) {
+	PROFILE_FUNCTION();
 	return sqrt(dot(a, a));
 }
 
 float
 lengthv4(vec4 a) {
+	PROFILE_FUNCTION();
 	return sqrt(dot(a, a));
 }
 
@@ -297,6 +400,8 @@ lengthv4(vec4 a) {
 
 vec2
 normalizev2(vec2 a) {
+	PROFILE_FUNCTION();
+
 	const float len = length(a);
 
 	return vec2(a.x / len, a.y / len);
@@ -304,6 +409,8 @@ normalizev2(vec2 a) {
 
 vec3
 normalizev3(vec3 a) {
+	PROFILE_FUNCTION();
+
 	const float len = length(a);
 
 	return vec3(a.x / len, a.y / len, a.z / len);
@@ -311,11 +418,371 @@ normalizev3(vec3 a) {
 
 vec4
 normalizev4(vec4 a) {
+	PROFILE_FUNCTION();
+
 	const float len = length(a);
 
 	return vec4(a.x / len, a.y / len, a.z / len, a.w / len);
 }
 
+/*
+ * Common functions
+ */
+
+vec2
+addv2(vec2 a, vec2 b) {
+	PROFILE_FUNCTION();
+	return (vec2) { a._v + b._v };
+}
+
+vec3
+addv3(vec3 a, vec3 b) {
+	PROFILE_FUNCTION();
+	return (vec3) { a._v + b._v };
+}
+
+vec4
+addv4(vec4 a, vec4 b) {
+	PROFILE_FUNCTION();
+	return (vec4) { a._v + b._v };
+}
+
+vec2
+subv2(vec2 a, vec2 b) {
+	PROFILE_FUNCTION();
+	return (vec2) { a._v - b._v };
+}
+
+vec3
+subv3(vec3 a, vec3 b) {
+	PROFILE_FUNCTION();
+	return (vec3) { a._v - b._v };
+}
+
+vec4
+subv4(vec4 a, vec4 b) {
+	PROFILE_FUNCTION();
+	return (vec4) { a._v - b._v };
+}
+
+vec2
+mulv2(vec2 a, vec2 b) {
+	PROFILE_FUNCTION();
+	return (vec2) { a._v * b._v };
+}
+
+vec3
+mulv3(vec3 a, vec3 b) {
+	PROFILE_FUNCTION();
+	return (vec3) { a._v * b._v };
+}
+
+vec4
+mulv4(vec4 a, vec4 b) {
+	PROFILE_FUNCTION();
+	return (vec4) { a._v * b._v };
+}
+
+vec2
+divv2(vec2 a, vec2 b) {
+	PROFILE_FUNCTION();
+	return (vec2) { a._v / b._v };
+}
+
+vec3
+divv3(vec3 a, vec3 b) {
+	PROFILE_FUNCTION();
+	return (vec3) { v4f_zero_w(a._v / b._v) };
+}
+
+vec4
+divv4(vec4 a, vec4 b) {
+	PROFILE_FUNCTION();
+	return (vec4) { a._v / b._v };
+}
+
+vec2
+scalev2(vec2 a, float s) {
+	PROFILE_FUNCTION();
+	return (vec2) { a._v * s };
+}
+
+vec3
+scalev3(vec3 a, float s) {
+	PROFILE_FUNCTION();
+	return (vec3) { a._v * s };
+}
+
+vec4
+scalev4(vec4 a, float s) {
+	PROFILE_FUNCTION();
+	return (vec4) { a._v * s };
+}
+
+vec2
+mixv2(vec2 x, vec2 y, float a) {
+	PROFILE_FUNCTION();
+	return (vec2) { x._v * (1.0f - a) + y._v * a };
+}
+
+vec3
+mixv3(vec3 x, vec3 y, float a) {
+	PROFILE_FUNCTION();
+	return (vec3) { x._v * (1.0f - a) + y._v * a };
+}
+
+vec4
+mixv4(vec4 x, vec4 y, float a) {
+	PROFILE_FUNCTION();
+	return (vec4) { x._v * (1.0f - a) + y._v * a };
+}
+
+vec2
+clampv2(vec2 x, float min_val, float max_val) {
+	PROFILE_FUNCTION();
+
+	const v2f_t lo = { min_val, min_val };
+	const v2f_t hi = { max_val, max_val };
+
+	return (vec2) { v2f_min(v2f_max(x._v, lo), hi) };
+}
+
+vec3
+clampv3(vec3 x, float min_val, float max_val) {
+	PROFILE_FUNCTION();
+	return (vec3) { v4f_zero_w(v4f_min(v4f_max(x._v, v4f_splat(min_val)), v4f_splat(max_val))) };
+}
+
+vec4
+clampv4(vec4 x, float min_val, float max_val) {
+	PROFILE_FUNCTION();
+	return (vec4) { v4f_min(v4f_max(x._v, v4f_splat(min_val)), v4f_splat(max_val)) };
+}
+
+vec2
+minv2(vec2 a, vec2 b) {
+	PROFILE_FUNCTION();
+	return (vec2) { v2f_min(a._v, b._v) };
+}
+
+vec3
+minv3(vec3 a, vec3 b) {
+	PROFILE_FUNCTION();
+	return (vec3) { v4f_min(a._v, b._v) };
+}
+
+vec4
+minv4(vec4 a, vec4 b) {
+	PROFILE_FUNCTION();
+	return (vec4) { v4f_min(a._v, b._v) };
+}
+
+vec2
+maxv2(vec2 a, vec2 b) {
+	PROFILE_FUNCTION();
+	return (vec2) { v2f_max(a._v, b._v) };
+}
+
+vec3
+maxv3(vec3 a, vec3 b) {
+	PROFILE_FUNCTION();
+	return (vec3) { v4f_max(a._v, b._v) };
+}
+
+vec4
+maxv4(vec4 a, vec4 b) {
+	PROFILE_FUNCTION();
+	return (vec4) { v4f_max(a._v, b._v) };
+}
+
+vec2
+absv2(vec2 a) {
+	PROFILE_FUNCTION();
+	return (vec2) { v2f_abs(a._v) };
+}
+
+vec3
+absv3(vec3 a) {
+	PROFILE_FUNCTION();
+	return (vec3) { v4f_abs(a._v) };
+}
+
+vec4
+absv4(vec4 a) {
+	PROFILE_FUNCTION();
+	return (vec4) { v4f_abs(a._v) };
+}
+
+vec2
+stepv2(float edge, vec2 x) {
+	PROFILE_FUNCTION();
+
+	const v2f_t e = { edge, edge };
+
+	return (vec2) { v2f_select(x._v < e, (v2f_t) { 0.0f, 0.0f }, (v2f_t) { 1.0f, 1.0f }) };
+}
+
+vec3
+stepv3(float edge, vec3 x) {
+	PROFILE_FUNCTION();
+	return (vec3) { v4f_zero_w(v4f_select(x._v < edge, v4f_splat(0.0f), v4f_splat(1.0f))) };
+}
+
+vec4
+stepv4(float edge, vec4 x) {
+	PROFILE_FUNCTION();
+	return (vec4) { v4f_select(x._v < edge, v4f_splat(0.0f), v4f_splat(1.0f)) };
+}
+
+vec2
+smoothstepv2(float edge0, float edge1, vec2 x) {
+	PROFILE_FUNCTION();
+
+	const v2f_t t = clampv2((vec2) { (x._v - edge0) / (edge1 - edge0) }, 0.0f, 1.0f)._v;
+
+	return (vec2) { t * t * (3.0f - 2.0f * t) };
+}
+
+vec3
+smoothstepv3(float edge0, float edge1, vec3 x) {
+	PROFILE_FUNCTION();
+
+	/* clampv3() zeroes the padding lane, and the polynomial keeps it so */
+	const v4f_t t = clampv3((vec3) { (x._v - edge0) / (edge1 - edge0) }, 0.0f, 1.0f)._v;
+
+	return (vec3) { t * t * (3.0f - 2.0f * t) };
+}
+
+vec4
+smoothstepv4(float edge0, float edge1, vec4 x) {
+	PROFILE_FUNCTION();
+
+	const v4f_t t = clampv4((vec4) { (x._v - edge0) / (edge1 - edge0) }, 0.0f, 1.0f)._v;
+
+	return (vec4) { t * t * (3.0f - 2.0f * t) };
+}
+
+vec2
+fmav2(vec2 a, vec2 b, vec2 c) {
+	PROFILE_FUNCTION();
+	return (vec2) { a._v * b._v + c._v };
+}
+
+vec3
+fmav3(vec3 a, vec3 b, vec3 c) {
+	PROFILE_FUNCTION();
+	return (vec3) { a._v * b._v + c._v };
+}
+
+vec4
+fmav4(vec4 a, vec4 b, vec4 c) {
+	PROFILE_FUNCTION();
+	return (vec4) { a._v * b._v + c._v };
+}
+
+/*
+ * Array variants of the common functions
+ *
+ * These are all the same loop, so they are stamped out for each type. The
+ * element functions are visible here, so the compiler inlines them.
+ */
+
+#define ARRAY_UNARY(FN, T)                                              \
+	void                                                            \
+	FN ## _array(T *dst, const T *a, size_t n) {                    \
+		PROFILE_FUNCTION();                                     \
+		for (size_t i = 0; i < n; i++)                          \
+			dst[i] = FN(a[i]);                              \
+	}
+
+#define ARRAY_BINARY(FN, T)                                             \
+	void                                                            \
+	FN ## _array(T *dst, const T *a, const T *b, size_t n) {        \
+		PROFILE_FUNCTION();                                     \
+		for (size_t i = 0; i < n; i++)                          \
+			dst[i] = FN(a[i], b[i]);                        \
+	}
+
+#define ARRAY_TERNARY(FN, T)                                            \
+	void                                                            \
+	FN ## _array(T *dst, const T *a, const T *b, const T *c,        \
+			size_t n) {                                     \
+		PROFILE_FUNCTION();                                     \
+		for (size_t i = 0; i < n; i++)                          \
+			dst[i] = FN(a[i], b[i], c[i]);                  \
+	}
+
+#define ARRAY_ALL_TYPES(GEN, FN) \
+	GEN(FN ## v2, vec2)      \
+	GEN(FN ## v3, vec3)      \
+	GEN(FN ## v4, vec4)
+
+ARRAY_ALL_TYPES(ARRAY_BINARY, add)
+ARRAY_ALL_TYPES(ARRAY_BINARY, sub)
+ARRAY_ALL_TYPES(ARRAY_BINARY, mul)
+ARRAY_ALL_TYPES(ARRAY_BINARY, div)
+ARRAY_ALL_TYPES(ARRAY_BINARY, min)
+ARRAY_ALL_TYPES(ARRAY_BINARY, max)
+ARRAY_ALL_TYPES(ARRAY_UNARY, abs)
+ARRAY_ALL_TYPES(ARRAY_TERNARY, fma)
+
+/* The rest take scalar parameters as well */
+
+#define ARRAY_SCALE(T, V)                                               \
+	void                                                            \
+	scale ## V ## _array(T *dst, const T *a, float s, size_t n) {   \
+		PROFILE_FUNCTION();                                     \
+		for (size_t i = 0; i < n; i++)                          \
+			dst[i] = scale ## V(a[i], s);                   \
+	}
+
+#define ARRAY_MIX(T, V)                                                 \
+	void                                                            \
+	mix ## V ## _array(T *dst, const T *x, const T *y, float a,     \
+			size_t n) {                                     \
+		PROFILE_FUNCTION();                                     \
+		for (size_t i = 0; i < n; i++)                          \
+			dst[i] = mix ## V(x[i], y[i], a);               \
+	}
+
+#define ARRAY_CLAMP(T, V)                                               \
+	void                                                            \
+	clamp ## V ## _array(T *dst, const T *x, float min_val,         \
+			float max_val, size_t n) {                      \
+		PROFILE_FUNCTION();                                     \
+		for (size_t i = 0; i < n; i++)                          \
+			dst[i] = clamp ## V(x[i], min_val, max_val);    \
+	}
+
+#define ARRAY_STEP(T, V)                                                \
+	void                                                            \
+	step ## V ## _array(T *dst, float edge, const T *x, size_t n) { \
+		PROFILE_FUNCTION();                                     \
+		for (size_t i = 0; i < n; i++)                          \
+			dst[i] = step ## V(edge, x[i]);                 \
+	}
+
+#define ARRAY_SMOOTHSTEP(T, V)                                          \
+	void                                                            \
+	smoothstep ## V ## _array(T *dst, float edge0, float edge1,     \
+			const T *x, size_t n) {                         \
+		PROFILE_FUNCTION();                                     \
+		for (size_t i = 0; i < n; i++)                          \
+			dst[i] = smoothstep ## V(edge0, edge1, x[i]);   \
+	}
+
+#define ARRAY_SCALAR_ALL_TYPES(GEN) \
+	GEN(vec2, v2)               \
+	GEN(vec3, v3)               \
+	GEN(vec4, v4)
+
+ARRAY_SCALAR_ALL_TYPES(ARRAY_SCALE)
+ARRAY_SCALAR_ALL_TYPES(ARRAY_MIX)
+ARRAY_SCALAR_ALL_TYPES(ARRAY_CLAMP)
+ARRAY_SCALAR_ALL_TYPES(ARRAY_STEP)
+ARRAY_SCALAR_ALL_TYPES(ARRAY_SMOOTHSTEP)
+
+
 
 /*
  * Matrix transpose
@@ -323,6 +790,7 @@ normalizev4(vec4 a) {
 
 mat2
 transposem2(mat2 m) {
+	PROFILE_FUNCTION();
 	return (mat2) {{
 		vec2(m.cols[0].x, m.cols[1].x),
 		vec2(m.cols[0].y, m.cols[1].y),
@@ -331,6 +799,7 @@ transposem2(mat2 m) {
 
 mat3
 transposem3(mat3 m) {
+	PROFILE_FUNCTION();
 	return (mat3) {{
 		vec3(m.cols[0].x, m.cols[1].x, m.cols[2].x),
 		vec3(m.cols[0].y, m.cols[1].y, m.cols[2].y),
@@ -340,73 +809,243 @@ transposem3(mat3 m) {
 
 mat4
 transposem4(mat4 m) {
-	return (mat4) {{
-		vec4(m.cols[0].x, m.cols[1].x, m.cols[2].x, m.cols[3].x),
-		vec4(m.cols[0].y, m.cols[1].y, m.cols[2].y, m.cols[3].y),
-		vec4(m.cols[0].z, m.cols[1].z, m.cols[2].z, m.cols[3].z),
-		vec4(m.cols[0].w, m.cols[1].w, m.cols[2].w, m.cols[3].w),
-	}};
+	PROFILE_FUNCTION();
+
+	v4f_transpose(&m.cols[0]._v, &m.cols[1]._v, &m.cols[2]._v, &m.cols[3]._v);
+
+	return m;
+}
+
+void
+transposem4_array(mat4 *dst, const mat4 *m, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i++) {
+		v4f_t c0 = m[i].cols[0]._v, c1 = m[i].cols[1]._v, c2 = m[i].cols[2]._v, c3 = m[i].cols[3]._v;
+
+		v4f_transpose(&c0, &c1, &c2, &c3);
+
+		dst[i].cols[0]._v = c0;
+		dst[i].cols[1]._v = c1;
+		dst[i].cols[2]._v = c2;
+		dst[i].cols[3]._v = c3;
+	}
+}
+
+/*
+ * Row-major conversion
+ */
+
+void
+to_row_majorm4_array(float *dst, const mat4 *m, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i++) {
+		v4f_t c0 = m[i].cols[0]._v, c1 = m[i].cols[1]._v, c2 = m[i].cols[2]._v, c3 = m[i].cols[3]._v;
+
+		v4f_transpose(&c0, &c1, &c2, &c3);
+
+		v4f_store(&dst[16 * i], c0);
+		v4f_store(&dst[16 * i + 4], c1);
+		v4f_store(&dst[16 * i + 8], c2);
+		v4f_store(&dst[16 * i + 12], c3);
+	}
+}
+
+void
+from_row_majorm4_array(mat4 *dst, const float *rows, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i++) {
+		v4f_t r0 = v4f_load(&rows[16 * i]);
+		v4f_t r1 = v4f_load(&rows[16 * i + 4]);
+		v4f_t r2 = v4f_load(&rows[16 * i + 8]);
+		v4f_t r3 = v4f_load(&rows[16 * i + 12]);
+
+		v4f_transpose(&r0, &r1, &r2, &r3);
+
+		dst[i].cols[0]._v = r0;
+		dst[i].cols[1]._v = r1;
+		dst[i].cols[2]._v = r2;
+		dst[i].cols[3]._v = r3;
+	}
+}
+
+void
+to_row_major_affinem4_array(float *dst, const mat4 *m, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i++) {
+		v4f_t c0 = m[i].cols[0]._v, c1 = m[i].cols[1]._v, c2 = m[i].cols[2]._v, c3 = m[i].cols[3]._v;
+
+		v4f_transpose(&c0, &c1, &c2, &c3);
+
+		/* the last row is dropped */
+		v4f_store(&dst[12 * i], c0);
+		v4f_store(&dst[12 * i + 4], c1);
+		v4f_store(&dst[12 * i + 8], c2);
+	}
+}
+
+void
+from_row_major_affinem4_array(mat4 *dst, const float *rows, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i++) {
+		v4f_t r0 = v4f_load(&rows[12 * i]);
+		v4f_t r1 = v4f_load(&rows[12 * i + 4]);
+		v4f_t r2 = v4f_load(&rows[12 * i + 8]);
+		v4f_t r3 = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+		v4f_transpose(&r0, &r1, &r2, &r3);
+
+		dst[i].cols[0]._v = r0;
+		dst[i].cols[1]._v = r1;
+		dst[i].cols[2]._v = r2;
+		dst[i].cols[3]._v = r3;
+	}
 }
 
 /*
  * Matrix multiplication
+ *
+ * m * v is the sum of the columns of m, each scaled by one lane of v, so a
+ * product is one broadcast and multiply-add per column, and m * n is that for
+ * each column of n.
  */
 
+static inline v2f_t
+columns2(const mat2 *m, v2f_t v) {
+	return m->cols[0]._v * v[0] + m->cols[1]._v * v[1];
+}
+
+static inline v4f_t
+columns3(const mat3 *m, v4f_t v) {
+	return m->cols[0]._v * v[0] + m->cols[1]._v * v[1] + m->cols[2]._v * v[2];
+}
+
+static inline v4f_t
+columns4(const mat4 *m, v4f_t v) {
+	return m->cols[0]._v * v[0] + m->cols[1]._v * v[1] + m->cols[2]._v * v[2] + m->cols[3]._v * v[3];
+}
+
 mat2
 multm2(mat2 m, mat2 n) {
-	const mat2 mt = transpose(m);
+	PROFILE_FUNCTION();
 
 	return (mat2) {{
-		vec2(dot(mt.cols[0], n.cols[0]), dot(mt.cols[1], n.cols[0])),
-		vec2(dot(mt.cols[0], n.cols[1]), dot(mt.cols[1], n.cols[1])),
+		{ ._v = columns2(&m, n.cols[0]._v) },
+		{ ._v = columns2(&m, n.cols[1]._v) },
 	}};
 }
 
 mat3
 multm3(mat3 m, mat3 n) {
-	const mat3 mt = transpose(m);
+	PROFILE_FUNCTION();
 
 	return (mat3) {{
-		vec3(dot(mt.cols[0], n.cols[0]), dot(mt.cols[1], n.cols[0]), dot(mt.cols[2], n.cols[0])),
-		vec3(dot(mt.cols[0], n.cols[1]), dot(mt.cols[1], n.cols[1]), dot(mt.cols[2], n.cols[1])),
-		vec3(dot(mt.cols[0], n.cols[2]), dot(mt.cols[1], n.cols[2]), dot(mt.cols[2], n.cols[2])),
+		{ ._v = columns3(&m, n.cols[0]._v) },
+		{ ._v = columns3(&m, n.cols[1]._v) },
+		{ ._v = columns3(&m, n.cols[2]._v) },
 	}};
 }
 
 mat4
 multm4(mat4 m, mat4 n) {
-	const mat4 mt = transpose(m);
+	PROFILE_FUNCTION();
 
 	return (mat4) {{
-		vec4(dot(mt.cols[0], n.cols[0]), dot(mt.cols[1], n.cols[0]), dot(mt.cols[2], n.cols[0]), dot(mt.cols[3], n.cols[0])),
-		vec4(dot(mt.cols[0], n.cols[1]), dot(mt.cols[1], n.cols[1]), dot(mt.cols[2], n.cols[1]), dot(mt.cols[3], n.cols[1])),
-		vec4(dot(mt.cols[0], n.cols[2]), dot(mt.cols[1], n.cols[2]), dot(mt.cols[2], n.cols[2]), dot(mt.cols[3], n.cols[2])),
-		vec4(dot(mt.cols[0], n.cols[3]), dot(mt.cols[1], n.cols[3]), dot(mt.cols[2], n.cols[3]), dot(mt.cols[3], n.cols[3])),
+		{ ._v = columns4(&m, n.cols[0]._v) },
+		{ ._v = columns4(&m, n.cols[1]._v) },
+		{ ._v = columns4(&m, n.cols[2]._v) },
+		{ ._v = columns4(&m, n.cols[3]._v) },
 	}};
 }
 
-/*
- * Matrix determinant
- */
+vec2
+multm2v2(mat2 m, vec2 v) {
+	PROFILE_FUNCTION();
+	return (vec2) { ._v = columns2(&m, v._v) };
+}
 
-float
-determinantm2(const mat2 m) {
-	const float a = m.cols[0].x;
-	const float d = m.cols[1].y;
-	const float c = m.cols[0].y;
-	const float b = m.cols[1].x;
+vec3
+multm3v3(mat3 m, vec3 v) {
+	PROFILE_FUNCTION();
+	return (vec3) { ._v = columns3(&m, v._v) };
+}
 
-	return a * d - b * c;
+vec4
+multm4v4(mat4 m, vec4 v) {
+	PROFILE_FUNCTION();
+	return (vec4) { ._v = columns4(&m, v._v) };
 }
 
-float
-determinantm3(const mat3 m) {
-	const float det =
-		m.cols[0].x * determinant(mat2(
-			m.cols[1].y, m.cols[1].z,
-			m.cols[2].y, m.cols[2].z
-		))
-		- m.cols[1].x * determinant(mat2(
+/* v * m is transpose(m) * v: a dot product with each column */
+
+vec2
+multv2m2(vec2 v, mat2 m) {
+	PROFILE_FUNCTION();
+
+	const v2f_t a = v._v * m.cols[0]._v;
+	const v2f_t b = v._v * m.cols[1]._v;
+
+	return vec2(a[0] + a[1], b[0] + b[1]);
+}
+
+vec3
+multv3m3(vec3 v, mat3 m) {
+	PROFILE_FUNCTION();
+
+	/* the zero fourth column keeps the padding lane zero */
+	v4f_t c0 = m.cols[0]._v, c1 = m.cols[1]._v, c2 = m.cols[2]._v, c3 = { 0.0f };
+	v4f_transpose(&c0, &c1, &c2, &c3);
+
+	return (vec3) { ._v = c0 * v._v[0] + c1 * v._v[1] + c2 * v._v[2] };
+}
+
+vec4
+multv4m4(vec4 v, mat4 m) {
+	PROFILE_FUNCTION();
+
+	v4f_transpose(&m.cols[0]._v, &m.cols[1]._v, &m.cols[2]._v, &m.cols[3]._v);
+
+	return (vec4) { ._v = columns4(&m, v._v) };
+}
+
+void
+multm4v4_array(vec4 *dst, mat4 m, const vec4 *v, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i++)
+		dst[i]._v = columns4(&m, v[i]._v);
+}
+
+/*
+ * Matrix determinant
+ */
+
+float
+determinantm2(const mat2 m) {
+	PROFILE_FUNCTION();
+
+	const float a = m.cols[0].x;
+	const float d = m.cols[1].y;
+	const float c = m.cols[0].y;
+	const float b = m.cols[1].x;
+
+	return a * d - b * c;
+}
+
+float
+determinantm3(const mat3 m) {
+	PROFILE_FUNCTION();
+
+	const float det =
+		m.cols[0].x * determinant(mat2(
+			m.cols[1].y, m.cols[1].z,
+			m.cols[2].y, m.cols[2].z
+		))
+		- m.cols[1].x * determinant(mat2(
 			m.cols[0].y, m.cols[0].z,
 			m.cols[2].y, m.cols[2].z
 		))
@@ -420,6 +1059,8 @@ determinantm3(const mat3 m) {
 
 float
 determinantm4(const mat4 m) {
+	PROFILE_FUNCTION();
+
 	const float det =
 		m.cols[0].x * determinant(mat3(
 			m.cols[1].y, m.cols[1].z, m.cols[1].w,
@@ -459,6 +1100,8 @@ determinantm4(const mat4 m) {
  */
 mat4
 inversem4(const mat4 m) {
+	PROFILE_FUNCTION();
+
 	/* mutable */ mat4 inv = mat4(0.0f);
 
 	const float det = determinant(m);
@@ -486,3 +1129,848 @@ inversem4(const mat4 m) {
 
 	return transpose(inv);
 }
+
+/*
+ * 2D affine transforms
+ *
+ * The first two columns of a mat3x2 are contiguous, so the linear part loads
+ * as one v4f_t. a * b is then two multiplies across both of b's columns, and
+ * the translation a * b.cols[2] + a.cols[2]. Points go two to a vector.
+ */
+
+static inline v4f_t
+linear_part(const mat3x2 *m) {
+	return v4f_load(&m->cols[0].x);
+}
+
+static inline mat3x2
+compose2d(const mat3x2 *a, const mat3x2 *b) {
+	const v4f_t la = linear_part(a), lb = linear_part(b);
+	const v4f_t c = __builtin_shufflevector(la, la, 0, 1, 0, 1) * __builtin_shufflevector(lb, lb, 0, 0, 2, 2)
+		+ __builtin_shufflevector(la, la, 2, 3, 2, 3) * __builtin_shufflevector(lb, lb, 1, 1, 3, 3);
+	mat3x2 r;
+
+	v4f_store(&r.cols[0].x, c);
+	r.cols[2]._v = a->cols[0]._v * b->cols[2].x + a->cols[1]._v * b->cols[2].y + a->cols[2]._v;
+
+	return r;
+}
+
+static inline mat3x2
+inverse2d(const mat3x2 *m) {
+	const v4f_t l = linear_part(m);
+	const float inv_det = 1.0f / (l[0] * l[3] - l[2] * l[1]);
+
+	/* (d, -b, -c, a) / det */
+	const v4f_t inv = __builtin_shufflevector(l, -l, 3, 5, 6, 0) * inv_det;
+	mat3x2 r;
+
+	v4f_store(&r.cols[0].x, inv);
+	r.cols[2]._v = -(r.cols[0]._v * m->cols[2].x + r.cols[1]._v * m->cols[2].y);
+
+	return r;
+}
+
+mat3x2
+multm3x2(mat3x2 a, mat3x2 b) {
+	PROFILE_FUNCTION();
+	return compose2d(&a, &b);
+}
+
+vec2
+multm3x2v2(mat3x2 m, vec2 v) {
+	PROFILE_FUNCTION();
+	return (vec2) { ._v = m.cols[0]._v * v.x + m.cols[1]._v * v.y + m.cols[2]._v };
+}
+
+float
+determinantm3x2(mat3x2 m) {
+	PROFILE_FUNCTION();
+	return m.cols[0].x * m.cols[1].y - m.cols[1].x * m.cols[0].y;
+}
+
+mat3x2
+inversem3x2(mat3x2 m) {
+	PROFILE_FUNCTION();
+	return inverse2d(&m);
+}
+
+void
+multm3x2_array(mat3x2 *dst, const mat3x2 *a, const mat3x2 *b, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i++)
+		dst[i] = compose2d(&a[i], &b[i]);
+}
+
+void
+multm3x2v2_array(vec2 *dst, mat3x2 m, const vec2 *v, size_t n) {
+	PROFILE_FUNCTION();
+
+	const v4f_t c0 = { m.cols[0].x, m.cols[0].y, m.cols[0].x, m.cols[0].y };
+	const v4f_t c1 = { m.cols[1].x, m.cols[1].y, m.cols[1].x, m.cols[1].y };
+	const v4f_t c2 = { m.cols[2].x, m.cols[2].y, m.cols[2].x, m.cols[2].y };
+	size_t i = 0;
+
+	for (; i + 2 <= n; i += 2) {
+		const v4f_t p = v4f_load(&v[i].x);
+		const v4f_t r = c0 * __builtin_shufflevector(p, p, 0, 0, 2, 2)
+			+ c1 * __builtin_shufflevector(p, p, 1, 1, 3, 3) + c2;
+
+		v4f_store(&dst[i].x, r);
+	}
+
+	if (i < n)
+		dst[i]._v = m.cols[0]._v * v[i].x + m.cols[1]._v * v[i].y + m.cols[2]._v;
+}
+
+void
+inversem3x2_array(mat3x2 *dst, const mat3x2 *m, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i++)
+		dst[i] = inverse2d(&m[i]);
+}
+
+/*
+ * Sine and cosine
+ */
+
+void
+sincosv4(vec4 x, vec4 *s, vec4 *c) {
+	PROFILE_FUNCTION();
+
+	v4f_sincos(x._v, &s->_v, &c->_v);
+}
+
+void
+sincos_array(float *s, float *c, const float *x, size_t n) {
+	PROFILE_FUNCTION();
+
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		v4f_t vs, vc;
+
+		v4f_sincos((v4f_t) { x[i], x[i + 1], x[i + 2], x[i + 3] }, &vs, &vc);
+
+		for (int k = 0; k < 4; k++) {
+			s[i + k] = vs[k];
+			c[i + k] = vc[k];
+		}
+	}
+
+	if (i < n) {
+		v4f_t xs = { 0.0f }, vs, vc;
+
+		for (size_t k = 0; i + k < n; k++)
+			xs[k] = x[i + k];
+
+		v4f_sincos(xs, &vs, &vc);
+
+		for (size_t k = 0; i + k < n; k++) {
+			s[i + k] = vs[k];
+			c[i + k] = vc[k];
+		}
+	}
+}
+
+/*
+ * Batched rotations
+ *
+ * Each of these works on blocks of four: the inputs are gathered so that each
+ * lane holds one rotation, the rotation is calculated with one lane per
+ * rotation, and then the lanes are scattered out to the matrices. The last,
+ * partial block is padded with zeroes and only the valid results are kept.
+ */
+
+/* Lane k of the columns is rotation k */
+struct rotation_block {
+	v4f_t m[3][3];
+};
+
+static void
+euler_block(struct rotation_block *r, const vec3 *angles, size_t count) {
+	v4f_t ax = { 0.0f }, ay = { 0.0f }, az = { 0.0f };
+
+	for (size_t k = 0; k < count; k++) {
+		ax[k] = angles[k].x;
+		ay[k] = angles[k].y;
+		az[k] = angles[k].z;
+	}
+
+	v4f_t sx, cx, sy, cy, sz, cz;
+	v4f_sincos(ax, &sx, &cx);
+	v4f_sincos(ay, &sy, &cy);
+	v4f_sincos(az, &sz, &cz);
+
+	/* Rz * Ry * Rx */
+	r->m[0][0] = cz * cy;
+	r->m[0][1] = sz * cy;
+	r->m[0][2] = -sy;
+
+	r->m[1][0] = cz * sy * sx - sz * cx;
+	r->m[1][1] = sz * sy * sx + cz * cx;
+	r->m[1][2] = cy * sx;
+
+	r->m[2][0] = cz * sy * cx + sz * sx;
+	r->m[2][1] = sz * sy * cx - cz * sx;
+	r->m[2][2] = cy * cx;
+}
+
+static void
+axis_angle_block(struct rotation_block *r, const vec3 *axes, const float *angles, size_t count) {
+	v4f_t x = { 0.0f }, y = { 0.0f }, z = { 0.0f }, angle = { 0.0f };
+
+	for (size_t k = 0; k < count; k++) {
+		x[k] = axes[k].x;
+		y[k] = axes[k].y;
+		z[k] = axes[k].z;
+		angle[k] = angles[k];
+	}
+
+	v4f_t s, c;
+	v4f_sincos(angle, &s, &c);
+
+	/* Rodrigues' rotation formula */
+	const v4f_t t = 1.0f - c;
+
+	r->m[0][0] = t * x * x + c;
+	r->m[0][1] = t * x * y + s * z;
+	r->m[0][2] = t * x * z - s * y;
+
+	r->m[1][0] = t * x * y - s * z;
+	r->m[1][1] = t * y * y + c;
+	r->m[1][2] = t * y * z + s * x;
+
+	r->m[2][0] = t * x * z + s * y;
+	r->m[2][1] = t * y * z - s * x;
+	r->m[2][2] = t * z * z + c;
+}
+
+static void
+scatter_m3(mat3 *dst, const struct rotation_block *r, size_t count) {
+	for (size_t k = 0; k < count; k++) {
+		dst[k] = (mat3) {{
+			{{ r->m[0][0][k], r->m[0][1][k], r->m[0][2][k] }},
+			{{ r->m[1][0][k], r->m[1][1][k], r->m[1][2][k] }},
+			{{ r->m[2][0][k], r->m[2][1][k], r->m[2][2][k] }},
+		}};
+	}
+}
+
+static void
+scatter_m4(mat4 *dst, const struct rotation_block *r, size_t count) {
+	for (size_t k = 0; k < count; k++) {
+		dst[k] = (mat4) {{
+			{{ r->m[0][0][k], r->m[0][1][k], r->m[0][2][k], 0.0f }},
+			{{ r->m[1][0][k], r->m[1][1][k], r->m[1][2][k], 0.0f }},
+			{{ r->m[2][0][k], r->m[2][1][k], r->m[2][2][k], 0.0f }},
+			{{ 0.0f, 0.0f, 0.0f, 1.0f }},
+		}};
+	}
+}
+
+void
+eulerm3_array(mat3 *dst, const vec3 *angles, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		struct rotation_block r;
+
+		euler_block(&r, angles + i, BLOCK_COUNT(i, n));
+		scatter_m3(dst + i, &r, BLOCK_COUNT(i, n));
+	}
+}
+
+void
+eulerm4_array(mat4 *dst, const vec3 *angles, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		struct rotation_block r;
+
+		euler_block(&r, angles + i, BLOCK_COUNT(i, n));
+		scatter_m4(dst + i, &r, BLOCK_COUNT(i, n));
+	}
+}
+
+void
+axis_anglem3_array(mat3 *dst, const vec3 *axes, const float *angles, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		struct rotation_block r;
+
+		axis_angle_block(&r, axes + i, angles + i, BLOCK_COUNT(i, n));
+		scatter_m3(dst + i, &r, BLOCK_COUNT(i, n));
+	}
+}
+
+void
+axis_anglem4_array(mat4 *dst, const vec3 *axes, const float *angles, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		struct rotation_block r;
+
+		axis_angle_block(&r, axes + i, angles + i, BLOCK_COUNT(i, n));
+		scatter_m4(dst + i, &r, BLOCK_COUNT(i, n));
+	}
+}
+
+/*
+ * Quaternions only need the sine and cosine of the half angles.
+ */
+
+void
+eulerq_array(quat *dst, const vec3 *angles, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		v4f_t ax = { 0.0f }, ay = { 0.0f }, az = { 0.0f };
+
+		for (size_t k = 0; k < count; k++) {
+			ax[k] = angles[i + k].x;
+			ay[k] = angles[i + k].y;
+			az[k] = angles[i + k].z;
+		}
+
+		v4f_t sx, cx, sy, cy, sz, cz;
+		v4f_sincos(ax * 0.5f, &sx, &cx);
+		v4f_sincos(ay * 0.5f, &sy, &cy);
+		v4f_sincos(az * 0.5f, &sz, &cz);
+
+		/* qz * qy * qx */
+		const v4f_t x = sx * cy * cz - cx * sy * sz;
+		const v4f_t y = cx * sy * cz + sx * cy * sz;
+		const v4f_t z = cx * cy * sz - sx * sy * cz;
+		const v4f_t w = cx * cy * cz + sx * sy * sz;
+
+		for (size_t k = 0; k < count; k++)
+			dst[i + k] = (quat) {{ x[k], y[k], z[k], w[k] }};
+	}
+}
+
+void
+axis_angleq_array(quat *dst, const vec3 *axes, const float *angles, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		v4f_t angle = { 0.0f };
+
+		for (size_t k = 0; k < count; k++)
+			angle[k] = angles[i + k];
+
+		v4f_t s, c;
+		v4f_sincos(angle * 0.5f, &s, &c);
+
+		for (size_t k = 0; k < count; k++)
+			dst[i + k] = (quat) {{ axes[i + k].x * s[k], axes[i + k].y * s[k], axes[i + k].z * s[k], c[k] }};
+	}
+}
+
+/*
+ * Batched linear systems
+ *
+ * Gaussian elimination on four systems at once, one per lane: a[r][c] holds
+ * row r, column c of each system's matrix. Partial pivoting can't branch on
+ * the pivot row since each lane has its own, so instead every row below is
+ * compared with the pivot row and swapped in where it is larger. Afterwards
+ * the pivot row holds the largest.
+ */
+
+struct solve_block {
+	v4f_t a[4][4];
+	v4f_t b[4];
+};
+
+static inline v4i_t
+solve_block(struct solve_block *s, const int size, bool pivot) {
+	/* anything this small next to the largest entry is taken as zero */
+	v4f_t largest = { 0.0f };
+
+	for (int r = 0; r < size; r++)
+		for (int c = 0; c < size; c++)
+			largest = v4f_max(largest, v4f_abs(s->a[r][c]));
+
+	const v4f_t tolerance = largest * (float) size * __FLT_EPSILON__;
+
+	v4i_t singular = { 0 };
+
+	for (int j = 0; j < size; j++) {
+		if (pivot) {
+			for (int r = j + 1; r < size; r++) {
+				const v4i_t swap = v4f_abs(s->a[r][j]) > v4f_abs(s->a[j][j]);
+
+				for (int c = j; c < size; c++) {
+					const v4f_t t = s->a[j][c];
+					s->a[j][c] = v4f_select(swap, s->a[r][c], t);
+					s->a[r][c] = v4f_select(swap, t, s->a[r][c]);
+				}
+
+				const v4f_t t = s->b[j];
+				s->b[j] = v4f_select(swap, s->b[r], t);
+				s->b[r] = v4f_select(swap, t, s->b[r]);
+			}
+		}
+
+		/* the comparison is false for NaN, which is singular too */
+		singular |= ~(v4f_abs(s->a[j][j]) > tolerance);
+
+		/* keep the singular lanes finite, they are zeroed at the end */
+		const v4f_t inv = 1.0f / v4f_select(singular, v4f_splat(1.0f), s->a[j][j]);
+
+		for (int r = j + 1; r < size; r++) {
+			const v4f_t f = s->a[r][j] * inv;
+
+			for (int c = j + 1; c < size; c++)
+				s->a[r][c] -= f * s->a[j][c];
+			s->b[r] -= f * s->b[j];
+		}
+
+		s->a[j][j] = inv;
+	}
+
+	/* back substitution, leaving x in b */
+	for (int r = size - 1; r >= 0; r--) {
+		v4f_t x = s->b[r];
+
+		for (int c = r + 1; c < size; c++)
+			x -= s->a[r][c] * s->b[c];
+
+		s->b[r] = v4f_select(singular, v4f_splat(0.0f), x * s->a[r][r]);
+	}
+
+	return singular;
+}
+
+/*
+ * Gather four systems into the lanes: lane k of a[r][c] is row r, column c of
+ * system k. A short block goes a lane at a time, padded with the identity so
+ * the unused lanes aren't singular. For vec3 and vec4 a whole block is a
+ * transpose per column instead, since scalar inserts into a vector that is
+ * then loaded whole stall on store forwarding.
+ */
+
+#define GATHER_SOLVE_SCALAR(S, A, B, COUNT, SIZE) do {                             \
+		for (size_t k = (COUNT); k < 4; k++)                               \
+			for (int r = 0; r < (SIZE); r++)                           \
+				(S)->a[r][r][k] = 1.0f;                            \
+		for (size_t k = 0; k < (COUNT); k++) {                             \
+			for (int c = 0; c < (SIZE); c++)                           \
+				for (int r = 0; r < (SIZE); r++)                   \
+					(S)->a[r][c][k] = (A)[k].cols[c]._v[r];    \
+			for (int r = 0; r < (SIZE); r++)                           \
+				(S)->b[r][k] = (B)[k]._v[r];                       \
+		}                                                                  \
+	} while (0)
+
+#define GATHER_SOLVE_VECTOR(S, A, B, SIZE) do {                                    \
+		for (int c = 0; c < (SIZE); c++) {                                 \
+			v4f_t rows[4];                                             \
+			v4f_gather(rows, &(A)[0].cols[c]._v, sizeof((A)[0]), 4,    \
+				v4f_splat(0.0f));                                  \
+			for (int r = 0; r < (SIZE); r++)                           \
+				(S)->a[r][c] = rows[r];                            \
+		}                                                                  \
+		v4f_t rows[4];                                                     \
+		v4f_gather(rows, &(B)[0]._v, sizeof((B)[0]), 4, v4f_splat(0.0f));  \
+		for (int r = 0; r < (SIZE); r++)                                   \
+			(S)->b[r] = rows[r];                                       \
+	} while (0)
+
+static inline void
+gather_solve_m2(struct solve_block *s, const mat2 *a, const vec2 *b, size_t count) {
+	GATHER_SOLVE_SCALAR(s, a, b, count, 2);
+}
+
+static inline void
+gather_solve_m3(struct solve_block *s, const mat3 *a, const vec3 *b, size_t count) {
+	if (count < 4)
+		GATHER_SOLVE_SCALAR(s, a, b, count, 3);
+	else
+		GATHER_SOLVE_VECTOR(s, a, b, 3);
+}
+
+static inline void
+gather_solve_m4(struct solve_block *s, const mat4 *a, const vec4 *b, size_t count) {
+	if (count < 4)
+		GATHER_SOLVE_SCALAR(s, a, b, count, 4);
+	else
+		GATHER_SOLVE_VECTOR(s, a, b, 4);
+}
+
+/* And back out again, with the padding lane of a vec3 zero */
+
+static inline void
+scatter_solve_m2(vec2 *x, const struct solve_block *s, size_t count) {
+	for (size_t k = 0; k < count; k++)
+		x[k] = vec2(s->b[0][k], s->b[1][k]);
+}
+
+static inline void
+scatter_solve_m3(vec3 *x, const struct solve_block *s, size_t count) {
+	const v4f_t b[4] = { s->b[0], s->b[1], s->b[2], v4f_splat(0.0f) };
+	v4f_scatter(&x->_v, sizeof(*x), b, count);
+}
+
+static inline void
+scatter_solve_m4(vec4 *x, const struct solve_block *s, size_t count) {
+	v4f_scatter(&x->_v, sizeof(*x), s->b, count);
+}
+
+#define SOLVE_ARRAY(SUFFIX, MAT, VEC, SIZE)                                        \
+size_t                                                                             \
+solve ## SUFFIX ## _array(VEC *x, const MAT *a, const VEC *b, size_t n,            \
+		bool pivot, bool *singular) {                                      \
+	PROFILE_FUNCTION();                                                        \
+	size_t count = 0;                                                          \
+	for (size_t i = 0; i < n; i += 4) {                                        \
+		const size_t block = BLOCK_COUNT(i, n);                            \
+		struct solve_block s = { 0 };                                      \
+		gather_solve_ ## SUFFIX(&s, a + i, b + i, block);                  \
+		/* separate calls so each is specialised on pivot */               \
+		const v4i_t mask = pivot ? solve_block(&s, SIZE, true)             \
+			: solve_block(&s, SIZE, false);                            \
+		scatter_solve_ ## SUFFIX(x + i, &s, block);                        \
+		for (size_t k = 0; k < block; k++) {                               \
+			count += mask[k] != 0;                                     \
+			if (singular != NULL)                                      \
+				singular[i + k] = mask[k] != 0;                    \
+		}                                                                  \
+	}                                                                          \
+	return count;                                                              \
+}
+
+SOLVE_ARRAY(m2, mat2, vec2, 2)
+SOLVE_ARRAY(m3, mat3, vec3, 3)
+SOLVE_ARRAY(m4, mat4, vec4, 4)
+
+/*
+ * Symmetric eigen-decomposition
+ *
+ * Cyclic Jacobi on four matrices at once: each rotation zeroes one
+ * off-diagonal pair, and a sweep of the three pairs shrinks what is left off
+ * the diagonal quadratically once it is small. The rotations accumulate into
+ * the eigenvectors. See Golub and Van Loan, Matrix Computations, 8.4.
+ */
+
+#define EIGEN_MAX_SWEEPS 8
+
+struct eigen_block {
+	v4f_t a[3][3];
+	v4f_t v[3][3];  /* row, column */
+};
+
+/* Zero a[p][q], with r the other index */
+static inline void
+jacobi_rotate(struct eigen_block *e, int p, int q, int r) {
+	const v4f_t apq = e->a[p][q];
+	const v4i_t rotate = v4f_abs(apq) > 0.0f;
+
+	/* t = tan of the rotation angle, the smaller root of t^2 + 2 tau t - 1 */
+	const v4f_t tau = (e->a[q][q] - e->a[p][p]) / (2.0f * v4f_select(rotate, apq, v4f_splat(1.0f)));
+	const v4u_t sign = (v4u_t) tau & (v4u_t) v4f_splat(-0.0f);
+	const v4f_t root = v4f_select(v4f_abs(tau) < 1e18f, v4f_sqrt(1.0f + tau * tau), v4f_abs(tau));
+	v4f_t t = (v4f_t) ((v4u_t) (1.0f / (v4f_abs(tau) + root)) | sign);
+	t = v4f_select(rotate, t, v4f_splat(0.0f));
+
+	const v4f_t c = 1.0f / v4f_sqrt(1.0f + t * t);
+	const v4f_t s = t * c;
+
+	e->a[p][p] -= t * apq;
+	e->a[q][q] += t * apq;
+	e->a[p][q] = e->a[q][p] = v4f_splat(0.0f);
+
+	const v4f_t arp = e->a[r][p], arq = e->a[r][q];
+	e->a[r][p] = e->a[p][r] = c * arp - s * arq;
+	e->a[r][q] = e->a[q][r] = s * arp + c * arq;
+
+	for (int k = 0; k < 3; k++) {
+		const v4f_t vkp = e->v[k][p], vkq = e->v[k][q];
+		e->v[k][p] = c * vkp - s * vkq;
+		e->v[k][q] = s * vkp + c * vkq;
+	}
+}
+
+/* Swap eigenpairs i and j where the value of j is larger */
+static inline void
+eigen_order(struct eigen_block *e, int i, int j) {
+	const v4i_t swap = e->a[j][j] > e->a[i][i];
+
+	const v4f_t ai = e->a[i][i];
+	e->a[i][i] = v4f_select(swap, e->a[j][j], ai);
+	e->a[j][j] = v4f_select(swap, ai, e->a[j][j]);
+
+	for (int k = 0; k < 3; k++) {
+		const v4f_t vi = e->v[k][i];
+		e->v[k][i] = v4f_select(swap, e->v[k][j], vi);
+		e->v[k][j] = v4f_select(swap, vi, e->v[k][j]);
+	}
+}
+
+static inline void
+eigen_block(struct eigen_block *e) {
+	for (int k = 0; k < 3; k++)
+		for (int j = 0; j < 3; j++)
+			e->v[k][j] = v4f_splat(k == j ? 1.0f : 0.0f);
+
+	/*
+	 * Work on the matrix divided by its largest entry, so the squares below
+	 * neither overflow nor vanish into denormals. A division, since the
+	 * reciprocal of a denormal overflows.
+	 */
+	v4f_t largest = { 0.0f };
+
+	for (int r = 0; r < 3; r++)
+		for (int c = r; c < 3; c++)
+			largest = v4f_max(largest, v4f_abs(e->a[r][c]));
+
+	const v4f_t scale = v4f_select(largest > 0.0f, largest, v4f_splat(1.0f));
+
+	for (int r = 0; r < 3; r++)
+		for (int c = 0; c < 3; c++)
+			e->a[r][c] /= scale;
+
+	const v4f_t off_diagonal = e->a[0][1] * e->a[0][1] + e->a[0][2] * e->a[0][2] + e->a[1][2] * e->a[1][2];
+	const v4f_t norm = e->a[0][0] * e->a[0][0] + e->a[1][1] * e->a[1][1] + e->a[2][2] * e->a[2][2]
+		+ 2.0f * off_diagonal;
+
+	/* done when what's off the diagonal is lost in rounding of what's on it */
+	const v4f_t done = norm * (__FLT_EPSILON__ * __FLT_EPSILON__);
+
+	for (int sweep = 0; sweep < EIGEN_MAX_SWEEPS; sweep++) {
+		const v4f_t off = e->a[0][1] * e->a[0][1] + e->a[0][2] * e->a[0][2] + e->a[1][2] * e->a[1][2];
+		const v4i_t more = off > done;
+
+		if (!(more[0] | more[1] | more[2] | more[3]))
+			break;
+
+		jacobi_rotate(e, 0, 1, 2);
+		jacobi_rotate(e, 0, 2, 1);
+		jacobi_rotate(e, 1, 2, 0);
+	}
+
+	for (int k = 0; k < 3; k++)
+		e->a[k][k] *= scale;
+
+	eigen_order(e, 0, 1);
+	eigen_order(e, 1, 2);
+	eigen_order(e, 0, 1);
+
+	/* make it a rotation: flip the last vector if the basis is left-handed */
+	const v4f_t det = e->v[0][2] * (e->v[1][0] * e->v[2][1] - e->v[2][0] * e->v[1][1])
+		+ e->v[1][2] * (e->v[2][0] * e->v[0][1] - e->v[0][0] * e->v[2][1])
+		+ e->v[2][2] * (e->v[0][0] * e->v[1][1] - e->v[1][0] * e->v[0][1]);
+	const v4u_t flip = (v4u_t) (det < 0.0f) & (v4u_t) v4f_splat(-0.0f);
+
+	for (int k = 0; k < 3; k++)
+		e->v[k][2] = (v4f_t) ((v4u_t) e->v[k][2] ^ flip);
+}
+
+void
+eigensymm3_array(vec3 *values, mat3 *vectors, const mat3 *m, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		struct eigen_block e = { 0 };
+
+		/* the upper triangle, lane k from m[i + k]; the lanes past a short block are zero */
+		for (int c = 0; c < 3; c++) {
+			v4f_t rows[4];
+			v4f_gather(rows, &m[i].cols[c]._v, sizeof(mat3), count, v4f_splat(0.0f));
+
+			for (int r = 0; r <= c; r++)
+				e.a[r][c] = e.a[c][r] = rows[r];
+		}
+
+		eigen_block(&e);
+
+		for (size_t k = 0; k < count; k++) {
+			values[i + k] = vec3(e.a[0][0][k], e.a[1][1][k], e.a[2][2][k]);
+			vectors[i + k] = (mat3) {{
+				vec3(e.v[0][0][k], e.v[1][0][k], e.v[2][0][k]),
+				vec3(e.v[0][1][k], e.v[1][1][k], e.v[2][1][k]),
+				vec3(e.v[0][2][k], e.v[1][2][k], e.v[2][2][k]),
+			}};
+		}
+	}
+}
+
+/*
+ * Re-orthonormalization
+ *
+ * Four matrices at a time, lane k of c[j][r] being row r of column j of
+ * matrix k. Polar is Newton's iteration X = (g X + X^-T / g) / 2, where
+ * X^-T is the cofactor matrix over the determinant and g is Higham's scaling,
+ * which gets it to the rotation in a handful of steps even from a scaled
+ * matrix. See Higham, Functions of Matrices, 8.3 and 8.9.
+ */
+
+#define POLAR_MAX_ITERATIONS 10
+
+/* Once a step changes nothing by this much, the next would be lost in rounding */
+#define POLAR_CONVERGED 1e-4f
+
+struct orthonormal_block {
+	v4f_t c[3][3];
+};
+
+static inline v4f_t
+dot3_lanes(const v4f_t a[3], const v4f_t b[3]) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static inline void
+cross3_lanes(v4f_t out[3], const v4f_t a[3], const v4f_t b[3]) {
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static inline void
+gram_schmidt_block(struct orthonormal_block *o) {
+	v4f_t *x = o->c[0], *y = o->c[1];
+
+	const v4f_t lx = 1.0f / v4f_sqrt(dot3_lanes(x, x));
+	for (int r = 0; r < 3; r++)
+		x[r] *= lx;
+
+	const v4f_t d = dot3_lanes(x, y);
+	for (int r = 0; r < 3; r++)
+		y[r] -= d * x[r];
+
+	const v4f_t ly = 1.0f / v4f_sqrt(dot3_lanes(y, y));
+	for (int r = 0; r < 3; r++)
+		y[r] *= ly;
+
+	cross3_lanes(o->c[2], x, y);
+}
+
+/* X (3 - X^T X) / 2 */
+static inline void
+polar_step_block(struct orthonormal_block *o) {
+	v4f_t s[3][3];
+
+	for (int a = 0; a < 3; a++)
+		for (int b = a; b < 3; b++)
+			s[a][b] = s[b][a] = dot3_lanes(o->c[a], o->c[b]);
+
+	struct orthonormal_block x = *o;
+
+	for (int j = 0; j < 3; j++)
+		for (int r = 0; r < 3; r++)
+			o->c[j][r] = 1.5f * x.c[j][r]
+				- 0.5f * (x.c[0][r] * s[0][j] + x.c[1][r] * s[1][j] + x.c[2][r] * s[2][j]);
+}
+
+static inline void
+polar_block(struct orthonormal_block *o) {
+	for (int i = 0; i < POLAR_MAX_ITERATIONS; i++) {
+		/* The columns of the cofactor matrix, which is X^-T det(X) */
+		v4f_t cof[3][3];
+		cross3_lanes(cof[0], o->c[1], o->c[2]);
+		cross3_lanes(cof[1], o->c[2], o->c[0]);
+		cross3_lanes(cof[2], o->c[0], o->c[1]);
+
+		const v4f_t inv_det = 1.0f / dot3_lanes(o->c[0], cof[0]);
+
+		v4f_t norm = { 0.0f }, inv_norm = { 0.0f };
+		for (int j = 0; j < 3; j++) {
+			norm += dot3_lanes(o->c[j], o->c[j]);
+			inv_norm += dot3_lanes(cof[j], cof[j]);
+		}
+
+		/* g = sqrt(|X^-1| / |X|), in Frobenius norms */
+		const v4f_t g = v4f_sqrt(v4f_sqrt(inv_norm * inv_det * inv_det / norm));
+		const v4f_t a = 0.5f * g, b = 0.5f * inv_det / g;
+
+		v4f_t change = { 0.0f };
+		for (int j = 0; j < 3; j++) {
+			for (int r = 0; r < 3; r++) {
+				const v4f_t next = a * o->c[j][r] + b * cof[j][r];
+				change = v4f_max(change, v4f_abs(next - o->c[j][r]));
+				o->c[j][r] = next;
+			}
+		}
+
+		const v4i_t more = change > POLAR_CONVERGED;
+		if (!(more[0] | more[1] | more[2] | more[3]))
+			break;
+	}
+}
+
+static inline void
+orthonormal_block(struct orthonormal_block *o, enum orthonormalize method) {
+	switch (method) {
+	case ORTHONORMALIZE_GRAM_SCHMIDT:
+		gram_schmidt_block(o);
+		break;
+	case ORTHONORMALIZE_POLAR_STEP:
+		polar_step_block(o);
+		break;
+	case ORTHONORMALIZE_POLAR:
+		polar_block(o);
+		break;
+	}
+}
+
+/* The columns of four matrices into the lanes, a short block padded with the identity */
+#define GATHER_ORTHONORMAL(O, M, COUNT) do {                                           \
+		for (int j = 0; j < 3; j++) {                                          \
+			const v4f_t unit = { j == 0, j == 1, j == 2, 0.0f };           \
+			v4f_t rows[4];                                                 \
+			v4f_gather(rows, &(M)[0].cols[j]._v, sizeof((M)[0]), (COUNT), unit); \
+			for (int r = 0; r < 3; r++)                                    \
+				(O)->c[j][r] = rows[r];                                \
+		}                                                                      \
+	} while (0)
+
+void
+orthonormalizem3_array(mat3 *dst, const mat3 *m, size_t n, enum orthonormalize method) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		struct orthonormal_block o;
+
+		GATHER_ORTHONORMAL(&o, m + i, count);
+		orthonormal_block(&o, method);
+
+		for (size_t k = 0; k < count; k++) {
+			dst[i + k] = (mat3) {{
+				vec3(o.c[0][0][k], o.c[0][1][k], o.c[0][2][k]),
+				vec3(o.c[1][0][k], o.c[1][1][k], o.c[1][2][k]),
+				vec3(o.c[2][0][k], o.c[2][1][k], o.c[2][2][k]),
+			}};
+		}
+	}
+}
+
+void
+orthonormalizem4_array(mat4 *dst, const mat4 *m, size_t n, enum orthonormalize method) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		struct orthonormal_block o;
+
+		GATHER_ORTHONORMAL(&o, m + i, count);
+		orthonormal_block(&o, method);
+
+		for (size_t k = 0; k < count; k++) {
+			const mat4 a = m[i + k];
+
+			dst[i + k] = (mat4) {{
+				vec4(o.c[0][0][k], o.c[0][1][k], o.c[0][2][k], a.cols[0].w),
+				vec4(o.c[1][0][k], o.c[1][1][k], o.c[1][2][k], a.cols[1].w),
+				vec4(o.c[2][0][k], o.c[2][1][k], o.c[2][2][k], a.cols[2].w),
+				a.cols[3],
+			}};
+		}
+	}
+}
@@ -28,22 +28,35 @@
  *
  */
 
+#ifndef MATRIX_H
+#define MATRIX_H
+
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define M_SWIZZLE
+#ifdef MATRIX_PROFILE
+/* The profiling counters are side effects, which const functions mustn't have */
+#define pure
+#else
 #define pure __attribute__((const))
+#endif
 
 typedef float v4f_t __attribute__((vector_size (sizeof(float) * 4)));
 /*
  * Vector types must be a power of two in GCC, so we just make vec3 the same
  * size as vec4. Unfortunately, this means we can't use vec3 to swizzle a vec4,
- * because it extends the whole width of the vec4.
+ * because it extends the whole width of the vec4. Use swizzle() instead.
  */
 //typedef float v3f_t __attribute__((vector_size (sizeof(float) * 3)));
 typedef v4f_t v3f_t;
 typedef float v2f_t __attribute__((vector_size (sizeof(float) * 2)));
 
+/* The type of a comparison between two of the above: each lane is all ones or all zeroes */
+typedef int v4i_t __attribute__((vector_size (sizeof(int) * 4)));
+typedef int v2i_t __attribute__((vector_size (sizeof(int) * 2)));
+
 union vec2 {
 	v2f_t _v;
 
@@ -52,6 +65,14 @@ union vec2 {
 	};
 
 	/* no rgba for vec2 */
+
+#ifdef __cplusplus
+	/* The C++ spelling of the vec2() macro, see matrix.hpp */
+	vec2() = default;
+	constexpr explicit vec2(float s) : _v{s, s} {}
+	constexpr vec2(float x_, float y_) : _v{x_, y_} {}
+	constexpr explicit vec2(v2f_t v) : _v(v) {}
+#endif
 };
 static_assert(sizeof(union vec2) == 8, "wrong size for vec2");
 
@@ -65,6 +86,15 @@ union vec3 {
 	struct {
 		float r, g, b;
 	};
+
+#ifdef __cplusplus
+	/* The padding lane is kept at zero, as the C constructors do */
+	vec3() = default;
+	constexpr explicit vec3(float s) : _v{s, s, s, 0} {}
+	constexpr vec3(float x_, float y_, float z_) : _v{x_, y_, z_, 0} {}
+	constexpr vec3(vec2 v, float z_) : _v{v._v[0], v._v[1], z_, 0} {}
+	constexpr explicit vec3(v3f_t v) : _v(v) {}
+#endif
 };
 static_assert(sizeof(union vec3) == 16, "wrong size for vec3");
 
@@ -84,7 +114,7 @@ union vec4 {
 	 * least do some of the swizzles.
 	 *
 	 * Unfortunately, since sizeof(v3f_t) == sizeof(v4f_t), we can't
-	 * do swizzles like .xyz or .yzw.
+	 * do swizzles like .xyz or .yzw. See swizzle() for those.
 	 *
 	 */
 #ifdef M_SWIZZLE
@@ -93,6 +123,15 @@ union vec4 {
 		v2f_t zw;
 	};
 #endif
+
+#ifdef __cplusplus
+	vec4() = default;
+	constexpr explicit vec4(float s) : _v{s, s, s, s} {}
+	constexpr vec4(float x_, float y_, float z_, float w_) : _v{x_, y_, z_, w_} {}
+	constexpr vec4(vec2 v, float z_, float w_) : _v{v._v[0], v._v[1], z_, w_} {}
+	constexpr vec4(vec3 v, float w_) : _v{v._v[0], v._v[1], v._v[2], w_} {}
+	constexpr explicit vec4(v4f_t v) : _v(v) {}
+#endif
 };
 static_assert(sizeof(union vec4) == 16, "wrong size for vec4");
 
@@ -107,22 +146,69 @@ typedef union vec4 vec4;
 
 union mat2 {
 	vec2 cols[2];
+
+#ifdef __cplusplus
+	/* As in GLSL, a single number fills the diagonal */
+	mat2() = default;
+	constexpr explicit mat2(float d) : cols{{d, 0}, {0, d}} {}
+	constexpr mat2(vec2 c0, vec2 c1) : cols{c0, c1} {}
+#endif
 };
 static_assert(sizeof(union mat2) == 8 * 2, "wrong size for mat2");
 
 union mat3 {
 	vec3 cols[3];
+
+#ifdef __cplusplus
+	mat3() = default;
+	constexpr explicit mat3(float d) : cols{{d, 0, 0}, {0, d, 0}, {0, 0, d}} {}
+	constexpr mat3(vec3 c0, vec3 c1, vec3 c2) : cols{c0, c1, c2} {}
+#endif
 };
 static_assert(sizeof(union mat3) == 16 * 3, "wrong size for mat3");
 
 union mat4 {
 	vec4 cols[4];
+
+#ifdef __cplusplus
+	mat4() = default;
+	constexpr explicit mat4(float d)
+		: cols{{d, 0, 0, 0}, {0, d, 0, 0}, {0, 0, d, 0}, {0, 0, 0, d}} {}
+	constexpr mat4(vec4 c0, vec4 c1, vec4 c2, vec4 c3) : cols{c0, c1, c2, c3} {}
+#endif
 };
 static_assert(sizeof(union mat4) == 16 * 4, "wrong size for mat4");
 
+/*
+ * A 2D affine transform, named as in GLSL for its three columns of two rows:
+ * the linear part and then the translation, with the last row (0, 0, 1) of
+ * the mat3 it stands for left out. 24 bytes against a mat3's 48.
+ */
+union mat3x2 {
+	vec2 cols[3];
+
+#ifdef __cplusplus
+	mat3x2() = default;
+	constexpr explicit mat3x2(float d) : cols{{d, 0}, {0, d}, {0, 0}} {}
+	constexpr mat3x2(vec2 c0, vec2 c1, vec2 c2) : cols{c0, c1, c2} {}
+#endif
+};
+static_assert(sizeof(union mat3x2) == 8 * 3, "wrong size for mat3x2");
+
 typedef union mat2 mat2;
 typedef union mat3 mat3;
 typedef union mat4 mat4;
+typedef union mat3x2 mat3x2;
+
+/*
+ * Quaternions are kept in a vec4, as in GLM: (x, y, z) is the vector part and
+ * w is the scalar part. The typedef is only there to document intent.
+ */
+typedef vec4 quat;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 // Uses a funky trick to overload the function based on the number of arguments
 #define COUNT_ARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, X, ...) X
@@ -194,6 +280,73 @@ pure vec4 vec4f2v2(float, float, vec2);
 #define vec3(...) OVERLOAD_ARGS(VEC3_ARGS_, __VA_ARGS__)
 #define vec4(...) OVERLOAD_ARGS(VEC4_ARGS_, __VA_ARGS__)
 
+/*
+ * Swizzles
+ *
+ * GLSL's v.zyx can't be done with members, so instead
+ *     swizzle(v, z, y, x)
+ * picks the named components out of v in the given order, with one shuffle
+ * instruction. The number of components decides whether the result is a
+ * vec2, vec3 or vec4. Either xyzw or rgba names may be used, and v may be
+ * any size of vector so long as the components exist: as in GLSL, naming
+ * one it doesn't have, such as the w of a vec3, doesn't compile.
+ *
+ * The indices must be compile-time constants, which is why this has to be
+ * a macro around __builtin_shufflevector (clang, or GCC 12 and later).
+ */
+
+#define SWIZZLE_INDEX_x 0
+#define SWIZZLE_INDEX_y 1
+#define SWIZZLE_INDEX_z 2
+#define SWIZZLE_INDEX_w 3
+#define SWIZZLE_INDEX_r 0
+#define SWIZZLE_INDEX_g 1
+#define SWIZZLE_INDEX_b 2
+#define SWIZZLE_INDEX_a 3
+
+// The second operand is zero, and only selected from for the padding lane of a vec3
+#define SWIZZLE_SHUFFLE(V, ...) \
+	__builtin_shufflevector((V)._v, (__typeof__((V)._v)) { 0 }, __VA_ARGS__)
+
+// Its first lane: 4 after a vec3 or vec4, 2 after a vec2
+#define SWIZZLE_ZERO(V) (sizeof((V)._v) / sizeof(float))
+
+// The index of component A of V, which must be one V has; a struct is the
+// only place a static assertion can go inside an expression
+#define SWIZZLE_SIZE(V) _Generic((V), vec2: 2, vec3: 3, vec4: 4)
+#define SWIZZLE_INDEX(V, A) (SWIZZLE_INDEX_ ## A + 0 * sizeof(struct {     \
+	_Static_assert(SWIZZLE_INDEX_ ## A < SWIZZLE_SIZE(V),              \
+		"swizzle of a component the vector doesn't have");          \
+	int unused;                                                        \
+    }))
+
+#define SWIZZLE_2(V, A, B) ((vec2) { SWIZZLE_SHUFFLE(V    \
+    , SWIZZLE_INDEX(V, A)                                  \
+    , SWIZZLE_INDEX(V, B)                                  \
+    ) })
+#define SWIZZLE_3(V, A, B, C) ((vec3) { SWIZZLE_SHUFFLE(V \
+    , SWIZZLE_INDEX(V, A)                                  \
+    , SWIZZLE_INDEX(V, B)                                  \
+    , SWIZZLE_INDEX(V, C)                                  \
+    , SWIZZLE_ZERO(V)                                      \
+    ) })
+#define SWIZZLE_4(V, A, B, C, D) ((vec4) { SWIZZLE_SHUFFLE(V \
+    , SWIZZLE_INDEX(V, A)                                  \
+    , SWIZZLE_INDEX(V, B)                                  \
+    , SWIZZLE_INDEX(V, C)                                  \
+    , SWIZZLE_INDEX(V, D)                                  \
+    ) })
+
+#define swizzle(V, ...) CONCAT(SWIZZLE_, COUNT_ARGS(__VA_ARGS__))(V, __VA_ARGS__)
+
+/* The common sub-vectors */
+#define xy(V)  swizzle(V, x, y)
+#define yz(V)  swizzle(V, y, z)
+#define zw(V)  swizzle(V, z, w)
+#define xyz(V) swizzle(V, x, y, z)
+#define yzw(V) swizzle(V, y, z, w)
+#define rgb(V) swizzle(V, r, g, b)
+
 #define GENERIC_VEC(FN, A) _Generic((A)                        \
     , vec2: FN ## v2                                           \
     , vec3: FN ## v3                                           \
@@ -217,6 +370,150 @@ pure vec3 normalizev3(vec3);
 pure vec4 normalizev4(vec4);
 #define normalize(A) GENERIC_VEC(normalize, A)(A)
 
+/*
+ * Common functions
+ *
+ * These are component-wise, as in GLSL, and work on the whole _v vector at
+ * once rather than on each component in turn.
+ *
+ * abs, div and fma would clash with the C standard library, so their
+ * overloaded forms are spelled vabs, vdiv and vfma.
+ */
+
+pure vec2 addv2(vec2, vec2);
+pure vec3 addv3(vec3, vec3);
+pure vec4 addv4(vec4, vec4);
+#define add(A, B) GENERIC_VEC(add, A)(A, B)
+
+pure vec2 subv2(vec2, vec2);
+pure vec3 subv3(vec3, vec3);
+pure vec4 subv4(vec4, vec4);
+#define sub(A, B) GENERIC_VEC(sub, A)(A, B)
+
+pure vec2 mulv2(vec2, vec2);
+pure vec3 mulv3(vec3, vec3);
+pure vec4 mulv4(vec4, vec4);
+#define mul(A, B) GENERIC_VEC(mul, A)(A, B)
+
+pure vec2 divv2(vec2, vec2);
+pure vec3 divv3(vec3, vec3);
+pure vec4 divv4(vec4, vec4);
+#define vdiv(A, B) GENERIC_VEC(div, A)(A, B)
+
+/* Multiply every component by the same number */
+pure vec2 scalev2(vec2, float);
+pure vec3 scalev3(vec3, float);
+pure vec4 scalev4(vec4, float);
+#define scale(A, S) GENERIC_VEC(scale, A)(A, S)
+
+/* x * (1 - a) + y * a */
+pure vec2 mixv2(vec2 x, vec2 y, float a);
+pure vec3 mixv3(vec3 x, vec3 y, float a);
+pure vec4 mixv4(vec4 x, vec4 y, float a);
+#define mix(X, Y, A) GENERIC_VEC(mix, X)(X, Y, A)
+
+pure vec2 clampv2(vec2 x, float min_val, float max_val);
+pure vec3 clampv3(vec3 x, float min_val, float max_val);
+pure vec4 clampv4(vec4 x, float min_val, float max_val);
+#define clamp(X, L, H) GENERIC_VEC(clamp, X)(X, L, H)
+
+pure vec2 minv2(vec2, vec2);
+pure vec3 minv3(vec3, vec3);
+pure vec4 minv4(vec4, vec4);
+#define min(A, B) GENERIC_VEC(min, A)(A, B)
+
+pure vec2 maxv2(vec2, vec2);
+pure vec3 maxv3(vec3, vec3);
+pure vec4 maxv4(vec4, vec4);
+#define max(A, B) GENERIC_VEC(max, A)(A, B)
+
+pure vec2 absv2(vec2);
+pure vec3 absv3(vec3);
+pure vec4 absv4(vec4);
+#define vabs(A) GENERIC_VEC(abs, A)(A)
+
+/* 0.0 where x < edge, otherwise 1.0 */
+pure vec2 stepv2(float edge, vec2 x);
+pure vec3 stepv3(float edge, vec3 x);
+pure vec4 stepv4(float edge, vec4 x);
+#define step(E, X) GENERIC_VEC(step, X)(E, X)
+
+/* Hermite interpolation between 0.0 and 1.0 for edge0 < x < edge1 */
+pure vec2 smoothstepv2(float edge0, float edge1, vec2 x);
+pure vec3 smoothstepv3(float edge0, float edge1, vec3 x);
+pure vec4 smoothstepv4(float edge0, float edge1, vec4 x);
+#define smoothstep(E0, E1, X) GENERIC_VEC(smoothstep, X)(E0, E1, X)
+
+/*
+ * a * b + c
+ *
+ * This is contracted into a fused multiply-add instruction only where the
+ * target has one and the compiler is allowed to (e.g. -mfma -ffp-contract=fast).
+ */
+pure vec2 fmav2(vec2 a, vec2 b, vec2 c);
+pure vec3 fmav3(vec3 a, vec3 b, vec3 c);
+pure vec4 fmav4(vec4 a, vec4 b, vec4 c);
+#define vfma(A, B, C) GENERIC_VEC(fma, A)(A, B, C)
+
+/*
+ * Array variants of the common functions
+ *
+ * Each applies the function to n elements, writing to dst. The destination
+ * may be the same array as any of the sources.
+ */
+
+void addv2_array(vec2 *dst, const vec2 *a, const vec2 *b, size_t n);
+void addv3_array(vec3 *dst, const vec3 *a, const vec3 *b, size_t n);
+void addv4_array(vec4 *dst, const vec4 *a, const vec4 *b, size_t n);
+
+void subv2_array(vec2 *dst, const vec2 *a, const vec2 *b, size_t n);
+void subv3_array(vec3 *dst, const vec3 *a, const vec3 *b, size_t n);
+void subv4_array(vec4 *dst, const vec4 *a, const vec4 *b, size_t n);
+
+void mulv2_array(vec2 *dst, const vec2 *a, const vec2 *b, size_t n);
+void mulv3_array(vec3 *dst, const vec3 *a, const vec3 *b, size_t n);
+void mulv4_array(vec4 *dst, const vec4 *a, const vec4 *b, size_t n);
+
+void divv2_array(vec2 *dst, const vec2 *a, const vec2 *b, size_t n);
+void divv3_array(vec3 *dst, const vec3 *a, const vec3 *b, size_t n);
+void divv4_array(vec4 *dst, const vec4 *a, const vec4 *b, size_t n);
+
+void scalev2_array(vec2 *dst, const vec2 *a, float s, size_t n);
+void scalev3_array(vec3 *dst, const vec3 *a, float s, size_t n);
+void scalev4_array(vec4 *dst, const vec4 *a, float s, size_t n);
+
+void mixv2_array(vec2 *dst, const vec2 *x, const vec2 *y, float a, size_t n);
+void mixv3_array(vec3 *dst, const vec3 *x, const vec3 *y, float a, size_t n);
+void mixv4_array(vec4 *dst, const vec4 *x, const vec4 *y, float a, size_t n);
+
+void clampv2_array(vec2 *dst, const vec2 *x, float min_val, float max_val, size_t n);
+void clampv3_array(vec3 *dst, const vec3 *x, float min_val, float max_val, size_t n);
+void clampv4_array(vec4 *dst, const vec4 *x, float min_val, float max_val, size_t n);
+
+void minv2_array(vec2 *dst, const vec2 *a, const vec2 *b, size_t n);
+void minv3_array(vec3 *dst, const vec3 *a, const vec3 *b, size_t n);
+void minv4_array(vec4 *dst, const vec4 *a, const vec4 *b, size_t n);
+
+void maxv2_array(vec2 *dst, const vec2 *a, const vec2 *b, size_t n);
+void maxv3_array(vec3 *dst, const vec3 *a, const vec3 *b, size_t n);
+void maxv4_array(vec4 *dst, const vec4 *a, const vec4 *b, size_t n);
+
+void absv2_array(vec2 *dst, const vec2 *a, size_t n);
+void absv3_array(vec3 *dst, const vec3 *a, size_t n);
+void absv4_array(vec4 *dst, const vec4 *a, size_t n);
+
+void stepv2_array(vec2 *dst, float edge, const vec2 *x, size_t n);
+void stepv3_array(vec3 *dst, float edge, const vec3 *x, size_t n);
+void stepv4_array(vec4 *dst, float edge, const vec4 *x, size_t n);
+
+void smoothstepv2_array(vec2 *dst, float edge0, float edge1, const vec2 *x, size_t n);
+void smoothstepv3_array(vec3 *dst, float edge0, float edge1, const vec3 *x, size_t n);
+void smoothstepv4_array(vec4 *dst, float edge0, float edge1, const vec4 *x, size_t n);
+
+void fmav2_array(vec2 *dst, const vec2 *a, const vec2 *b, const vec2 *c, size_t n);
+void fmav3_array(vec3 *dst, const vec3 *a, const vec3 *b, const vec3 *c, size_t n);
+void fmav4_array(vec4 *dst, const vec4 *a, const vec4 *b, const vec4 *c, size_t n);
+
 /* Diagonal matrix with the diagonal elements all of the given value */
 pure mat2 mat2f1(float);
 pure mat3 mat3f1(float);
@@ -251,8 +548,9 @@ pure mat4 mat4f16(float, float, float, float, float, float, float, float, float,
 
 
 #define MAT3_ARGS_1(A) _Generic((A)                            \
-    , float: mat3f1                                            \
-    , mat2:  mat3m2                                            \
+    , float:  mat3f1                                           \
+    , mat2:   mat3m2                                           \
+    , mat3x2: mat3m3x2                                         \
     )
 
 #define MAT3_ARGS_3(A, B, C) _Generic((A)                      \
@@ -265,9 +563,10 @@ pure mat4 mat4f16(float, float, float, float, float, float, float, float, float,
 
 
 #define MAT4_ARGS_1(A) _Generic((A)                            \
-    , float: mat4f1                                            \
-    , mat2:  mat4m2                                            \
-    , mat3:  mat4m3                                            \
+    , float:  mat4f1                                           \
+    , mat2:   mat4m2                                           \
+    , mat3:   mat4m3                                           \
+    , mat3x2: mat4m3x2                                         \
     )
 
 #define MAT4_ARGS_4(A, B, C, D) _Generic((A)                   \
@@ -294,16 +593,202 @@ pure mat3 transposem3(mat3);
 pure mat4 transposem4(mat4);
 #define transpose(M) GENERIC_MAT(transpose, M)(M)
 
+void transposem4_array(mat4 *dst, const mat4 *m, size_t n);
+
+/*
+ * Conversion to and from row-major float arrays, as used by some physics
+ * engines and file formats: 16 floats per matrix, or 12 for the affine form
+ * which leaves out the last row (0, 0, 0, 1). The float arrays need only be
+ * aligned as floats.
+ */
+
+void to_row_majorm4_array(float *dst, const mat4 *m, size_t n);
+void from_row_majorm4_array(mat4 *dst, const float *rows, size_t n);
+
+void to_row_major_affinem4_array(float *dst, const mat4 *m, size_t n);
+void from_row_major_affinem4_array(mat4 *dst, const float *rows, size_t n);
+
 pure mat2 multm2(mat2, mat2);
 pure mat3 multm3(mat3, mat3);
 pure mat4 multm4(mat4, mat4);
-#define mult(M, N) GENERIC_MAT(mult, M)(M, N)
+
+/* m * v, transforming a column vector */
+pure vec2 multm2v2(mat2, vec2);
+pure vec3 multm3v3(mat3, vec3);
+pure vec4 multm4v4(mat4, vec4);
+
+/* v * m, a row vector, which is transpose(m) * v */
+pure vec2 multv2m2(vec2, mat2);
+pure vec3 multv3m3(vec3, mat3);
+pure vec4 multv4m4(vec4, mat4);
+
+/*
+ * mult(A, B) is chosen by the type of A, then by B for a matrix. The inner
+ * defaults only keep the unchosen branches valid: a wrong B still fails to
+ * convert when the function is called.
+ */
+#define mult(A, B) _Generic((A)                                       \
+    , mat2: _Generic((B), vec2: multm2v2, default: multm2)           \
+    , mat3: _Generic((B), vec3: multm3v3, default: multm3)           \
+    , mat4: _Generic((B), vec4: multm4v4, default: multm4)           \
+    , mat3x2: _Generic((B), vec2: multm3x2v2, default: multm3x2)     \
+    , vec2: multv2m2                                                 \
+    , vec3: multv3m3                                                 \
+    , vec4: multv4m4                                                 \
+    )(A, B)
+
+/* dst[i] = m * v[i], each lane of v[i] broadcast over a column of m */
+void multm4v4_array(vec4 *dst, mat4 m, const vec4 *v, size_t n);
 
 pure float determinantm2(mat2);
 pure float determinantm3(mat3);
 pure float determinantm4(mat4);
-#define determinant(M) GENERIC_MAT(determinant, M)(M)
-
-// We only support the inverse of a 4x4 matrix
+#define determinant(M) _Generic((M)                             \
+    , mat2: determinantm2                                      \
+    , mat3: determinantm3                                      \
+    , mat4: determinantm4                                      \
+    , mat3x2: determinantm3x2                                  \
+    )(M)
+
+// We only support the inverse of a 4x4 matrix, and of a 2D affine transform
 pure mat4 inversem4(mat4);
-#define inverse(M) inversem4(M)
+#define inverse(M) _Generic((M), mat3x2: inversem3x2, default: inversem4)(M)
+
+/*
+ * 2D affine transforms
+ *
+ * A mat3x2 acts as the mat3 whose last row is (0, 0, 1). mult(m, v) takes v
+ * as a point, so translates it, and mult(a, b) is the transform that applies
+ * b and then a, as for mat3. mat3(m) gives that mat3, and mat4(m) the same
+ * transform of the xy plane, for a shader.
+ */
+
+pure mat3x2 mat3x2f1(float);
+pure mat3x2 mat3x2v2(vec2, vec2, vec2);
+pure mat3x2 mat3x2f6(float, float, float, float, float, float);
+
+/* The upper two rows of an affine mat3 */
+pure mat3x2 mat3x2m3(mat3);
+pure mat3 mat3m3x2(mat3x2);
+pure mat4 mat4m3x2(mat3x2);
+
+#define MAT3X2_ARGS_1(A) _Generic((A)                          \
+    , float: mat3x2f1                                          \
+    , mat3:  mat3x2m3                                          \
+    )
+#define MAT3X2_ARGS_3(A, B, C) mat3x2v2
+#define MAT3X2_ARGS_6(A, ...) mat3x2f6
+
+#define mat3x2(...) OVERLOAD_ARGS(MAT3X2_ARGS_, __VA_ARGS__)
+
+pure mat3x2 multm3x2(mat3x2, mat3x2);
+pure vec2 multm3x2v2(mat3x2, vec2);
+
+/* Of the linear part, the area scale */
+pure float determinantm3x2(mat3x2);
+
+/* Undefined, as for inversem4, if the determinant is near zero */
+pure mat3x2 inversem3x2(mat3x2);
+
+/* dst[i] = a[i] * b[i], e.g. parents and children of a sprite hierarchy */
+void multm3x2_array(mat3x2 *dst, const mat3x2 *a, const mat3x2 *b, size_t n);
+
+/* dst[i] = m * v[i], two points to a vector */
+void multm3x2v2_array(vec2 *dst, mat3x2 m, const vec2 *v, size_t n);
+
+void inversem3x2_array(mat3x2 *dst, const mat3x2 *m, size_t n);
+
+/*
+ * Sine and cosine of each of the four lanes at once.
+ *
+ * The argument is reduced to [-pi/4, pi/4] in three parts (Cody-Waite) and
+ * then the Cephes minimax polynomials are evaluated on all lanes, so there
+ * are no calls into libm and no branches. For |x| <= 8192 the absolute
+ * error of both results is below 2^-23 (about 1.2e-7); beyond that the range
+ * reduction runs out of bits and the results become meaningless, though
+ * finite, up to |x| = 2^30. Past that, and for Inf and NaN, both are NaN.
+ */
+void sincosv4(vec4 x, vec4 *s, vec4 *c);
+
+/* s[i] = sin(x[i]) and c[i] = cos(x[i]), four at a time */
+void sincos_array(float *s, float *c, const float *x, size_t n);
+
+/*
+ * Batched rotations
+ *
+ * These build n rotations at once, four per sincosv4() call, with the
+ * arithmetic done across four rotations in the lanes of a vector.
+ *
+ * Euler angles are in radians and are applied about x first, then y, then z,
+ * i.e. the matrix is Rz(angle.z) * Ry(angle.y) * Rx(angle.x).
+ *
+ * Axis-angle rotations turn anticlockwise about the axis, which must be of
+ * unit length.
+ */
+
+void eulerm3_array(mat3 *dst, const vec3 *angles, size_t n);
+void eulerm4_array(mat4 *dst, const vec3 *angles, size_t n);
+void eulerq_array(quat *dst, const vec3 *angles, size_t n);
+
+void axis_anglem3_array(mat3 *dst, const vec3 *axes, const float *angles, size_t n);
+void axis_anglem4_array(mat4 *dst, const vec3 *axes, const float *angles, size_t n);
+void axis_angleq_array(quat *dst, const vec3 *axes, const float *angles, size_t n);
+
+/*
+ * Batched linear systems
+ *
+ * These solve a[i] * x[i] = b[i] for n small systems, four at a time, by
+ * Gaussian elimination rather than forming an inverse. With pivot set each
+ * column is pivoted on its largest entry, which is slower but copes with
+ * systems that have small or zero entries on the diagonal.
+ *
+ * A system is singular when a pivot is within rounding (n * FLT_EPSILON) of
+ * zero relative to the largest entry of its matrix. Its x is set to zero, and
+ * singular[i] is set if singular isn't NULL. The number of singular systems
+ * is returned.
+ */
+
+size_t solvem2_array(vec2 *x, const mat2 *a, const vec2 *b, size_t n, bool pivot, bool *singular);
+size_t solvem3_array(vec3 *x, const mat3 *a, const vec3 *b, size_t n, bool pivot, bool *singular);
+size_t solvem4_array(vec4 *x, const mat4 *a, const vec4 *b, size_t n, bool pivot, bool *singular);
+
+/*
+ * Eigenvalues and eigenvectors of symmetric 3x3 matrices, four at a time by
+ * Jacobi rotations. Only the upper triangle of each m[i] is read.
+ *
+ * The values come out largest first, and column j of vectors[i] is the unit
+ * eigenvector of value j, so m[i] = vectors * diag(values) * transpose(vectors).
+ * The vectors are orthonormal and right-handed: a rotation from the axes to the
+ * principal axes, as for an oriented bounding box or an inertia frame.
+ */
+void eigensymm3_array(vec3 *values, mat3 *vectors, const mat3 *m, size_t n);
+
+/*
+ * Rotation matrices that have drifted, say from integrating angular velocity
+ * by repeated multiplication, pulled back to rotations four at a time.
+ *
+ * GRAM_SCHMIDT keeps the direction of the first column, makes the second
+ * perpendicular to it and crosses them for the third: the cheapest, but the
+ * error all goes into the later axes. POLAR finds the nearest rotation, by
+ * Newton iteration on the polar decomposition, which treats the axes alike.
+ * POLAR_STEP is a single Newton-Schulz step towards it: not exact, but it
+ * squares the error, which is enough for a correction made every frame.
+ *
+ * The matrices should be near rotations, with a positive determinant. For
+ * mat4 only the upper 3x3 is changed, so any scale in it is removed while the
+ * translation and the last row are kept. dst may be m.
+ */
+enum orthonormalize {
+	ORTHONORMALIZE_GRAM_SCHMIDT,
+	ORTHONORMALIZE_POLAR_STEP,
+	ORTHONORMALIZE_POLAR,
+};
+
+void orthonormalizem3_array(mat3 *dst, const mat3 *m, size_t n, enum orthonormalize method);
+void orthonormalizem4_array(mat4 *dst, const mat4 *m, size_t n, enum orthonormalize method);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,511 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * C++ operators over the matrix.h types.
+ *
+ * The vec and mat unions are the same ones the C functions take, so values
+ * pass straight between the two. Their constructors, declared in matrix.h,
+ * are constexpr and spelled as in GLSL:
+ *     constexpr mat4 id = mat4(1.0f);
+ *     vec4 p = vec4(xyz, 1.0f);
+ *
+ * Matrix products are lazy. P * V * M is a glsl::product that becomes a mat4
+ * when one is wanted, but P * V * M * v is worked out right to left as three
+ * matrix-vector products without forming any matrix.
+ *
+ * Arrays are handled by expression templates: glsl::view() wraps memory, and
+ * an expression of views, values and matrices is evaluated one element at a
+ * time when it is assigned to a view, in a single loop with no temporary
+ * arrays. For a chain of matrices on the left the product is taken once,
+ * before the loop.
+ *     glsl::view(out, n) = glsl::view(a, n) * s + glsl::view(b, n);
+ *     glsl::view(clip, n) = P * V * M * glsl::view(points, n);
+ */
+
+#ifndef MATRIX_HPP
+#define MATRIX_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+#include "matrix.h"
+
+/*
+ * _Generic is C only. The overloads below take the place of the macros, which
+ * would otherwise trample on names like std::min.
+ */
+#undef COUNT_ARGS_
+#undef COUNT_ARGS
+#undef CONCAT_
+#undef CONCAT
+#undef GET_OVERLOADED
+#undef OVERLOAD_ARGS
+#undef VEC2_ARGS_1
+#undef VEC2_ARGS_2
+#undef VEC3_ARGS_1
+#undef VEC3_ARGS_2
+#undef VEC3_ARGS_3
+#undef VEC4_ARGS_1
+#undef VEC4_ARGS_2
+#undef VEC4_ARGS_3
+#undef VEC4_ARGS_4
+#undef vec2
+#undef vec3
+#undef vec4
+#undef SWIZZLE_INDEX_x
+#undef SWIZZLE_INDEX_y
+#undef SWIZZLE_INDEX_z
+#undef SWIZZLE_INDEX_w
+#undef SWIZZLE_INDEX_r
+#undef SWIZZLE_INDEX_g
+#undef SWIZZLE_INDEX_b
+#undef SWIZZLE_INDEX_a
+#undef SWIZZLE_SHUFFLE
+#undef SWIZZLE_ZERO
+#undef SWIZZLE_SIZE
+#undef SWIZZLE_INDEX
+#undef SWIZZLE_2
+#undef SWIZZLE_3
+#undef SWIZZLE_4
+#undef swizzle
+#undef xy
+#undef yz
+#undef zw
+#undef xyz
+#undef yzw
+#undef rgb
+#undef GENERIC_VEC
+#undef dot
+#undef length
+#undef normalize
+#undef add
+#undef sub
+#undef mul
+#undef vdiv
+#undef scale
+#undef mix
+#undef clamp
+#undef min
+#undef max
+#undef vabs
+#undef step
+#undef smoothstep
+#undef vfma
+#undef MAT2_ARGS_1
+#undef MAT2_ARGS_2
+#undef MAT2_ARGS_4
+#undef MAT3_ARGS_1
+#undef MAT3_ARGS_3
+#undef MAT3_ARGS_9
+#undef MAT4_ARGS_1
+#undef MAT4_ARGS_4
+#undef MAT4_ARGS_16
+#undef mat2
+#undef mat3
+#undef mat4
+#undef MAT3X2_ARGS_1
+#undef MAT3X2_ARGS_3
+#undef MAT3X2_ARGS_6
+#undef mat3x2
+#undef GENERIC_MAT
+#undef transpose
+#undef mult
+#undef determinant
+#undef inverse
+#undef pure
+
+/*
+ * Vectors
+ *
+ * Component-wise, as in GLSL. The operators are inline so that the compiler
+ * sees through them; the named functions call the C library.
+ */
+
+#define VECTOR_OPERATORS(V, N)                                                 \
+	constexpr V operator+(V a, V b) { return V(a._v + b._v); }            \
+	constexpr V operator-(V a, V b) { return V(a._v - b._v); }            \
+	constexpr V operator*(V a, V b) { return V(a._v * b._v); }            \
+	constexpr V operator/(V a, V b) { return V(a._v / b._v); }            \
+	constexpr V operator*(V a, float s) { return V(a._v * s); }           \
+	constexpr V operator*(float s, V a) { return V(s * a._v); }           \
+	constexpr V operator/(V a, float s) { return V(a._v / s); }           \
+	constexpr V operator-(V a) { return V(-a._v); }                       \
+	inline V &operator+=(V &a, V b) { a._v += b._v; return a; }           \
+	inline V &operator-=(V &a, V b) { a._v -= b._v; return a; }           \
+	inline V &operator*=(V &a, V b) { a._v *= b._v; return a; }           \
+	inline V &operator/=(V &a, V b) { a._v /= b._v; return a; }           \
+	inline V &operator*=(V &a, float s) { a._v *= s; return a; }          \
+	inline V &operator/=(V &a, float s) { a._v /= s; return a; }          \
+	inline float dot(V a, V b) { return dotv##N(a, b); }                  \
+	inline float length(V a) { return lengthv##N(a); }                   \
+	inline V normalize(V a) { return normalizev##N(a); }                  \
+	inline V mix(V a, V b, float t) { return mixv##N(a, b, t); }          \
+	inline V clamp(V a, float lo, float hi) { return clampv##N(a, lo, hi); } \
+	inline V min(V a, V b) { return minv##N(a, b); }                      \
+	inline V max(V a, V b) { return maxv##N(a, b); }                      \
+	inline V abs(V a) { return absv##N(a); }                              \
+	inline V step(float edge, V a) { return stepv##N(edge, a); }          \
+	inline V smoothstep(float lo, float hi, V a) { return smoothstepv##N(lo, hi, a); }
+
+VECTOR_OPERATORS(vec2, 2)
+VECTOR_OPERATORS(vec3, 3)
+VECTOR_OPERATORS(vec4, 4)
+
+#undef VECTOR_OPERATORS
+
+/*
+ * Matrices
+ *
+ * A matrix times a column vector is the matrix's columns scaled by the lanes
+ * of the vector and summed, as multm4v4 does. A row vector times a matrix,
+ * v * m, is transpose(m) * v.
+ */
+
+constexpr vec2
+operator*(mat2 m, vec2 v) {
+	return vec2(m.cols[0]._v * v._v[0] + m.cols[1]._v * v._v[1]);
+}
+
+constexpr vec3
+operator*(mat3 m, vec3 v) {
+	return vec3(m.cols[0]._v * v._v[0] + m.cols[1]._v * v._v[1]
+		+ m.cols[2]._v * v._v[2]);
+}
+
+constexpr vec4
+operator*(mat4 m, vec4 v) {
+	return vec4(m.cols[0]._v * v._v[0] + m.cols[1]._v * v._v[1]
+		+ m.cols[2]._v * v._v[2] + m.cols[3]._v * v._v[3]);
+}
+
+inline vec2 operator*(vec2 v, mat2 m) { return multv2m2(v, m); }
+inline vec3 operator*(vec3 v, mat3 m) { return multv3m3(v, m); }
+inline vec4 operator*(vec4 v, mat4 m) { return multv4m4(v, m); }
+
+inline mat2 transpose(mat2 m) { return transposem2(m); }
+inline mat3 transpose(mat3 m) { return transposem3(m); }
+inline mat4 transpose(mat4 m) { return transposem4(m); }
+
+inline float determinant(mat2 m) { return determinantm2(m); }
+inline float determinant(mat3 m) { return determinantm3(m); }
+inline float determinant(mat4 m) { return determinantm4(m); }
+
+inline mat4 inverse(mat4 m) { return inversem4(m); }
+
+/*
+ * 2D affine transforms are products as for the mat3 they stand for, but
+ * eager: they are cheap enough that there is nothing to reorder.
+ */
+
+constexpr vec2
+operator*(mat3x2 m, vec2 v) {
+	return vec2(m.cols[0]._v * v._v[0] + m.cols[1]._v * v._v[1] + m.cols[2]._v);
+}
+
+constexpr mat3x2
+operator*(mat3x2 a, mat3x2 b) {
+	return mat3x2(vec2(a.cols[0]._v * b.cols[0]._v[0] + a.cols[1]._v * b.cols[0]._v[1]),
+		vec2(a.cols[0]._v * b.cols[1]._v[0] + a.cols[1]._v * b.cols[1]._v[1]),
+		a * b.cols[2]);
+}
+
+inline mat3x2 &operator*=(mat3x2 &a, mat3x2 b) { return a = a * b; }
+
+inline float determinant(mat3x2 m) { return determinantm3x2(m); }
+inline mat3x2 inverse(mat3x2 m) { return inversem3x2(m); }
+
+namespace glsl {
+
+template <class M> struct is_matrix : std::false_type {};
+template <> struct is_matrix<mat2> : std::true_type {};
+template <> struct is_matrix<mat3> : std::true_type {};
+template <> struct is_matrix<mat4> : std::true_type {};
+
+template <class V> struct is_vector : std::false_type {};
+template <> struct is_vector<vec2> : std::true_type {};
+template <> struct is_vector<vec3> : std::true_type {};
+template <> struct is_vector<vec4> : std::true_type {};
+
+/* The eager product, one column at a time */
+constexpr mat2 multiply(mat2 a, mat2 b) { return mat2(a * b.cols[0], a * b.cols[1]); }
+
+constexpr mat3
+multiply(mat3 a, mat3 b) {
+	return mat3(a * b.cols[0], a * b.cols[1], a * b.cols[2]);
+}
+
+constexpr mat4
+multiply(mat4 a, mat4 b) {
+	return mat4(a * b.cols[0], a * b.cols[1], a * b.cols[2], a * b.cols[3]);
+}
+
+template <class M> struct column_of;
+template <> struct column_of<mat2> { typedef vec2 type; };
+template <> struct column_of<mat3> { typedef vec3 type; };
+template <> struct column_of<mat4> { typedef vec4 type; };
+
+template <class L, class R> struct product;
+
+template <class M> struct matrix_of { typedef M type; };
+template <class L, class R> struct matrix_of<product<L, R>> { typedef typename matrix_of<R>::type type; };
+
+template <class M> struct is_product : std::false_type {};
+template <class L, class R> struct is_product<product<L, R>> : std::true_type {};
+
+/* Either a matrix or a product of them */
+template <class M> struct is_matrix_chain
+	: std::integral_constant<bool, is_matrix<M>::value || is_product<M>::value> {};
+
+constexpr mat2 evaluate(mat2 m) { return m; }
+constexpr mat3 evaluate(mat3 m) { return m; }
+constexpr mat4 evaluate(mat4 m) { return m; }
+
+template <class L, class R>
+constexpr typename matrix_of<R>::type
+evaluate(const product<L, R> &p) {
+	return multiply(evaluate(p.l), evaluate(p.r));
+}
+
+/*
+ * An unevaluated l * r. The operands are held by value, so a product can
+ * outlive the matrices it was made from.
+ */
+template <class L, class R>
+struct product {
+	typedef typename matrix_of<R>::type matrix_type;
+	typedef typename column_of<matrix_type>::type column_type;
+
+	L l;
+	R r;
+
+	constexpr operator matrix_type() const { return evaluate(*this); }
+};
+
+template <class L, class R>
+constexpr product<L, R>
+make_product(const L &l, const R &r) {
+	static_assert(std::is_same<typename matrix_of<L>::type, typename matrix_of<R>::type>::value,
+		"matrices of different sizes");
+	return product<L, R>{l, r};
+}
+
+template <class L, class R, class M,
+	class = typename std::enable_if<is_matrix_chain<M>::value>::type>
+constexpr product<product<L, R>, M>
+operator*(const product<L, R> &p, const M &m) {
+	return make_product(p, m);
+}
+
+template <class M, class L, class R,
+	class = typename std::enable_if<is_matrix<M>::value>::type>
+constexpr product<M, product<L, R>>
+operator*(const M &m, const product<L, R> &p) {
+	return make_product(m, p);
+}
+
+/* Right to left: each step is a matrix times a vector */
+template <class L, class R>
+constexpr typename product<L, R>::column_type
+operator*(const product<L, R> &p, const typename product<L, R>::column_type &v) {
+	return p.l * (p.r * v);
+}
+
+} /* namespace glsl */
+
+constexpr glsl::product<mat2, mat2> operator*(mat2 a, mat2 b) { return glsl::make_product(a, b); }
+constexpr glsl::product<mat3, mat3> operator*(mat3 a, mat3 b) { return glsl::make_product(a, b); }
+constexpr glsl::product<mat4, mat4> operator*(mat4 a, mat4 b) { return glsl::make_product(a, b); }
+
+inline mat2 &operator*=(mat2 &a, mat2 b) { return a = glsl::multiply(a, b); }
+inline mat3 &operator*=(mat3 &a, mat3 b) { return a = glsl::multiply(a, b); }
+inline mat4 &operator*=(mat4 &a, mat4 b) { return a = glsl::multiply(a, b); }
+
+namespace glsl {
+
+/*
+ * Arrays
+ *
+ * Each node of an expression has size() and operator[](i), which works out
+ * element i of its result from element i of its operands.
+ */
+
+template <class E>
+struct expression {
+	const E &self() const { return static_cast<const E &>(*this); }
+};
+
+/* Plain values in an array expression are used for every element */
+template <class T>
+struct uniform : expression<uniform<T>> {
+	T value;
+
+	explicit uniform(const T &v) : value(v) {}
+
+	T operator[](size_t) const { return value; }
+	size_t size() const { return (size_t) -1; }
+};
+
+template <class T> struct is_value
+	: std::integral_constant<bool, std::is_arithmetic<T>::value || is_vector<T>::value> {};
+
+/* n elements of memory, which an expression can be assigned to */
+template <class T>
+class array : public expression<array<T>> {
+public:
+	typedef typename std::remove_const<T>::type value_type;
+
+	array(T *data, size_t size) : data_(data), size_(size) {}
+	array(const array &) = default;
+
+	value_type operator[](size_t i) const { return data_[i]; }
+	size_t size() const { return size_; }
+	T *data() const { return data_; }
+
+	template <class E>
+	array &
+	operator=(const expression<E> &e) {
+		const E &x = e.self();
+
+		assert(x.size() == size_);
+		for (size_t i = 0; i < size_; i++) {
+			data_[i] = x[i];
+		}
+		return *this;
+	}
+
+	/* Copies the elements, not the view */
+	array &operator=(const array &a) { return *this = static_cast<const expression<array> &>(a); }
+
+	template <class X> array &operator+=(const X &x);
+	template <class X> array &operator-=(const X &x);
+	template <class X> array &operator*=(const X &x);
+
+private:
+	T *data_;
+	size_t size_;
+};
+
+template <class T>
+array<T>
+view(T *data, size_t size) {
+	return array<T>(data, size);
+}
+
+struct plus { template <class A, class B> static auto apply(const A &a, const B &b) -> decltype(a + b) { return a + b; } };
+struct minus { template <class A, class B> static auto apply(const A &a, const B &b) -> decltype(a - b) { return a - b; } };
+struct times { template <class A, class B> static auto apply(const A &a, const B &b) -> decltype(a * b) { return a * b; } };
+struct divides { template <class A, class B> static auto apply(const A &a, const B &b) -> decltype(a / b) { return a / b; } };
+
+template <class Op, class L, class R>
+struct binary : expression<binary<Op, L, R>> {
+	L l;
+	R r;
+
+	binary(const L &l_, const R &r_) : l(l_), r(r_) { assert(l.size() == r.size() || l.size() == (size_t) -1 || r.size() == (size_t) -1); }
+
+	auto operator[](size_t i) const -> decltype(Op::apply(l[i], r[i])) { return Op::apply(l[i], r[i]); }
+	size_t size() const { return l.size() < r.size() ? l.size() : r.size(); }
+};
+
+template <class E>
+struct negate : expression<negate<E>> {
+	E e;
+
+	explicit negate(const E &e_) : e(e_) {}
+
+	auto operator[](size_t i) const -> decltype(-e[i]) { return -e[i]; }
+	size_t size() const { return e.size(); }
+};
+
+/* m * e[i], for a matrix that has already been worked out */
+template <class M, class E>
+struct transform : expression<transform<M, E>> {
+	M m;
+	E e;
+
+	transform(const M &m_, const E &e_) : m(m_), e(e_) {}
+
+	auto operator[](size_t i) const -> decltype(m * e[i]) { return m * e[i]; }
+	size_t size() const { return e.size(); }
+};
+
+#define EXPRESSION_OPERATOR(OP, NAME)                                          \
+	template <class L, class R>                                            \
+	binary<NAME, L, R>                                                     \
+	operator OP(const expression<L> &l, const expression<R> &r) {          \
+		return binary<NAME, L, R>(l.self(), r.self());                 \
+	}                                                                      \
+	                                                                       \
+	template <class L, class T,                                            \
+		class = typename std::enable_if<is_value<T>::value>::type>     \
+	binary<NAME, L, uniform<T>>                                            \
+	operator OP(const expression<L> &l, const T &r) {                      \
+		return binary<NAME, L, uniform<T>>(l.self(), uniform<T>(r));   \
+	}                                                                      \
+	                                                                       \
+	template <class T, class R,                                            \
+		class = typename std::enable_if<is_value<T>::value>::type>     \
+	binary<NAME, uniform<T>, R>                                            \
+	operator OP(const T &l, const expression<R> &r) {                      \
+		return binary<NAME, uniform<T>, R>(uniform<T>(l), r.self());   \
+	}
+
+EXPRESSION_OPERATOR(+, plus)
+EXPRESSION_OPERATOR(-, minus)
+EXPRESSION_OPERATOR(*, times)
+EXPRESSION_OPERATOR(/, divides)
+
+#undef EXPRESSION_OPERATOR
+
+/* A matrix, or a chain of them, times every element: the chain is multiplied out once */
+template <class M, class E, class = typename std::enable_if<is_matrix_chain<M>::value>::type>
+transform<typename matrix_of<M>::type, E>
+operator*(const M &m, const expression<E> &e) {
+	return transform<typename matrix_of<M>::type, E>(evaluate(m), e.self());
+}
+
+template <class E>
+negate<E>
+operator-(const expression<E> &e) {
+	return negate<E>(e.self());
+}
+
+template <class T>
+template <class X>
+array<T> &
+array<T>::operator+=(const X &x) {
+	return *this = *this + x;
+}
+
+template <class T>
+template <class X>
+array<T> &
+array<T>::operator-=(const X &x) {
+	return *this = *this - x;
+}
+
+template <class T>
+template <class X>
+array<T> &
+array<T>::operator*=(const X &x) {
+	return *this = *this * x;
+}
+
+} /* namespace glsl */
+
+#endif
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "mesh.h"
+#include "profile.h"
+#include "simd.h"
+
+int
+mesh_init(struct mesh *m, const uint32_t *indices, size_t triangle_count, size_t vertex_count, bool tangents) {
+	*m = (struct mesh) { 0 };
+
+	/* the table holds 32-bit offsets into the corners */
+	if (triangle_count > UINT32_MAX / 3 || vertex_count >= UINT32_MAX) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for (size_t i = 0; i < 3 * triangle_count; i++) {
+		if (indices[i] >= vertex_count) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	m->vertex_first = alloc_array(uint32_t, vertex_count + 1);
+	m->vertex_triangles = alloc_array(uint32_t, 3 * triangle_count);
+	m->face_normals = alloc_array(vec3, triangle_count);
+
+	if (tangents) {
+		m->face_tangents = alloc_array(vec3, triangle_count);
+		m->face_bitangents = alloc_array(vec3, triangle_count);
+	}
+
+	if (m->vertex_first == NULL || m->vertex_triangles == NULL || m->face_normals == NULL
+			|| (tangents && (m->face_tangents == NULL || m->face_bitangents == NULL))) {
+		mesh_destroy(m);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	m->indices = indices;
+	m->triangle_count = triangle_count;
+	m->vertex_count = vertex_count;
+
+	/* count the corners of each vertex, then turn the counts into offsets */
+	memset(m->vertex_first, 0, (vertex_count + 1) * sizeof(uint32_t));
+	for (size_t i = 0; i < 3 * triangle_count; i++)
+		m->vertex_first[indices[i] + 1]++;
+	for (size_t v = 0; v < vertex_count; v++)
+		m->vertex_first[v + 1] += m->vertex_first[v];
+
+	/* fill each vertex's list in order, with vertex_first[v] running ahead and then put back */
+	for (size_t i = 0; i < 3 * triangle_count; i++)
+		m->vertex_triangles[m->vertex_first[indices[i]]++] = (uint32_t) (i / 3);
+	for (size_t v = vertex_count; v > 0; v--)
+		m->vertex_first[v] = m->vertex_first[v - 1];
+	m->vertex_first[0] = 0;
+
+	return 0;
+}
+
+void
+mesh_destroy(struct mesh *m) {
+	alloc_free(m->vertex_first);
+	alloc_free(m->vertex_triangles);
+	alloc_free(m->face_normals);
+	alloc_free(m->face_tangents);
+	alloc_free(m->face_bitangents);
+
+	*m = (struct mesh) { 0 };
+}
+
+void
+mesh_update(struct mesh *m) {
+	mesh_update_faces(m, 0, m->triangle_count);
+	mesh_update_vertices(m, 0, m->vertex_count);
+}
+
+/*
+ * Faces
+ *
+ * Lane k of each vector is triangle k of the block, padded with degenerate
+ * triangles at the origin.
+ */
+
+struct triangle_block {
+	v4f_t p[3][3];          /* corner, axis */
+	v4f_t uv[3][2];
+};
+
+static inline void
+gather_triangles(struct triangle_block *b, const struct mesh *m, size_t first, size_t count, bool uvs) {
+	for (int c = 0; c < 3; c++) {
+		v4f_t p[4] = { { 0 }, { 0 }, { 0 }, { 0 } };
+		v4f_t uv[4] = { { 0 }, { 0 }, { 0 }, { 0 } };
+
+		for (size_t k = 0; k < count; k++) {
+			const uint32_t v = m->indices[3 * (first + k) + c];
+
+			p[k] = m->positions[v]._v;
+			if (uvs)
+				uv[k] = (v4f_t) { m->uvs[v].x, m->uvs[v].y, 0.0f, 0.0f };
+		}
+
+		v4f_transpose(&p[0], &p[1], &p[2], &p[3]);
+		b->p[c][0] = p[0];
+		b->p[c][1] = p[1];
+		b->p[c][2] = p[2];
+
+		if (uvs) {
+			v4f_transpose(&uv[0], &uv[1], &uv[2], &uv[3]);
+			b->uv[c][0] = uv[0];
+			b->uv[c][1] = uv[1];
+		}
+	}
+}
+
+/* Back out to vec3s, with the padding lane zero */
+static inline void
+scatter_faces(vec3 *dst, size_t first, size_t count, v4f_t x, v4f_t y, v4f_t z) {
+	const v4f_t r[4] = { x, y, z, v4f_splat(0.0f) };
+	v4f_scatter(&dst[first]._v, sizeof(vec3), r, count);
+}
+
+void
+mesh_update_faces(void *arg, size_t first, size_t count) {
+	PROFILE_FUNCTION();
+
+	struct mesh *m = arg;
+	const bool uvs = m->uvs != NULL && m->face_tangents != NULL;
+
+	for (size_t i = first; i < first + count; i += 4) {
+		const size_t block = BLOCK_COUNT(i, first + count);
+		struct triangle_block b;
+
+		gather_triangles(&b, m, i, block, uvs);
+
+		v4f_t e1[3], e2[3];
+		for (int a = 0; a < 3; a++) {
+			e1[a] = b.p[1][a] - b.p[0][a];
+			e2[a] = b.p[2][a] - b.p[0][a];
+		}
+
+		scatter_faces(m->face_normals, i, block,
+			e1[1] * e2[2] - e1[2] * e2[1],
+			e1[2] * e2[0] - e1[0] * e2[2],
+			e1[0] * e2[1] - e1[1] * e2[0]);
+
+		if (!uvs)
+			continue;
+
+		/*
+		 * Solve e = t * du + b * dv for both edges. The solution is over
+		 * the uv determinant; leaving that out, but keeping its sign,
+		 * weights by the area in texture space.
+		 */
+		const v4f_t du1 = b.uv[1][0] - b.uv[0][0], dv1 = b.uv[1][1] - b.uv[0][1];
+		const v4f_t du2 = b.uv[2][0] - b.uv[0][0], dv2 = b.uv[2][1] - b.uv[0][1];
+		const v4f_t det = du1 * dv2 - du2 * dv1;
+		const v4f_t s = v4f_select(det < 0.0f, v4f_splat(-1.0f), v4f_splat(1.0f));
+
+		v4f_t t[3], bt[3];
+		for (int a = 0; a < 3; a++) {
+			t[a] = (e1[a] * dv2 - e2[a] * dv1) * s;
+			bt[a] = (e2[a] * du1 - e1[a] * du2) * s;
+		}
+
+		scatter_faces(m->face_tangents, i, block, t[0], t[1], t[2]);
+		scatter_faces(m->face_bitangents, i, block, bt[0], bt[1], bt[2]);
+	}
+}
+
+/*
+ * Vertices
+ *
+ * The sums go a vertex at a time, and the normalization four at a time.
+ */
+
+static inline v4f_t
+sum_faces(const struct mesh *m, const vec3 *faces, size_t v) {
+	v4f_t sum = { 0 };
+
+	for (uint32_t j = m->vertex_first[v]; j < m->vertex_first[v + 1]; j++)
+		sum += faces[m->vertex_triangles[j]]._v;
+
+	return sum;
+}
+
+static inline v4f_t
+rsqrt_or_zero(v4f_t length2) {
+	return v4f_select(length2 > 0.0f, 1.0f / v4f_sqrt(length2), v4f_splat(0.0f));
+}
+
+void
+mesh_update_vertices(void *arg, size_t first, size_t count) {
+	PROFILE_FUNCTION();
+
+	struct mesh *m = arg;
+	const bool tangents = m->uvs != NULL && m->face_tangents != NULL && m->tangents != NULL;
+
+	for (size_t i = first; i < first + count; i += 4) {
+		const size_t block = BLOCK_COUNT(i, first + count);
+		v4f_t n[4] = { { 0 }, { 0 }, { 0 }, { 0 } };
+		v4f_t t[4] = { { 0 }, { 0 }, { 0 }, { 0 } };
+		v4f_t b[4] = { { 0 }, { 0 }, { 0 }, { 0 } };
+
+		for (size_t k = 0; k < block; k++) {
+			n[k] = sum_faces(m, m->face_normals, i + k);
+			if (tangents) {
+				t[k] = sum_faces(m, m->face_tangents, i + k);
+				b[k] = sum_faces(m, m->face_bitangents, i + k);
+			}
+		}
+
+		v4f_transpose(&n[0], &n[1], &n[2], &n[3]);
+
+		const v4f_t inv = rsqrt_or_zero(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		v4f_t nx = n[0] * inv, ny = n[1] * inv, nz = n[2] * inv;
+
+		if (tangents) {
+			v4f_transpose(&t[0], &t[1], &t[2], &t[3]);
+			v4f_transpose(&b[0], &b[1], &b[2], &b[3]);
+
+			/* t minus its part along n */
+			const v4f_t d = nx * t[0] + ny * t[1] + nz * t[2];
+			v4f_t tx = t[0] - nx * d, ty = t[1] - ny * d, tz = t[2] - nz * d;
+
+			/* or the axis furthest from n, which is any perpendicular at all */
+			const v4f_t length2 = tx * tx + ty * ty + tz * tz;
+			const v4i_t none = length2 <= 1e-12f * (t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+			const v4f_t ax = v4f_abs(nx), ay = v4f_abs(ny), az = v4f_abs(nz);
+			const v4i_t use_x = (ax <= ay) & (ax <= az), use_y = ~use_x & (ay <= az);
+			const v4f_t one = v4f_splat(1.0f), zero = v4f_splat(0.0f);
+			const v4f_t fx = v4f_select(use_x, one, zero), fy = v4f_select(use_y, one, zero);
+			const v4f_t fz = v4f_select(use_x | use_y, zero, one);
+			const v4f_t fd = nx * fx + ny * fy + nz * fz;
+
+			tx = v4f_select(none, fx - nx * fd, tx);
+			ty = v4f_select(none, fy - ny * fd, ty);
+			tz = v4f_select(none, fz - nz * fd, tz);
+
+			const v4f_t tinv = rsqrt_or_zero(tx * tx + ty * ty + tz * tz);
+			tx *= tinv;
+			ty *= tinv;
+			tz *= tinv;
+
+			/* handedness from which side of cross(n, t) the bitangents came out */
+			const v4f_t side = (ny * tz - nz * ty) * b[0] + (nz * tx - nx * tz) * b[1] + (nx * ty - ny * tx) * b[2];
+			v4f_t tw = v4f_select(side < 0.0f, v4f_splat(-1.0f), one);
+
+			v4f_transpose(&tx, &ty, &tz, &tw);
+
+			const v4f_t r[4] = { tx, ty, tz, tw };
+			for (size_t k = 0; k < block; k++)
+				m->tangents[i + k]._v = r[k];
+		}
+
+		scatter_faces(m->normals, i, block, nx, ny, nz);
+	}
+}
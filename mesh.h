@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Vertex normals and tangents of a deformed mesh, recomputed from its
+ * positions each frame.
+ *
+ * Each triangle's normal is the cross product of two of its edges, whose
+ * length is twice its area, so summing them around a vertex weights the
+ * triangles by area. The faces are done four at a time, across the lanes.
+ *
+ * The vertices then gather from their triangles, rather than the triangles
+ * adding into their vertices, through a table of the triangles around each
+ * vertex built once by mesh_init(). Each vertex is written by only the one
+ * job, so the two passes split into chunks for jobs.h with no atomics or
+ * locks, and the results don't depend on how the work was split:
+ *
+ *     mesh.positions = skinned;
+ *     mesh.normals = normals;
+ *
+ *     jobs_stage(&g, "faces", mesh_update_faces, &mesh, mesh.triangle_count, 1024);
+ *     jobs_access(&g, JOBS_READ | JOBS_WHOLE, mesh.positions);
+ *     jobs_access(&g, JOBS_WRITE, mesh.face_normals);
+ *
+ *     jobs_stage(&g, "vertices", mesh_update_vertices, &mesh, mesh.vertex_count, 1024);
+ *     jobs_access(&g, JOBS_READ | JOBS_WHOLE, mesh.face_normals);
+ *     jobs_access(&g, JOBS_WRITE, mesh.normals);
+ *
+ * or mesh_update(&mesh) to do both on the calling thread.
+ *
+ * With uvs and tangents set, the tangents follow the direction of increasing
+ * u, as in Lengyel's method, made perpendicular to the normal. Each
+ * triangle's tangent is weighted by its area in texture space, so triangles
+ * with degenerate uvs count for nothing. w is -1 where the uvs are mirrored,
+ * so that the bitangent is cross(normal, tangent.xyz) * w.
+ *
+ * A vertex with no area around it gets a zero normal, and a tangent along
+ * whichever axis is furthest from its normal.
+ */
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mesh {
+	const uint32_t *indices;        /* three per triangle */
+	size_t triangle_count;
+	size_t vertex_count;
+
+	/* the triangles around vertex v are from vertex_first[v] to vertex_first[v + 1] */
+	uint32_t *vertex_first;
+	uint32_t *vertex_triangles;
+
+	/* of each triangle, unnormalized */
+	vec3 *face_normals;
+	vec3 *face_tangents;            /* if initialized with tangents */
+	vec3 *face_bitangents;
+
+	/* the inputs and outputs of an update */
+	const vec3 *positions;
+	const vec2 *uvs;                /* NULL for normals only */
+	vec3 *normals;
+	vec4 *tangents;
+};
+
+/* 0 on success, or -1 with errno ENOMEM, or EINVAL for an index past vertex_count */
+int mesh_init(struct mesh *m, const uint32_t *indices, size_t triangle_count, size_t vertex_count, bool tangents);
+void mesh_destroy(struct mesh *m);
+
+/* Both passes over the whole mesh */
+void mesh_update(struct mesh *m);
+
+/* The passes, as jobs_fn: over triangles, and then over vertices */
+void mesh_update_faces(void *m, size_t first, size_t count);
+void mesh_update_vertices(void *m, size_t first, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdint.h>
+
+#include "normal.h"
+#include "profile.h"
+#include "simd.h"
+
+/* Lane k is vector k of the block */
+struct normal_block {
+	v4f_t x, y, z, w;
+};
+
+/* And its encoding: two components for octahedral, four for snorm */
+struct code_block {
+	v4i_t c[4];
+};
+
+static const struct {
+	int components;
+	int bytes;              /* of each component */
+	float max;              /* the integer for 1.0 */
+} formats[] = {
+	[NORMAL_OCT16] = { 2, 2, 32767.0f },
+	[NORMAL_OCT8] = { 2, 1, 127.0f },
+	[NORMAL_SNORM16] = { 4, 2, 32767.0f },
+	[NORMAL_SNORM8] = { 4, 1, 127.0f },
+};
+
+static inline v4f_t
+v4f_copysign(v4f_t magnitude, v4f_t sign) {
+	const v4u_t bit = (v4u_t) v4f_splat(-0.0f);
+
+	return (v4f_t) (((v4u_t) magnitude & ~bit) | ((v4u_t) sign & bit));
+}
+
+/* Round to the nearest, halves away from zero, as the GPU's snorm conversion does */
+static inline v4i_t
+quantize(v4f_t v, float max) {
+	v = v4f_min(v4f_max(v, v4f_splat(-1.0f)), v4f_splat(1.0f)) * max;
+
+	return __builtin_convertvector(v + v4f_copysign(v4f_splat(0.5f), v), v4i_t);
+}
+
+/* -max - 1 is also -1 */
+static inline v4f_t
+dequantize(v4i_t c, float max) {
+	return v4f_max(__builtin_convertvector(c, v4f_t) * (1.0f / max), v4f_splat(-1.0f));
+}
+
+static inline void
+normalize_block(struct normal_block *b) {
+	const v4f_t length2 = b->x * b->x + b->y * b->y + b->z * b->z;
+	const v4f_t inv = 1.0f / v4f_sqrt(v4f_select(length2 > 0.0f, length2, v4f_splat(1.0f)));
+
+	b->x *= inv;
+	b->y *= inv;
+	b->z *= inv;
+}
+
+/*
+ * Octahedral mapping, after Cigolle et al., A Survey of Efficient
+ * Representations for Independent Unit Vectors, JCGT 2014: project onto the
+ * octahedron |x| + |y| + |z| = 1, and fold the lower half out over the
+ * corners of the square.
+ */
+static inline void
+oct_encode(v4f_t *u, v4f_t *v, const struct normal_block *b) {
+	v4f_t s = v4f_abs(b->x) + v4f_abs(b->y) + v4f_abs(b->z);
+	s = v4f_select(s > 0.0f, s, v4f_splat(1.0f));
+
+	const v4f_t px = b->x / s, py = b->y / s;
+	const v4i_t lower = b->z < 0.0f;
+
+	*u = v4f_select(lower, v4f_copysign(1.0f - v4f_abs(py), px), px);
+	*v = v4f_select(lower, v4f_copysign(1.0f - v4f_abs(px), py), py);
+}
+
+static inline void
+oct_decode(struct normal_block *b, v4f_t u, v4f_t v) {
+	b->z = 1.0f - v4f_abs(u) - v4f_abs(v);
+
+	/* unfold the lower half */
+	const v4f_t t = v4f_max(-b->z, v4f_splat(0.0f));
+
+	b->x = u - v4f_copysign(t, u);
+	b->y = v - v4f_copysign(t, v);
+
+	normalize_block(b);
+}
+
+/*
+ * A tangent's handedness goes in the lowest bit of the second octahedral
+ * component, 1 for negative. The component is moved by one towards its
+ * unrounded value when the bit needs to change, so it stays in range.
+ */
+static inline v4i_t
+set_handedness(v4i_t c, v4f_t unrounded, float max, v4f_t w) {
+	const v4i_t want = (v4i_t) (w < 0.0f) & 1;
+	const v4i_t wrong = (c & 1) != want;
+	const v4f_t r = v4f_min(v4f_max(unrounded, v4f_splat(-1.0f)), v4f_splat(1.0f)) * max;
+	const v4i_t up = r > __builtin_convertvector(c, v4f_t);
+
+	return c + (wrong & ((up & 2) - 1));
+}
+
+static inline void
+encode_block(struct code_block *e, enum normal_format format, const struct normal_block *b, bool tangent) {
+	const float max = formats[format].max;
+
+	if (formats[format].components == 2) {
+		v4f_t u, v;
+		oct_encode(&u, &v, b);
+
+		e->c[0] = quantize(u, max);
+		e->c[1] = quantize(v, max);
+
+		if (tangent)
+			e->c[1] = set_handedness(e->c[1], v, max, b->w);
+	} else {
+		/* a zero vector becomes +z, as it does on the octahedron */
+		const v4f_t length2 = b->x * b->x + b->y * b->y + b->z * b->z;
+
+		e->c[0] = quantize(b->x, max);
+		e->c[1] = quantize(b->y, max);
+		e->c[2] = quantize(v4f_select(length2 > 0.0f, b->z, v4f_splat(1.0f)), max);
+		e->c[3] = tangent ? quantize(b->w, max) : (v4i_t) { 0 };
+	}
+}
+
+static inline void
+decode_block(struct normal_block *b, enum normal_format format, const struct code_block *e, bool tangent) {
+	const float max = formats[format].max;
+
+	if (formats[format].components == 2) {
+		oct_decode(b, dequantize(e->c[0], max), dequantize(e->c[1], max));
+		b->w = v4f_select((e->c[1] & 1) != 0, v4f_splat(-1.0f), v4f_splat(1.0f));
+	} else {
+		b->x = dequantize(e->c[0], max);
+		b->y = dequantize(e->c[1], max);
+		b->z = dequantize(e->c[2], max);
+		b->w = v4f_select(e->c[3] < 0, v4f_splat(-1.0f), v4f_splat(1.0f));
+		normalize_block(b);
+	}
+
+	if (!tangent)
+		b->w = v4f_splat(0.0f);
+}
+
+/*
+ * The components of count codes from element i on, through an int array
+ * rather than lane by lane, which would stall on every lane's store
+ */
+static inline void
+load_codes(struct code_block *e, enum normal_format format, const void *src, size_t i, size_t count) {
+	const int components = formats[format].components;
+	int t[16] = { 0 };
+
+	*e = (struct code_block) { 0 };
+
+	if (formats[format].bytes == 2) {
+		const int16_t *p = (const int16_t *) src + i * components;
+		for (size_t k = 0; k < count * components; k++)
+			t[k] = p[k];
+	} else {
+		const int8_t *p = (const int8_t *) src + i * components;
+		for (size_t k = 0; k < count * components; k++)
+			t[k] = p[k];
+	}
+
+	for (int j = 0; j < components; j++)
+		e->c[j] = (v4i_t) { t[j], t[components + j], t[2 * components + j], t[3 * components + j] };
+}
+
+static inline void
+store_codes(void *dst, enum normal_format format, size_t i, const struct code_block *e, size_t count) {
+	const int components = formats[format].components;
+	int t[16];
+
+	for (int j = 0; j < components; j++)
+		for (int k = 0; k < 4; k++)
+			t[k * components + j] = e->c[j][k];
+
+	if (formats[format].bytes == 2) {
+		int16_t *p = (int16_t *) dst + i * components;
+		for (size_t k = 0; k < count * components; k++)
+			p[k] = (int16_t) t[k];
+	} else {
+		int8_t *p = (int8_t *) dst + i * components;
+		for (size_t k = 0; k < count * components; k++)
+			p[k] = (int8_t) t[k];
+	}
+}
+
+static inline void
+encode(void *dst, enum normal_format format, const v4f_t *src, size_t stride, size_t n, bool tangent) {
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		struct code_block e;
+		v4f_t r[4];
+
+		/* a short block is padded with +z */
+		v4f_gather(r, (const v4f_t *) ((const char *) src + i * stride), stride, count,
+			(v4f_t) { 0.0f, 0.0f, 1.0f, 1.0f });
+
+		const struct normal_block b = { r[0], r[1], r[2], r[3] };
+		encode_block(&e, format, &b, tangent);
+		store_codes(dst, format, i, &e, count);
+	}
+}
+
+static inline void
+decode(v4f_t *dst, size_t stride, enum normal_format format, const void *src, size_t n, bool tangent) {
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		struct normal_block b;
+		struct code_block e;
+
+		load_codes(&e, format, src, i, count);
+		decode_block(&b, format, &e, tangent);
+
+		const v4f_t r[4] = { b.x, b.y, b.z, b.w };
+		v4f_scatter((v4f_t *) ((char *) dst + i * stride), stride, r, count);
+	}
+}
+
+size_t
+normal_size(enum normal_format format) {
+	return (size_t) (formats[format].components * formats[format].bytes);
+}
+
+void
+normal_encode_array(void *dst, enum normal_format format, const vec3 *src, size_t n) {
+	PROFILE_FUNCTION();
+
+	encode(dst, format, &src->_v, sizeof(vec3), n, false);
+}
+
+void
+normal_decode_array(vec3 *dst, enum normal_format format, const void *src, size_t n) {
+	PROFILE_FUNCTION();
+
+	decode(&dst->_v, sizeof(vec3), format, src, n, false);
+}
+
+void
+normal_encode_tangent_array(void *dst, enum normal_format format, const vec4 *src, size_t n) {
+	PROFILE_FUNCTION();
+
+	encode(dst, format, &src->_v, sizeof(vec4), n, true);
+}
+
+void
+normal_decode_tangent_array(vec4 *dst, enum normal_format format, const void *src, size_t n) {
+	PROFILE_FUNCTION();
+
+	decode(&dst->_v, sizeof(vec4), format, src, n, true);
+}
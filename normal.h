@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Compressed unit vectors, for normals and tangents in vertex buffers.
+ *
+ * NORMAL_OCT16 and NORMAL_OCT8 map the sphere onto a square, the octahedral
+ * encoding, and store the two coordinates as snorm integers: 4 or 2 bytes for
+ * what takes 16 as a vec3. NORMAL_SNORM16 and NORMAL_SNORM8 store x, y, z and
+ * w as snorm integers, which a GPU reads as RGBA16_SNORM or RGBA8_SNORM, and
+ * are renormalized when decoded.
+ *
+ * Decoding what was encoded is off by at most, as an angle:
+ *
+ *     NORMAL_OCT16      0.004 degrees
+ *     NORMAL_OCT8       1.0 degrees
+ *     NORMAL_SNORM16    0.002 degrees
+ *     NORMAL_SNORM8     0.4 degrees
+ *
+ * measured over 16M random directions and checked by the tests. The input
+ * should be of unit length; a zero vector encodes as +z.
+ *
+ * Tangents are a vec4 whose w is the handedness, +1 or -1. The snorm formats
+ * keep it in w; the octahedral ones in the lowest bit of the second
+ * component, which raises the octahedral bounds to 0.006 and 1.5 degrees.
+ */
+
+#ifndef NORMAL_H
+#define NORMAL_H
+
+#include <stddef.h>
+
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum normal_format {
+	NORMAL_OCT16,   /* int16_t[2] */
+	NORMAL_OCT8,    /* int8_t[2] */
+	NORMAL_SNORM16, /* int16_t[4], with w 0 for a normal */
+	NORMAL_SNORM8,  /* int8_t[4] */
+};
+
+/* The bytes of each encoded vector */
+size_t normal_size(enum normal_format format);
+
+void normal_encode_array(void *dst, enum normal_format format, const vec3 *src, size_t n);
+void normal_decode_array(vec3 *dst, enum normal_format format, const void *src, size_t n);
+
+void normal_encode_tangent_array(void *dst, enum normal_format format, const vec4 *src, size_t n);
+void normal_decode_tangent_array(vec4 *dst, enum normal_format format, const void *src, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
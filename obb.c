@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <math.h>
+
+#include "obb.h"
+#include "profile.h"
+#include "simd.h"
+
+/* Added to |R| so that a cross product of near parallel axes can't separate on rounding */
+#define PARALLEL_EPSILON 1e-6f
+
+/* Lane k is box k of the block */
+struct box_block {
+	v4f_t c[3];             /* center, by component */
+	v4f_t e[3];             /* half extents */
+	v4f_t u[3][3];          /* axis, component */
+};
+
+/* Boxes first + k * step, so a step of 0 puts one box in every lane; short blocks are padded with zeroes */
+static inline void
+gather_boxes(struct box_block *b, struct obb_arrays boxes, size_t first, size_t step, size_t count) {
+	const v4f_t zero = v4f_splat(0.0f);
+	v4f_t r[4];
+
+	v4f_gather(r, &boxes.center[first]._v, step * sizeof(vec3), count, zero);
+	b->c[0] = r[0], b->c[1] = r[1], b->c[2] = r[2];
+
+	v4f_gather(r, &boxes.half_extents[first]._v, step * sizeof(vec3), count, zero);
+	b->e[0] = r[0], b->e[1] = r[1], b->e[2] = r[2];
+
+	for (int a = 0; a < 3; a++) {
+		v4f_gather(r, &boxes.axes[first].cols[a]._v, step * sizeof(mat3), count, zero);
+		b->u[a][0] = r[0], b->u[a][1] = r[1], b->u[a][2] = r[2];
+	}
+}
+
+static inline v4f_t
+dot3(const v4f_t a[3], const v4f_t b[3]) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/*
+ * The separating axis test of Gottschalk et al., OBBTree, SIGGRAPH 1996, as
+ * set out in Ericson, Real-Time Collision Detection, 4.4.1: everything in the
+ * frame of a, with R taking b's axes into it. On each axis L the boxes
+ * project to radii ra and rb about centers d apart, and are separated on it
+ * if d > ra + rb. For a cross product the gap is over |L|.
+ */
+static inline v4i_t
+separating_axes(const struct box_block *a, const struct box_block *b, v4f_t *depth) {
+	v4f_t r[3][3], abs_r[3][3];
+
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			r[i][j] = dot3(a->u[i], b->u[j]);
+			abs_r[i][j] = v4f_abs(r[i][j]) + PARALLEL_EPSILON;
+		}
+	}
+
+	const v4f_t d[3] = { b->c[0] - a->c[0], b->c[1] - a->c[1], b->c[2] - a->c[2] };
+	v4f_t t[3];
+
+	for (int i = 0; i < 3; i++)
+		t[i] = dot3(d, a->u[i]);
+
+	v4i_t apart = { 0 };
+	v4f_t least = v4f_splat(INFINITY);
+
+	/* a's axes */
+	for (int i = 0; i < 3; i++) {
+		const v4f_t ra = a->e[i];
+		const v4f_t rb = b->e[0] * abs_r[i][0] + b->e[1] * abs_r[i][1] + b->e[2] * abs_r[i][2];
+		const v4f_t gap = ra + rb - v4f_abs(t[i]);
+
+		apart |= gap < 0.0f;
+		least = v4f_min(least, gap);
+	}
+
+	/* b's */
+	for (int j = 0; j < 3; j++) {
+		const v4f_t ra = a->e[0] * abs_r[0][j] + a->e[1] * abs_r[1][j] + a->e[2] * abs_r[2][j];
+		const v4f_t rb = b->e[j];
+		const v4f_t gap = ra + rb - v4f_abs(t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j]);
+
+		apart |= gap < 0.0f;
+		least = v4f_min(least, gap);
+	}
+
+	/* a[i] x b[j] */
+	for (int i = 0; i < 3; i++) {
+		const int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+
+		for (int j = 0; j < 3; j++) {
+			const int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+
+			const v4f_t ra = a->e[i1] * abs_r[i2][j] + a->e[i2] * abs_r[i1][j];
+			const v4f_t rb = b->e[j1] * abs_r[i][j2] + b->e[j2] * abs_r[i][j1];
+			const v4f_t gap = ra + rb - v4f_abs(t[i2] * r[i1][j] - t[i1] * r[i2][j]);
+
+			apart |= gap < 0.0f;
+
+			if (depth != NULL) {
+				/* |a[i] x b[j]|^2 = 1 - (a[i] . b[j])^2 */
+				const v4f_t length2 = 1.0f - r[i][j] * r[i][j];
+				const v4f_t scaled = gap / v4f_sqrt(v4f_max(length2, v4f_splat(1e-6f)));
+
+				least = v4f_select(length2 > 1e-6f, v4f_min(least, scaled), least);
+			}
+		}
+	}
+
+	if (depth != NULL)
+		*depth = v4f_select(apart, v4f_splat(0.0f), least);
+
+	return apart;
+}
+
+static size_t
+overlap_blocks(bool *overlap, float *depth, struct obb_arrays a, size_t a_step, struct obb_arrays b, size_t n) {
+	size_t hits = 0;
+
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		struct box_block ba, bb;
+		v4f_t d;
+
+		gather_boxes(&ba, a, i * a_step, a_step, count);
+		gather_boxes(&bb, b, i, 1, count);
+
+		const v4i_t apart = separating_axes(&ba, &bb, depth != NULL ? &d : NULL);
+
+		for (size_t k = 0; k < count; k++) {
+			overlap[i + k] = !apart[k];
+			hits += !apart[k];
+			if (depth != NULL)
+				depth[i + k] = d[k];
+		}
+	}
+
+	return hits;
+}
+
+size_t
+obb_overlap_array(bool *overlap, float *depth, const struct obb *a, struct obb_arrays b, size_t n) {
+	PROFILE_FUNCTION();
+
+	const struct obb_arrays one = { &a->center, &a->half_extents, &a->axes };
+
+	return overlap_blocks(overlap, depth, one, 0, b, n);
+}
+
+size_t
+obb_overlap_pairs_array(bool *overlap, float *depth, struct obb_arrays a, struct obb_arrays b, size_t n) {
+	PROFILE_FUNCTION();
+
+	return overlap_blocks(overlap, depth, a, 1, b, n);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Overlap tests between oriented boxes, for the narrow phase of collision.
+ *
+ * A box is its center, its half extents along its own axes, and the axes as
+ * the columns of a rotation mat3. Two boxes are apart if and only if one of
+ * 15 axes separates them: the three axes of each box, and the cross products
+ * of one axis from each (Gottschalk's separating axis test). The tests are
+ * done for four pairs at a time, across the lanes, with no branches.
+ *
+ * Many boxes are kept as separate arrays, as a transform store keeps them.
+ * One box can be tested against all of them, or the pairs of two such sets
+ * taken element by element:
+ *
+ *     struct obb_arrays others = { centers, half_extents, rotations };
+ *     size_t hits = obb_overlap_array(overlap, depth, &player, others, n);
+ *
+ * overlap[i] is set where the boxes overlap, touching counting as overlap.
+ * depth, if not NULL, gets the penetration: the least distance along any of
+ * the 15 axes that would move them apart, or 0 where they are apart. Cross
+ * products of nearly parallel axes are left out of the depth, as they are
+ * covered by the faces.
+ */
+
+#ifndef OBB_H
+#define OBB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct obb {
+	vec3 center;
+	vec3 half_extents;
+	mat3 axes;
+};
+
+struct obb_arrays {
+	const vec3 *center;
+	const vec3 *half_extents;
+	const mat3 *axes;
+};
+
+/* a against b[i], for i < n: the number that overlap */
+size_t obb_overlap_array(bool *overlap, float *depth, const struct obb *a, struct obb_arrays b, size_t n);
+
+/* a[i] against b[i] */
+size_t obb_overlap_pairs_array(bool *overlap, float *depth, struct obb_arrays a, struct obb_arrays b, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
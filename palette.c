@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "alloc.h"
+#include "palette.h"
+#include "profile.h"
+#include "simd.h"
+
+/* Whether any bit of a and b differs, so -0 and 0 differ and a NaN matches itself */
+static inline bool
+differs_bitwise(const mat4 *a, const mat4 *b) {
+	const v4i_t d =
+		((v4i_t) a->cols[0]._v ^ (v4i_t) b->cols[0]._v) |
+		((v4i_t) a->cols[1]._v ^ (v4i_t) b->cols[1]._v) |
+		((v4i_t) a->cols[2]._v ^ (v4i_t) b->cols[2]._v) |
+		((v4i_t) a->cols[3]._v ^ (v4i_t) b->cols[3]._v);
+
+	return (d[0] | d[1] | d[2] | d[3]) != 0;
+}
+
+/* Whether any element moved by more than tolerance, or became a NaN */
+static inline bool
+differs_approx(const mat4 *a, const mat4 *b, v4f_t tolerance) {
+	/* Not max() of the differences, which would lose a NaN */
+	const v4i_t within =
+		(v4f_abs(a->cols[0]._v - b->cols[0]._v) <= tolerance) &
+		(v4f_abs(a->cols[1]._v - b->cols[1]._v) <= tolerance) &
+		(v4f_abs(a->cols[2]._v - b->cols[2]._v) <= tolerance) &
+		(v4f_abs(a->cols[3]._v - b->cols[3]._v) <= tolerance);
+
+	return (within[0] & within[1] & within[2] & within[3]) == 0;
+}
+
+int
+palette_init(struct palette *p, size_t count, float tolerance, size_t gap) {
+	*p = (struct palette) { 0 };
+
+	/* Ranges are at least one unchanged matrix apart */
+	p->current = alloc_array(mat4, count);
+	p->ranges = alloc_array(struct palette_range, count / 2 + 1);
+
+	if (p->current == NULL || p->ranges == NULL) {
+		palette_destroy(p);
+		return -1;
+	}
+
+	p->count = count;
+	p->tolerance = tolerance;
+	p->gap = gap;
+	p->invalid = true;
+
+	return 0;
+}
+
+void
+palette_destroy(struct palette *p) {
+	alloc_free(p->current);
+	alloc_free(p->ranges);
+
+	*p = (struct palette) { 0 };
+}
+
+size_t
+palette_update(struct palette *p, const mat4 *next) {
+	PROFILE_FUNCTION();
+
+	const v4f_t tolerance = v4f_splat(p->tolerance);
+	const bool bitwise = !(p->tolerance > 0.0f);
+	struct palette_range *r = NULL;
+
+	if (p->invalid) {
+		memcpy(p->current, next, p->count * sizeof(mat4));
+		p->invalid = false;
+
+		p->range_count = p->count > 0;
+		p->ranges[0] = (struct palette_range) { 0, p->count };
+		p->changed = p->count;
+		p->dirty = p->count;
+
+		return p->dirty;
+	}
+
+	p->range_count = 0;
+	p->changed = 0;
+	p->dirty = 0;
+
+	for (size_t i = 0; i < p->count; i++) {
+		if (bitwise ? !differs_bitwise(&p->current[i], &next[i])
+		            : !differs_approx(&p->current[i], &next[i], tolerance))
+			continue;
+
+		p->current[i] = next[i];
+		p->changed++;
+
+		/* i - end is the number of unchanged matrices in between */
+		if (r != NULL && i - (r->first + r->count) <= p->gap) {
+			r->count = i + 1 - r->first;
+		} else {
+			r = &p->ranges[p->range_count++];
+			*r = (struct palette_range) { i, 1 };
+		}
+	}
+
+	for (size_t i = 0; i < p->range_count; i++)
+		p->dirty += p->ranges[i].count;
+
+	return p->dirty;
+}
+
+void
+palette_invalidate(struct palette *p) {
+	p->invalid = true;
+}
+
+size_t
+palette_copy_dirty(const struct palette *p, mat4 *dst) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < p->range_count; i++) {
+		const struct palette_range r = p->ranges[i];
+
+		memcpy(dst + r.first, p->current + r.first, r.count * sizeof(mat4));
+	}
+
+	return p->dirty * sizeof(mat4);
+}
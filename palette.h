@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Tracking which matrices of a palette changed since the last frame, so that
+ * only those need copying to the GPU.
+ *
+ * The palette keeps a copy of what was last uploaded. Each frame the new
+ * matrices are compared against it, four lanes at a time, and the indices
+ * that differ are gathered into ranges. Ranges separated by no more than gap
+ * unchanged matrices are merged, since one longer copy is usually cheaper
+ * than two calls.
+ *
+ *     palette_update(&p, bones);
+ *     for (size_t i = 0; i < p.range_count; i++)
+ *         upload(p.ranges[i].first, p.ranges[i].count, p.current + p.ranges[i].first);
+ *
+ * or palette_copy_dirty(&p, mapped) to copy them into a mapped buffer.
+ *
+ * With a tolerance of 0 the comparison is bitwise, otherwise a matrix has
+ * changed when any element moved by more than tolerance since its last
+ * upload. Small drifts therefore accumulate until they are worth sending.
+ */
+
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct palette_range {
+	size_t first;
+	size_t count;
+};
+
+struct palette {
+	mat4 *current;          /* as last uploaded */
+	size_t count;
+	float tolerance;
+	size_t gap;
+	bool invalid;           /* the next update marks everything dirty */
+
+	/* the changes found by the last update, in increasing order */
+	struct palette_range *ranges;
+	size_t range_count;
+	size_t changed;         /* matrices that differed */
+	size_t dirty;           /* matrices in the ranges, counting merged gaps */
+};
+
+/* For count matrices, all dirty on the first update: 0 on success, -1 if there isn't enough memory */
+int palette_init(struct palette *p, size_t count, float tolerance, size_t gap);
+void palette_destroy(struct palette *p);
+
+/* Compare next against the current matrices and take it: the number of dirty matrices */
+size_t palette_update(struct palette *p, const mat4 *next);
+
+/* Mark everything dirty on the next update, as after losing the GPU's copy */
+void palette_invalidate(struct palette *p);
+
+/* Copy the dirty ranges into dst, which holds count matrices: the number of bytes copied */
+size_t palette_copy_dirty(const struct palette *p, mat4 *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "profile.h"
+
+#ifdef MATRIX_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Every counter this thread has touched, most recent first */
+static _Thread_local struct profile_counter *counters;
+
+uint64_t
+profile_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+void
+profile_register(struct profile_counter *counter) {
+	counter->registered = true;
+	counter->next = counters;
+	counters = counter;
+}
+
+static int
+by_cycles(const void *a, const void *b) {
+	const struct profile_entry *x = a;
+	const struct profile_entry *y = b;
+
+	return (x->cycles < y->cycles) - (x->cycles > y->cycles);
+}
+
+size_t
+profile_snapshot(struct profile_entry *entries, size_t max) {
+	size_t n = 0;
+
+	for (const struct profile_counter *c = counters; c != NULL; c = c->next)
+		n++;
+
+	/* a count is all that's wanted, or there is nothing to copy */
+	if (n == 0 || max == 0)
+		return n;
+
+	/* sort all of them, so that the most expensive are the ones kept */
+	struct profile_entry *all = malloc(n * sizeof(*all));
+	if (all == NULL)
+		return 0;
+
+	size_t i = 0;
+	for (const struct profile_counter *c = counters; c != NULL; c = c->next)
+		all[i++] = (struct profile_entry) { c->name, c->calls, c->cycles };
+
+	qsort(all, n, sizeof(*all), by_cycles);
+
+	for (i = 0; i < n && i < max; i++)
+		entries[i] = all[i];
+
+	free(all);
+
+	return n;
+}
+
+void
+profile_reset(void) {
+	for (struct profile_counter *c = counters; c != NULL; c = c->next) {
+		c->calls = 0;
+		c->cycles = 0;
+	}
+}
+
+#else
+
+size_t
+profile_snapshot(struct profile_entry *entries, size_t max) {
+	(void) entries;
+	(void) max;
+
+	return 0;
+}
+
+void
+profile_reset(void) {
+}
+
+#endif
+
+void
+profile_report(FILE *out) {
+	const size_t n = profile_snapshot(NULL, 0);
+	struct profile_entry *entries = NULL;
+
+	/* with no counters there is just the header to print */
+	if (n > 0) {
+		entries = malloc(n * sizeof(*entries));
+		if (entries == NULL)
+			return;
+
+		profile_snapshot(entries, n);
+	}
+
+	uint64_t total = 0;
+	for (size_t i = 0; i < n; i++)
+		total += entries[i].cycles;
+
+	fprintf(out, "%-24s %12s %14s %10s %6s\n", "function", "calls", "cycles", "per call", "%");
+
+	for (size_t i = 0; i < n; i++) {
+		const struct profile_entry *e = &entries[i];
+
+		if (e->calls == 0)
+			continue;
+
+		fprintf(out, "%-24s %12llu %14llu %10.1f %6.2f\n",
+			e->name,
+			(unsigned long long) e->calls,
+			(unsigned long long) e->cycles,
+			(double) e->cycles / (double) e->calls,
+			total > 0 ? 100.0 * (double) e->cycles / (double) total : 0.0);
+	}
+
+	free(entries);
+}
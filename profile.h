@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Call and cycle counters for the library's functions.
+ *
+ * When the library is built with MATRIX_PROFILE defined, every public
+ * function and batch kernel counts how many times it was called and how
+ * many cycles were spent inside it. Without MATRIX_PROFILE the counting
+ * compiles away entirely, and the functions below report nothing.
+ *
+ * Cycles come from the time-stamp counter on x86 and from a nanosecond
+ * clock elsewhere, so they are only comparable with each other. The time
+ * of a function includes the functions it calls, and calls the library
+ * makes to itself are counted as well.
+ *
+ * The counters are thread-local: a snapshot, reset or report only sees the
+ * calls made on the calling thread.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct profile_entry {
+	const char *name;
+	uint64_t calls;
+	uint64_t cycles;
+};
+
+/*
+ * Copy up to max counters into entries, most expensive first. Returns the
+ * number of counters there are, which may be more than max.
+ */
+size_t profile_snapshot(struct profile_entry *entries, size_t max);
+
+/* Zero every counter */
+void profile_reset(void);
+
+/* Print a table of the counters, most expensive first */
+void profile_report(FILE *out);
+
+/*
+ * Instrumentation, for use inside the library
+ *
+ * PROFILE_FUNCTION() goes at the top of a function body. The counter is
+ * stopped by a cleanup attribute when the function returns, so the body
+ * doesn't have to change.
+ */
+
+#ifdef MATRIX_PROFILE
+
+struct profile_counter {
+	const char *name;
+	uint64_t calls;
+	uint64_t cycles;
+	bool registered;
+	struct profile_counter *next;
+};
+
+struct profile_scope {
+	struct profile_counter *counter;
+	uint64_t start;
+};
+
+uint64_t profile_clock(void);
+void profile_register(struct profile_counter *);
+
+static inline struct profile_scope
+profile_begin(struct profile_counter *counter) {
+	if (!counter->registered)
+		profile_register(counter);
+
+	return (struct profile_scope) { counter, profile_clock() };
+}
+
+static inline void
+profile_end(struct profile_scope *scope) {
+	scope->counter->cycles += profile_clock() - scope->start;
+	scope->counter->calls++;
+}
+
+#define PROFILE_FUNCTION()                                                            \
+	static _Thread_local struct profile_counter profile_counter_ = { .name = __func__ }; \
+	struct profile_scope profile_scope_ __attribute__((cleanup(profile_end))) =      \
+		profile_begin(&profile_counter_)
+
+#else
+
+#define PROFILE_FUNCTION() do { } while (0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
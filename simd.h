@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Lane-wise helpers for the vector extension types.
+ *
+ * This is private to the library: it is included by the .c files, never by
+ * matrix.h. GCC and clang let us use the ordinary arithmetic operators on
+ * v4f_t and v2f_t, but there is no operator for a per-lane select, so the
+ * comparison masks (all ones or all zeroes per lane) are used to blend.
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "matrix.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+/* For bit twiddling, where shifts into the sign bit must be well defined */
+typedef unsigned int v4u_t __attribute__((vector_size (sizeof(unsigned int) * 4)));
+
+/* mask ? a : b, per lane */
+static inline v4f_t
+v4f_select(v4i_t mask, v4f_t a, v4f_t b) {
+	return (v4f_t) ((mask & (v4i_t) a) | (~mask & (v4i_t) b));
+}
+
+static inline v2f_t
+v2f_select(v2i_t mask, v2f_t a, v2f_t b) {
+	return (v2f_t) ((mask & (v2i_t) a) | (~mask & (v2i_t) b));
+}
+
+static inline v4f_t
+v4f_min(v4f_t a, v4f_t b) {
+	return v4f_select(a < b, a, b);
+}
+
+static inline v2f_t
+v2f_min(v2f_t a, v2f_t b) {
+	return v2f_select(a < b, a, b);
+}
+
+static inline v4f_t
+v4f_max(v4f_t a, v4f_t b) {
+	return v4f_select(a > b, a, b);
+}
+
+static inline v2f_t
+v2f_max(v2f_t a, v2f_t b) {
+	return v2f_select(a > b, a, b);
+}
+
+/* Clear the sign bit */
+static inline v4f_t
+v4f_abs(v4f_t a) {
+	return (v4f_t) ((v4i_t) a & 0x7fffffff);
+}
+
+static inline v2f_t
+v2f_abs(v2f_t a) {
+	return (v2f_t) ((v2i_t) a & 0x7fffffff);
+}
+
+static inline v4f_t
+v4f_splat(float x) {
+	return (v4f_t) { x, x, x, x };
+}
+
+/* The first three lanes, with the fourth zero as a vec3's padding must be */
+static inline v4f_t
+v4f_zero_w(v4f_t a) {
+	return __builtin_shufflevector(a, (v4f_t) { 0.0f }, 0, 1, 2, 4);
+}
+
+static inline v4f_t
+v4f_sqrt(v4f_t a) {
+#if defined(__SSE__)
+	return (v4f_t) _mm_sqrt_ps((__m128) a);
+#else
+	return (v4f_t) {
+		__builtin_sqrtf(a[0]), __builtin_sqrtf(a[1]),
+		__builtin_sqrtf(a[2]), __builtin_sqrtf(a[3]),
+	};
+#endif
+}
+
+/* For floats that are only 4 byte aligned, e.g. in a file format's arrays */
+static inline v4f_t
+v4f_load(const float *p) {
+	v4f_t a;
+	__builtin_memcpy(&a, p, sizeof(a));
+	return a;
+}
+
+static inline void
+v4f_store(float *p, v4f_t a) {
+	__builtin_memcpy(p, &a, sizeof(a));
+}
+
+/*
+ * Transpose four rows into four columns in registers, as _MM_TRANSPOSE4_PS
+ * does: interleave pairs of rows, then take the low and high halves.
+ */
+static inline void
+v4f_transpose(v4f_t *r0, v4f_t *r1, v4f_t *r2, v4f_t *r3) {
+	const v4f_t t0 = __builtin_shufflevector(*r0, *r1, 0, 4, 1, 5);
+	const v4f_t t1 = __builtin_shufflevector(*r2, *r3, 0, 4, 1, 5);
+	const v4f_t t2 = __builtin_shufflevector(*r0, *r1, 2, 6, 3, 7);
+	const v4f_t t3 = __builtin_shufflevector(*r2, *r3, 2, 6, 3, 7);
+
+	*r0 = __builtin_shufflevector(t0, t1, 0, 1, 4, 5);
+	*r1 = __builtin_shufflevector(t0, t1, 2, 3, 6, 7);
+	*r2 = __builtin_shufflevector(t2, t3, 0, 1, 4, 5);
+	*r3 = __builtin_shufflevector(t2, t3, 2, 3, 6, 7);
+}
+
+/*
+ * The array kernels work on blocks of four items, one per lane; the last
+ * block holds what is left.
+ */
+#define BLOCK_COUNT(I, N) ((N) - (I) < 4 ? (N) - (I) : 4)
+
+/*
+ * Lane k of out[j] is element j of the kth of count vectors, 1 to 4, each
+ * stride bytes after the last. A short block fills the rest with pad.
+ *
+ * A switch rather than a loop, so the four stay in registers.
+ */
+static inline void
+v4f_gather(v4f_t out[4], const v4f_t *v, size_t stride, size_t count, v4f_t pad) {
+	v4f_t v0 = pad, v1 = pad, v2 = pad, v3 = pad;
+	const char *p = (const char *) v;
+
+	switch (count) {
+	case 4: v3 = *(const v4f_t *) (p + 3 * stride); /* fall through */
+	case 3: v2 = *(const v4f_t *) (p + 2 * stride); /* fall through */
+	case 2: v1 = *(const v4f_t *) (p + stride);     /* fall through */
+	default: v0 = *v;
+	}
+
+	v4f_transpose(&v0, &v1, &v2, &v3);
+
+	out[0] = v0;
+	out[1] = v1;
+	out[2] = v2;
+	out[3] = v3;
+}
+
+/* And back: element j of the kth vector is lane k of in[j] */
+static inline void
+v4f_scatter(v4f_t *v, size_t stride, const v4f_t in[4], size_t count) {
+	v4f_t v0 = in[0], v1 = in[1], v2 = in[2], v3 = in[3];
+	char *p = (char *) v;
+
+	v4f_transpose(&v0, &v1, &v2, &v3);
+
+	switch (count) {
+	case 4: *(v4f_t *) (p + 3 * stride) = v3; /* fall through */
+	case 3: *(v4f_t *) (p + 2 * stride) = v2; /* fall through */
+	case 2: *(v4f_t *) (p + stride) = v1;     /* fall through */
+	default: *v = v0;
+	}
+}
+
+/*
+ * Sine and cosine of each lane, see sincosv4() in matrix.h for the accuracy.
+ *
+ * This follows Cephes' sinf and cosf, with the branches on the octant turned
+ * into selects so that all four lanes go through the same instructions.
+ */
+static inline void
+v4f_sincos(v4f_t x, v4f_t *s, v4f_t *c) {
+	/* pi/4 split into three parts, each exactly representable */
+	const float dp1 = 0.78515625f;
+	const float dp2 = 2.4187564849853515625e-4f;
+	const float dp3 = 3.77489497744594108e-8f;
+	const float four_over_pi = 1.27323954473516f;
+
+	const v4u_t sin_sign = (v4u_t) x & (v4u_t) v4f_splat(-0.0f);
+
+	/*
+	 * The octant must fit in an int to be converted, so lanes past 2^30,
+	 * and Inf and NaN, which the comparison is also false for, are reduced
+	 * as 0 and come out NaN: all ones is a NaN.
+	 */
+	const v4i_t in_range = v4f_abs(x) <= 0x1p30f;
+	v4f_t a = (v4f_t) ((v4i_t) v4f_abs(x) & in_range);
+
+	/* which octant, rounded up to an even one */
+	v4i_t j = __builtin_convertvector(a * four_over_pi, v4i_t);
+	j = (j + 1) & ~1;
+
+	const v4f_t y = __builtin_convertvector(j, v4f_t);
+	a = ((a - y * dp1) - y * dp2) - y * dp3;
+
+	const v4f_t z = a * a;
+
+	const v4f_t sin_poly = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * a + a;
+	const v4f_t cos_poly = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z
+		- 0.5f * z + 1.0f;
+
+	/* octants 2, 3, 6 and 7 swap the polynomials */
+	const v4i_t swap = (j & 2) != 0;
+
+	/* and octants 4 to 7 (shifted by two for cosine) flip the sign */
+	const v4u_t sin_flip = (v4u_t) (j & 4) << 29;
+	const v4u_t cos_flip = (v4u_t) (~(j - 2) & 4) << 29;
+
+	const v4u_t out_of_range = (v4u_t) ~in_range;
+
+	*s = (v4f_t) (((v4u_t) v4f_select(swap, cos_poly, sin_poly) ^ sin_sign ^ sin_flip) | out_of_range);
+	*c = (v4f_t) (((v4u_t) v4f_select(swap, sin_poly, cos_poly) ^ cos_flip) | out_of_range);
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "snapshot.h"
+
+/* Set in spare when it holds a frame the reader hasn't seen */
+#define FRESH 4u
+#define INDEX 3u
+
+int
+snapshot_init(struct snapshot *s, size_t size, size_t count) {
+	*s = (struct snapshot) { 0 };
+
+	if (size > 0 && count > SIZE_MAX / size)
+		return -1;
+
+	s->size = size * count;
+
+	for (int i = 0; i < 3; i++) {
+		s->buffers[i] = alloc_aligned(s->size);
+
+		if (s->buffers[i] == NULL) {
+			snapshot_destroy(s);
+			return -1;
+		}
+
+		memset(s->buffers[i], 0, s->size);
+	}
+
+	s->write = 0;
+	atomic_init(&s->spare, 1);
+	s->read = 2;
+
+	return 0;
+}
+
+void
+snapshot_destroy(struct snapshot *s) {
+	for (int i = 0; i < 3; i++)
+		alloc_free(s->buffers[i]);
+
+	*s = (struct snapshot) { 0 };
+}
+
+void *
+snapshot_write_buffer(struct snapshot *s) {
+	return s->buffers[s->write];
+}
+
+uint64_t
+snapshot_publish(struct snapshot *s) {
+	const uint64_t frame = ++s->published;
+
+	s->frames[s->write] = frame;
+
+	/* release our writes to the buffer, acquire the reader's old one */
+	const unsigned old = atomic_exchange_explicit(&s->spare, s->write | FRESH, memory_order_acq_rel);
+
+	s->write = old & INDEX;
+
+	return frame;
+}
+
+const void *
+snapshot_acquire(struct snapshot *s) {
+	/* a plain load first, so an idle writer costs no exchanges */
+	if (atomic_load_explicit(&s->spare, memory_order_relaxed) & FRESH) {
+		const unsigned old = atomic_exchange_explicit(&s->spare, s->read, memory_order_acq_rel);
+
+		s->read = old & INDEX;
+	}
+
+	return s->buffers[s->read];
+}
+
+uint64_t
+snapshot_frame(const struct snapshot *s) {
+	return s->frames[s->read];
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Triple-buffered snapshots of an array, from one writer thread to one
+ * reader thread, without locks.
+ *
+ * There are three copies of the array. The writer fills its own copy and
+ * publishes it, swapping it with the spare one. The reader swaps its own copy
+ * for the spare one when something newer has been published. Each side only
+ * ever touches the copy it holds, so the reader always sees a whole frame,
+ * and neither side waits for the other: the swaps are one atomic exchange.
+ *
+ *     writer:                              reader:
+ *
+ *     mat4 *m = snapshot_write_buffer(&s);     const mat4 *m = snapshot_acquire(&s);
+ *     ...all of m[0] to m[n - 1]...            ...m[0] to m[n - 1]...
+ *     snapshot_publish(&s);
+ *
+ * The reader may skip frames when the writer is faster, and sees the same
+ * frame again when it is slower. After publishing, the writer's buffer is
+ * whichever frame the reader last gave up, so the writer must write all of
+ * it each frame, or copy the last frame in first.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdalign.h>
+#include <stdint.h>
+
+#include "alloc.h"
+
+/* C++ sees the atomic member as a std::atomic, which is laid out as _Atomic is */
+#ifdef __cplusplus
+#include <atomic>
+using std::atomic_uint;
+#else
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Aligned to a cache line, so one from the heap must come from alloc_aligned() */
+struct snapshot {
+	unsigned char *buffers[3];
+	uint64_t frames[3];     /* the frame number in each buffer */
+	size_t size;            /* bytes in each buffer */
+
+	/* the spare buffer's index, and whether it is newer than the reader's */
+	alignas(ALLOC_ALIGNMENT) atomic_uint spare;
+
+	/* the writer's side */
+	alignas(ALLOC_ALIGNMENT) unsigned write;
+	uint64_t published;
+
+	/* the reader's side */
+	alignas(ALLOC_ALIGNMENT) unsigned read;
+};
+
+/* Three arrays of count elements of size bytes, zeroed: 0 on success, -1 if there isn't enough memory */
+int snapshot_init(struct snapshot *s, size_t size, size_t count);
+void snapshot_destroy(struct snapshot *s);
+
+/* The writer's array */
+void *snapshot_write_buffer(struct snapshot *s);
+
+/* Hand the writer's array to the reader, returning its frame number, from 1 */
+uint64_t snapshot_publish(struct snapshot *s);
+
+/* The newest array published, which stays valid until the next call */
+const void *snapshot_acquire(struct snapshot *s);
+
+/* The frame number of the reader's array, 0 before anything is published */
+uint64_t snapshot_frame(const struct snapshot *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
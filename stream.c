@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "stream.h"
+
+#define BUFFERS 2
+
+/* The most threads a chunk's transform is split across */
+#define TRANSFORMERS 4
+
+struct buffer {
+	float *raw;             /* the records as they are in the files */
+	vec4 *work;             /* and as vectors, for the kernel */
+
+	size_t count;           /* records in it, 0 at the end of the input */
+	bool full;
+};
+
+struct pipeline {
+	FILE *out;
+	mat4 m;
+	enum stream_record record;
+
+	struct buffer buffers[BUFFERS];
+
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+
+	/* set by the worker, so the reader stops early */
+	int error;
+
+	/*
+	 * The worker hands each chunk to the helpers by setting current and
+	 * bumping generation, transforms the first slice itself, then waits for
+	 * pending to drop to 0 before writing it. A NULL current stops them.
+	 */
+	size_t transformers;
+	struct buffer *current;
+	unsigned generation;
+	size_t pending;
+
+	pthread_cond_t sliced;
+};
+
+struct helper {
+	struct pipeline *p;
+	size_t slice;
+};
+
+static void
+unpack(vec4 *dst, const float *src, size_t count, enum stream_record record) {
+	if (record == STREAM_VEC3) {
+		for (size_t i = 0; i < count; i++)
+			dst[i] = (vec4) {{ src[3 * i], src[3 * i + 1], src[3 * i + 2], 1.0f }};
+	} else {
+		for (size_t i = 0; i < count; i++)
+			dst[i] = (vec4) {{ src[4 * i], src[4 * i + 1], src[4 * i + 2], src[4 * i + 3] }};
+	}
+}
+
+static void
+pack(float *dst, const vec4 *src, size_t count, enum stream_record record) {
+	const size_t stride = record;
+
+	for (size_t i = 0; i < count; i++)
+		for (size_t k = 0; k < stride; k++)
+			dst[stride * i + k] = src[i]._v[k];
+}
+
+/* Transform the slice'th of transformers parts of the buffer */
+static void
+transform(struct pipeline *p, struct buffer *b, size_t slice) {
+	const size_t begin = b->count * slice / p->transformers;
+	const size_t end = b->count * (slice + 1) / p->transformers;
+	const size_t stride = p->record;
+
+	unpack(b->work + begin, b->raw + stride * begin, end - begin, p->record);
+	multm4v4_array(b->work + begin, p->m, b->work + begin, end - begin);
+	pack(b->raw + stride * begin, b->work + begin, end - begin, p->record);
+}
+
+static void *
+helper(void *arg) {
+	const struct helper *h = arg;
+	struct pipeline *p = h->p;
+	unsigned seen = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&p->lock);
+		while (p->generation == seen)
+			pthread_cond_wait(&p->sliced, &p->lock);
+		seen = p->generation;
+		struct buffer *b = p->current;
+		pthread_mutex_unlock(&p->lock);
+
+		if (b == NULL)
+			return NULL;
+
+		transform(p, b, h->slice);
+
+		pthread_mutex_lock(&p->lock);
+		if (--p->pending == 0)
+			pthread_cond_broadcast(&p->sliced);
+		pthread_mutex_unlock(&p->lock);
+	}
+}
+
+/* Wake the helpers on b, or stop them if it's NULL */
+static void
+hand_out(struct pipeline *p, struct buffer *b) {
+	pthread_mutex_lock(&p->lock);
+	p->current = b;
+	p->pending = p->transformers - 1;
+	p->generation++;
+	pthread_cond_broadcast(&p->sliced);
+	pthread_mutex_unlock(&p->lock);
+}
+
+static void *
+worker(void *arg) {
+	struct pipeline *p = arg;
+	const size_t record_size = sizeof(float) * p->record;
+
+	for (size_t i = 0; ; i = (i + 1) % BUFFERS) {
+		struct buffer *b = &p->buffers[i];
+
+		pthread_mutex_lock(&p->lock);
+		while (!b->full)
+			pthread_cond_wait(&p->changed, &p->lock);
+		pthread_mutex_unlock(&p->lock);
+
+		if (b->count == 0) {
+			hand_out(p, NULL);
+			return NULL;
+		}
+
+		hand_out(p, b);
+		transform(p, b, 0);
+
+		pthread_mutex_lock(&p->lock);
+		while (p->pending != 0)
+			pthread_cond_wait(&p->sliced, &p->lock);
+		pthread_mutex_unlock(&p->lock);
+
+		const bool written = fwrite(b->raw, record_size, b->count, p->out) == b->count;
+		const int saved = errno;
+
+		pthread_mutex_lock(&p->lock);
+		if (!written && p->error == 0)
+			p->error = saved != 0 ? saved : EIO;
+		b->full = false;
+		pthread_cond_broadcast(&p->changed);
+		pthread_mutex_unlock(&p->lock);
+	}
+}
+
+static double
+now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+int
+stream_transform(FILE *in, FILE *out, mat4 m, enum stream_record record, size_t chunk, struct stream_stats *stats) {
+	if (record != STREAM_VEC3 && record != STREAM_VEC4) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (chunk == 0)
+		chunk = STREAM_CHUNK_RECORDS;
+
+	const size_t record_size = sizeof(float) * record;
+
+	if (chunk > SIZE_MAX / sizeof(vec4)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* one per CPU, though the reader and the write take some of them */
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	struct pipeline p = {
+		.out = out,
+		.m = m,
+		.record = record,
+		.transformers = cpus < 1 ? 1 : cpus > TRANSFORMERS ? TRANSFORMERS : (size_t) cpus,
+	};
+
+	int error = 0;
+
+	for (int i = 0; i < BUFFERS; i++) {
+		p.buffers[i].raw = malloc(chunk * record_size);
+		p.buffers[i].work = alloc_array(vec4, chunk);
+
+		if (p.buffers[i].raw == NULL || p.buffers[i].work == NULL)
+			error = ENOMEM;
+	}
+
+	/* threads[0] is the worker, the rest are helpers */
+	pthread_t threads[TRANSFORMERS];
+	struct helper helpers[TRANSFORMERS];
+	size_t started = 0;
+
+	pthread_mutex_init(&p.lock, NULL);
+	pthread_cond_init(&p.changed, NULL);
+	pthread_cond_init(&p.sliced, NULL);
+
+	for (size_t i = 1; error == 0 && i < p.transformers; i++) {
+		helpers[i] = (struct helper) { &p, i };
+		error = pthread_create(&threads[i], NULL, helper, &helpers[i]);
+		if (error == 0)
+			started = i;
+	}
+
+	if (error == 0)
+		error = pthread_create(&threads[0], NULL, worker, &p);
+
+	if (error != 0) {
+		if (started != 0)
+			hand_out(&p, NULL);
+		for (size_t i = 1; i <= started; i++)
+			pthread_join(threads[i], NULL);
+
+		pthread_cond_destroy(&p.sliced);
+		pthread_cond_destroy(&p.changed);
+		pthread_mutex_destroy(&p.lock);
+
+		for (int i = 0; i < BUFFERS; i++) {
+			free(p.buffers[i].raw);
+			alloc_free(p.buffers[i].work);
+		}
+
+		errno = error;
+		return -1;
+	}
+
+	const double start = now();
+	uint64_t records = 0;
+	bool done = false;
+
+	for (size_t i = 0; ; i = (i + 1) % BUFFERS) {
+		struct buffer *b = &p.buffers[i];
+
+		pthread_mutex_lock(&p.lock);
+		while (b->full)
+			pthread_cond_wait(&p.changed, &p.lock);
+		done |= p.error != 0;
+		pthread_mutex_unlock(&p.lock);
+
+		size_t count = 0;
+
+		if (!done) {
+			const size_t bytes = fread(b->raw, 1, chunk * record_size, in);
+
+			count = bytes / record_size;
+
+			if (bytes % record_size != 0)
+				error = EINVAL;
+			else if (bytes < chunk * record_size && ferror(in))
+				error = errno != 0 ? errno : EIO;
+
+			/* a short read is the end of the input, or an error */
+			done = bytes < chunk * record_size;
+		}
+
+		records += count;
+
+		/* an empty buffer tells the worker there is nothing more */
+		pthread_mutex_lock(&p.lock);
+		b->count = count;
+		b->full = true;
+		pthread_cond_broadcast(&p.changed);
+		pthread_mutex_unlock(&p.lock);
+
+		if (count == 0)
+			break;
+	}
+
+	for (size_t i = 0; i < p.transformers; i++)
+		pthread_join(threads[i], NULL);
+
+	if (fflush(out) != 0 && p.error == 0)
+		p.error = errno != 0 ? errno : EIO;
+
+	const double seconds = now() - start;
+
+	pthread_cond_destroy(&p.sliced);
+	pthread_cond_destroy(&p.changed);
+	pthread_mutex_destroy(&p.lock);
+
+	for (int i = 0; i < BUFFERS; i++) {
+		free(p.buffers[i].raw);
+		alloc_free(p.buffers[i].work);
+	}
+
+	if (stats != NULL) {
+		*stats = (struct stream_stats) {
+			.records = records,
+			.bytes = records * record_size,
+			.seconds = seconds,
+			.mb_per_second = seconds > 0.0 ? (double) (records * record_size) / seconds * 1e-6 : 0.0,
+		};
+	}
+
+	/* a write error is the more useful one to report */
+	if (p.error != 0)
+		error = p.error;
+
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+stream_transform_file(const char *in_path, const char *out_path, mat4 m, enum stream_record record, size_t chunk,
+		struct stream_stats *stats) {
+	FILE *in = fopen(in_path, "rb");
+	if (in == NULL)
+		return -1;
+
+	FILE *out = fopen(out_path, "wb");
+	if (out == NULL) {
+		const int saved = errno;
+		fclose(in);
+		errno = saved;
+		return -1;
+	}
+
+	int result = stream_transform(in, out, m, record, chunk, stats);
+	const int saved = errno;
+
+	fclose(in);
+	if (fclose(out) != 0 && result == 0)
+		return -1;
+
+	errno = saved;
+	return result;
+}
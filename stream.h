@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Transform a stream of vectors by a matrix, from one file to another.
+ *
+ * The records are read in chunks of a fixed number into one of two buffers.
+ * While the calling thread reads the next chunk into one buffer, the last
+ * chunk in the other is split across up to four threads, one per CPU, which
+ * transform their parts with multm4v4_array(), then one of them writes it
+ * out. So reading overlaps with the work, and the memory used is two chunks
+ * however big the files are.
+ *
+ * Records are packed native floats: (x, y, z) points for STREAM_VEC3, which
+ * are transformed with w = 1 and no perspective divide, or (x, y, z, w)
+ * vectors for STREAM_VEC4.
+ *
+ * The functions return 0 on success, or -1 with errno set on failure. EINVAL
+ * means the input ended part way through a record, though the whole records
+ * before it have still been written.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The number of floats in a record */
+enum stream_record {
+	STREAM_VEC3 = 3,
+	STREAM_VEC4 = 4,
+};
+
+/* Used when the chunk size is 0: 1 MiB of vec4 */
+#define STREAM_CHUNK_RECORDS 65536
+
+struct stream_stats {
+	uint64_t records;
+	uint64_t bytes;         /* read, and so also written */
+	double seconds;
+	double mb_per_second;   /* bytes read per second, in units of 10^6 */
+};
+
+/* stats may be NULL */
+int stream_transform(FILE *in, FILE *out, mat4 m, enum stream_record record, size_t chunk, struct stream_stats *stats);
+
+int stream_transform_file(const char *in_path, const char *out_path, mat4 m, enum stream_record record, size_t chunk,
+	struct stream_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
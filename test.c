@@ -15,10 +15,29 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "alloc.h"
+#include "anim.h"
+#include "depth.h"
+#include "jobs.h"
+#include "mapfile.h"
 #include "matrix.h"
+#include "mesh.h"
+#include "normal.h"
+#include "obb.h"
+#include "palette.h"
+#include "profile.h"
+#include "snapshot.h"
+#include "stream.h"
+#include "transforms.h"
+#include "trs.h"
 
 #define GENERIC_VEC_MAT(FN, A) _Generic((A) \
     , vec2: FN ## v2                    \
@@ -223,6 +242,73 @@ test_vector_constructors(void) {
 	}
 }
 
+void
+test_swizzle(void) {
+	const float a = 1.0f;
+	const float b = 2.0f;
+	const float c = 3.0f;
+	const float d = 4.0f;
+
+	const vec4 u = vec4(a, b, c, d);
+
+	{
+		vec4 v = swizzle(u, w, z, y, x);
+		assert(v.x == d && v.y == c && v.z == b && v.w == a);
+	}
+
+	{
+		vec4 v = swizzle(u, x, x, y, y);
+		assert(v.x == a && v.y == a && v.z == b && v.w == b);
+	}
+
+	{
+		vec3 v = swizzle(u, z, x, y);
+		assert(v.x == c && v.y == a && v.z == b);
+	}
+
+	{
+		vec2 v = swizzle(u, w, y);
+		assert(v.x == d && v.y == b);
+	}
+
+	// rgba names
+	{
+		vec3 v = swizzle(u, b, g, r);
+		assert(v.x == c && v.y == b && v.z == a);
+	}
+
+	// from smaller vectors
+	{
+		vec3 t = vec3(a, b, c);
+		vec4 v = swizzle(t, z, z, y, x);
+		assert(v.x == c && v.y == c && v.z == b && v.w == a);
+
+		vec2 s = vec2(a, b);
+		vec2 w = swizzle(s, y, x);
+		assert(w.x == b && w.y == a);
+	}
+
+	// named forms
+	{
+		assert(equals(xy(u), vec2(a, b)));
+		assert(equals(yz(u), vec2(b, c)));
+		assert(equals(zw(u), vec2(c, d)));
+		assert(equals(xyz(u), vec3(a, b, c)));
+		assert(equals(yzw(u), vec3(b, c, d)));
+		assert(equals(rgb(u), vec3(a, b, c)));
+	}
+
+	// a vec3 keeps its padding lane at zero, whatever it came from
+	{
+		assert(yzw(u)._v[3] == 0.0f);
+		assert(swizzle(u, w, w, w)._v[3] == 0.0f);
+		assert(swizzle(vec3(a, b, c), z, y, x)._v[3] == 0.0f);
+
+		const vec3 v = swizzle(vec2(a, b), y, x, y);
+		assert(v.x == b && v.y == a && v.z == b && v._v[3] == 0.0f);
+	}
+}
+
 
 /*
  * Tests
@@ -441,6 +527,53 @@ test_matrix_constructors(void) {
 	}
 }
 
+void
+test_row_major(void) {
+	mat4 m[3];
+	for (int i = 0; i < 3; i++)
+		for (int c = 0; c < 4; c++)
+			m[i].cols[c] = vec4(16.0f * i + c, 16.0f * i + c + 4, 16.0f * i + c + 8, 16.0f * i + c + 12);
+
+	mat4 t[3];
+	transposem4_array(t, m, 3);
+	for (int i = 0; i < 3; i++)
+		assert(equals(t[i], transpose(m[i])));
+
+	assert(equals(transpose(m[1]).cols[2], vec4(24.0f, 25.0f, 26.0f, 27.0f)));
+
+	// one float further in, so the rows are not 16 byte aligned
+	float buffer[1 + 48];
+	float *rows = buffer + 1;
+
+	to_row_majorm4_array(rows, m, 3);
+	for (int i = 0; i < 48; i++)
+		assert(rows[i] == (float) i);
+
+	mat4 back[3];
+	from_row_majorm4_array(back, rows, 3);
+	for (int i = 0; i < 3; i++)
+		assert(equals(back[i], m[i]));
+
+	// the affine form keeps the top three rows
+	const mat4 affine = mat4(
+		1.0f, 2.0f, 3.0f, 0.0f,
+		4.0f, 5.0f, 6.0f, 0.0f,
+		7.0f, 8.0f, 9.0f, 0.0f,
+		10.0f, 11.0f, 12.0f, 1.0f
+	);
+	const float expected[12] = {
+		1.0f, 4.0f, 7.0f, 10.0f,
+		2.0f, 5.0f, 8.0f, 11.0f,
+		3.0f, 6.0f, 9.0f, 12.0f,
+	};
+
+	to_row_major_affinem4_array(rows, &affine, 1);
+	assert(memcmp(rows, expected, sizeof(expected)) == 0);
+
+	from_row_major_affinem4_array(back, rows, 1);
+	assert(equals(back[0], affine));
+}
+
 void
 test_matrix_mult(void) {
 	const float _a = 2.0f;
@@ -572,6 +705,285 @@ test_matrix_mult(void) {
 	}
 }
 
+void
+test_matrix_vector_mult(void) {
+	{
+		const mat2 m = mat2(
+			2.0f, 3.0f,
+			5.0f, 7.0f
+		);
+		const vec2 v = vec2(11.0f, 13.0f);
+
+		assert(equals(mult(m, v), vec2(2.0f * 11.0f + 5.0f * 13.0f, 3.0f * 11.0f + 7.0f * 13.0f)));
+		assert(equals(mult(v, m), vec2(2.0f * 11.0f + 3.0f * 13.0f, 5.0f * 11.0f + 7.0f * 13.0f)));
+	}
+
+	{
+		const mat3 m = mat3(
+			2.0f, 3.0f, 5.0f,
+			7.0f, 11.0f, 13.0f,
+			17.0f, 19.0f, 23.0f
+		);
+		const vec3 v = vec3(29.0f, 31.0f, 37.0f);
+		const mat3 mt = transpose(m);
+
+		// the same as a matrix with v as a column, padding lane and all
+		assert(equals(mult(m, v), mult(m, mat3(v, vec3(0.0f), vec3(0.0f))).cols[0]));
+		assert(equals(mult(m, v), vec3(dot(mt.cols[0], v), dot(mt.cols[1], v), dot(mt.cols[2], v))));
+		assert(equals(mult(v, m), vec3(dot(v, m.cols[0]), dot(v, m.cols[1]), dot(v, m.cols[2]))));
+		assert(mult(v, m)._v[3] == 0.0f);
+	}
+
+	{
+		const mat4 m = mat4(
+			2.0f, 3.0f, 5.0f, 7.0f,
+			11.0f, 13.0f, 17.0f, 19.0f,
+			23.0f, 29.0f, 31.0f, 37.0f,
+			41.0f, 43.0f, 47.0f, 53.0f
+		);
+		const vec4 v = vec4(59.0f, 61.0f, 67.0f, 71.0f);
+		const mat4 mt = transpose(m);
+
+		assert(equals(mult(m, v), vec4(dot(mt.cols[0], v), dot(mt.cols[1], v), dot(mt.cols[2], v), dot(mt.cols[3], v))));
+		assert(equals(mult(v, m), vec4(dot(v, m.cols[0]), dot(v, m.cols[1]), dot(v, m.cols[2]), dot(v, m.cols[3]))));
+		assert(equals(mult(v, m), mult(mt, v)));
+
+		// a translation moves points but not directions
+		const mat4 t = mat4(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			1.0f, 2.0f, 3.0f, 1.0f
+		);
+		assert(equals(mult(t, vec4(1.0f, 1.0f, 1.0f, 1.0f)), vec4(2.0f, 3.0f, 4.0f, 1.0f)));
+		assert(equals(mult(t, vec4(1.0f, 1.0f, 1.0f, 0.0f)), vec4(1.0f, 1.0f, 1.0f, 0.0f)));
+	}
+}
+
+void
+test_solve(void) {
+	// a permutation: a zero pivot without pivoting
+	const mat2 swap = mat2(
+		0.0f, 1.0f,
+		1.0f, 0.0f
+	);
+	const mat2 a2[3] = { mat2(2.0f), swap, mat2(1.0f, 2.0f, 2.0f, 4.0f) };
+	const vec2 b2[3] = { vec2(2.0f, 4.0f), vec2(3.0f, 5.0f), vec2(1.0f, 1.0f) };
+	vec2 x2[3];
+	bool singular[5];
+
+	size_t failed = solvem2_array(x2, a2, b2, 3, false, singular);
+	assert(failed == 2);
+	assert(!singular[0] && singular[1] && singular[2]);
+	assert(equals(x2[0], vec2(1.0f, 2.0f)) && equals(x2[1], vec2(0.0f)) && equals(x2[2], vec2(0.0f)));
+
+	failed = solvem2_array(x2, a2, b2, 3, true, singular);
+	assert(failed == 1);
+	assert(!singular[0] && !singular[1] && singular[2]);
+	assert(equals(x2[1], vec2(5.0f, 3.0f)));
+
+	// mat3 with the largest entries off the diagonal
+	const mat3 a3 = mat3(
+		1.0f, 8.0f, 2.0f,
+		7.0f, 1.0f, 3.0f,
+		2.0f, 4.0f, 9.0f
+	);
+	const vec3 expected3 = vec3(1.0f, -2.0f, 3.0f);
+	const vec3 b3 = mult(a3, expected3);
+	vec3 x3;
+
+	failed = solvem3_array(&x3, &a3, &b3, 1, true, NULL);
+	assert(failed == 0);
+	assert(equals(mat4(mat3(x3, vec3(0.0f), vec3(0.0f))), mat4(mat3(expected3, vec3(0.0f), vec3(0.0f)))));
+	assert(x3._v[3] == 0.0f);
+
+	// five mat4 systems, so the second block has a padded tail
+	mat4 a4[5];
+	vec4 b4[5], x4[5];
+	const vec4 expected4 = vec4(1.0f, 2.0f, -3.0f, 0.5f);
+
+	for (int i = 0; i < 5; i++) {
+		a4[i] = mat4(
+			4.0f + i, 1.0f, 0.0f, 2.0f,
+			1.0f, 5.0f, 1.0f, 0.0f,
+			0.0f, 1.0f, 6.0f, 1.0f,
+			2.0f, 0.0f, 1.0f, 7.0f - i
+		);
+		b4[i] = mult(a4[i], expected4);
+	}
+
+	// the fourth is singular: its last column is a multiple of the first
+	a4[3].cols[3] = scale(a4[3].cols[0], 2.0f);
+	b4[3] = mult(a4[3], expected4);
+
+	for (int pivot = 0; pivot < 2; pivot++) {
+		failed = solvem4_array(x4, a4, b4, 5, pivot, singular);
+		assert(failed == 1);
+
+		for (int i = 0; i < 5; i++) {
+			assert(singular[i] == (i == 3));
+
+			if (i != 3) {
+				const vec4 d = sub(x4[i], expected4);
+				assert(dot(d, d) < 1e-10f);
+			}
+		}
+	}
+
+	failed = solvem4_array(x4, a4, b4, 0, true, NULL);
+	assert(failed == 0);
+}
+
+void
+test_eigen(void) {
+	// R * diag(values) * transpose(R), for a few rotations and values
+	const vec3 values[5] = {
+		vec3(3.0f, 2.0f, 1.0f),
+		vec3(-1.0f, 5.0f, 0.5f),
+		vec3(2.0f, 2.0f, -4.0f),        // repeated
+		vec3(1e-3f, 1e3f, 1.0f),
+		vec3(0.0f, 0.0f, 0.0f),
+	};
+	const vec3 sorted[5] = {
+		vec3(3.0f, 2.0f, 1.0f),
+		vec3(5.0f, 0.5f, -1.0f),
+		vec3(2.0f, 2.0f, -4.0f),
+		vec3(1e3f, 1.0f, 1e-3f),
+		vec3(0.0f, 0.0f, 0.0f),
+	};
+
+	vec3 angles[5];
+	mat3 r[5], m[5];
+
+	for (int i = 0; i < 5; i++)
+		angles[i] = vec3(0.3f + i, -0.7f * i, 1.1f);
+	eulerm3_array(r, angles, 5);
+
+	for (int i = 0; i < 5; i++) {
+		const mat3 d = mat3(
+			values[i].x, 0.0f, 0.0f,
+			0.0f, values[i].y, 0.0f,
+			0.0f, 0.0f, values[i].z
+		);
+		m[i] = mult(mult(r[i], d), transpose(r[i]));
+	}
+
+	// the lower triangle is never read
+	m[0].cols[0].y = 100.0f;
+	m[0].cols[1].z = -100.0f;
+	m[0].cols[0].z = 100.0f;
+
+	vec3 lambda[5];
+	mat3 v[5];
+	eigensymm3_array(lambda, v, m, 5);
+
+	for (int i = 0; i < 5; i++) {
+		// relative to the largest value
+		const float tolerance = 1e-5f * fmaxf(1.0f, fabsf(sorted[i].x) + fabsf(sorted[i].z));
+		const vec3 d = sub(lambda[i], sorted[i]);
+		assert(fabsf(d.x) < tolerance && fabsf(d.y) < tolerance && fabsf(d.z) < tolerance);
+
+		// orthonormal and right-handed
+		const mat3 vtv = mult(transpose(v[i]), v[i]);
+		for (int c = 0; c < 3; c++)
+			for (int k = 0; k < 3; k++)
+				assert(fabsf(vtv.cols[c]._v[k] - (c == k ? 1.0f : 0.0f)) < 1e-5f);
+		assert(fabsf(determinant(v[i]) - 1.0f) < 1e-5f);
+		assert(v[i].cols[0]._v[3] == 0.0f);
+	}
+
+	// m * v = lambda v, for all but the one with the lower triangle spoilt
+	for (int i = 1; i < 5; i++) {
+		for (int c = 0; c < 3; c++) {
+			const vec3 mv = mult(m[i], v[i].cols[c]);
+			const vec3 lv = scale(v[i].cols[c], lambda[i]._v[c]);
+			const vec3 d = sub(mv, lv);
+			assert(dot(d, d) < 1e-8f * fmaxf(1.0f, dot(lambda[i], lambda[i])));
+		}
+	}
+}
+
+/* The largest element of transpose(m) * m - I */
+static float
+orthonormal_error(mat3 m) {
+	const mat3 mtm = mult(transpose(m), m);
+	float e = 0.0f;
+
+	for (int c = 0; c < 3; c++)
+		for (int k = 0; k < 3; k++)
+			e = fmaxf(e, fabsf(mtm.cols[c]._v[k] - (c == k ? 1.0f : 0.0f)));
+
+	return e;
+}
+
+void
+test_orthonormalize(void) {
+	enum { COUNT = 7 };
+	vec3 angles[COUNT];
+	mat3 r[COUNT], drifted[COUNT], scaled[COUNT], out[COUNT];
+
+	for (int i = 0; i < COUNT; i++)
+		angles[i] = vec3(0.4f * i, 1.0f - 0.3f * i, 0.2f + i);
+	eulerm3_array(r, angles, COUNT);
+
+	// a little off in every element, and stretched along the axes
+	for (int i = 0; i < COUNT; i++) {
+		drifted[i] = r[i];
+		for (int c = 0; c < 3; c++)
+			for (int k = 0; k < 3; k++)
+				drifted[i].cols[c]._v[k] += 1e-3f * (float) (((i + 3 * c + k) % 5) - 2);
+
+		const mat3 s = mat3(
+			1.5f, 0.0f, 0.0f,
+			0.0f, 0.7f, 0.0f,
+			0.0f, 0.0f, 2.0f + i
+		);
+		scaled[i] = mult(r[i], s);
+	}
+
+	// Gram-Schmidt keeps the direction of the first column
+	orthonormalizem3_array(out, drifted, COUNT, ORTHONORMALIZE_GRAM_SCHMIDT);
+	for (int i = 0; i < COUNT; i++) {
+		assert(orthonormal_error(out[i]) < 1e-6f);
+		assert(fabsf(determinant(out[i]) - 1.0f) < 1e-6f);
+		assert(fabsf(dot(out[i].cols[0], normalize(drifted[i].cols[0])) - 1.0f) < 1e-6f);
+		assert(out[i].cols[2]._v[3] == 0.0f);
+	}
+
+	// a polar step squares the error
+	orthonormalizem3_array(out, drifted, COUNT, ORTHONORMALIZE_POLAR_STEP);
+	for (int i = 0; i < COUNT; i++) {
+		const float before = orthonormal_error(drifted[i]);
+		assert(orthonormal_error(out[i]) < fmaxf(4.0f * before * before, 1e-6f));
+	}
+
+	// the polar decomposition of r * s, for symmetric s, is r
+	orthonormalizem3_array(out, scaled, COUNT, ORTHONORMALIZE_POLAR);
+	for (int i = 0; i < COUNT; i++) {
+		assert(orthonormal_error(out[i]) < 1e-6f);
+		for (int c = 0; c < 3; c++)
+			for (int k = 0; k < 3; k++)
+				assert(fabsf(out[i].cols[c]._v[k] - r[i].cols[c]._v[k]) < 1e-6f);
+	}
+
+	// and in place, for mat4, keeping the translation and the last row
+	mat4 m[COUNT];
+	for (int i = 0; i < COUNT; i++) {
+		m[i] = mat4(drifted[i]);
+		m[i].cols[3] = vec4(1.0f + i, 2.0f, -3.0f, 1.0f);
+	}
+
+	orthonormalizem3_array(out, drifted, COUNT, ORTHONORMALIZE_POLAR);
+	orthonormalizem4_array(m, m, COUNT, ORTHONORMALIZE_POLAR);
+	for (int i = 0; i < COUNT; i++) {
+		for (int c = 0; c < 3; c++) {
+			assert(equals(vec3(m[i].cols[c]), out[i].cols[c]));
+			assert(m[i].cols[c].w == 0.0f);
+		}
+		assert(equals(m[i].cols[3], vec4(1.0f + i, 2.0f, -3.0f, 1.0f)));
+	}
+}
+
 void
 test_matrix_determinant(void) {
 	{
@@ -643,6 +1055,50 @@ test_matrix_inverse(void) {
 	}
 }
 
+void
+test_mat3x2(void) {
+	// a shear with determinant 1, so everything below is exact
+	const mat3x2 a = mat3x2(2.0f, 1.0f, 1.0f, 1.0f, 3.0f, -4.0f);
+	const mat3x2 b = mat3x2(vec2(0.0f, 1.0f), vec2(-1.0f, 0.0f), vec2(0.5f, 2.0f));
+	const mat3 a3 = mat3(a), b3 = mat3(b);
+
+	assert(equals(a3, mat3(2.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 3.0f, -4.0f, 1.0f)));
+	assert(equals(mat3(mat3x2(a3)), a3));
+	assert(equals(mat3(mat3x2(1.0f)), mat3(1.0f)));
+
+	// the same as the mat3 it stands for
+	assert(equals(mat3(mult(a, b)), mult(a3, b3)));
+	assert(equals(vec3(mult(a, vec2(5.0f, -6.0f)), 1.0f), mult(a3, vec3(5.0f, -6.0f, 1.0f))));
+	assert(determinant(a3) == determinant(a));
+
+	const mat3x2 inv = inverse(a);
+	assert(equals(mat3(mult(inv, a)), mat3(1.0f)));
+	assert(equals(mat3(mult(a, inv)), mat3(1.0f)));
+
+	// in the xy plane of a mat4
+	const vec4 p = mult(mat4(a), vec4(5.0f, -6.0f, 7.0f, 1.0f));
+	assert(equals(p, vec4(mult(a, vec2(5.0f, -6.0f)), 7.0f, 1.0f)));
+
+	// arrays, with an odd count for the points
+	enum { COUNT = 7 };
+	mat3x2 m[COUNT], ab[COUNT], invs[COUNT];
+	vec2 points[COUNT], out[COUNT];
+
+	for (int i = 0; i < COUNT; i++) {
+		m[i] = mat3x2(vec2(1.0f, (float) i), vec2(0.0f, 1.0f), vec2((float) i, -2.0f));
+		points[i] = vec2((float) i, 0.5f * (float) i);
+	}
+
+	multm3x2_array(ab, m, m, COUNT);
+	inversem3x2_array(invs, m, COUNT);
+	multm3x2v2_array(out, a, points, COUNT);
+	for (int i = 0; i < COUNT; i++) {
+		assert(equals(mat3(ab[i]), mult(mat3(m[i]), mat3(m[i]))));
+		assert(equals(mat3(mult(invs[i], m[i])), mat3(1.0f)));
+		assert(equals(out[i], mult(a, points[i])));
+	}
+}
+
 void
 test_normalize(void) {
 	const float a = 2.0f;
@@ -739,17 +1195,1521 @@ test_cross_product() {
 	assert(equals(cross(a, b), expected));
 }
 
+void
+test_common_functions(void) {
+	const vec4 a = vec4(1.0f, -2.0f, 3.0f, -4.0f);
+	const vec4 b = vec4(5.0f, 6.0f, -7.0f, 8.0f);
+
+	assert(equals(add(a, b), vec4(6.0f, 4.0f, -4.0f, 4.0f)));
+	assert(equals(sub(a, b), vec4(-4.0f, -8.0f, 10.0f, -12.0f)));
+	assert(equals(mul(a, b), vec4(5.0f, -12.0f, -21.0f, -32.0f)));
+	assert(equals(vdiv(b, a), vec4(5.0f, -3.0f, -7.0f / 3.0f, -2.0f)));
+	assert(equals(scale(a, 2.0f), vec4(2.0f, -4.0f, 6.0f, -8.0f)));
+	assert(equals(vfma(a, b, a), vec4(6.0f, -14.0f, -18.0f, -36.0f)));
+
+	assert(equals(min(a, b), vec4(1.0f, -2.0f, -7.0f, -4.0f)));
+	assert(equals(max(a, b), vec4(5.0f, 6.0f, 3.0f, 8.0f)));
+	assert(equals(vabs(a), vec4(1.0f, 2.0f, 3.0f, 4.0f)));
+	assert(equals(clamp(a, -1.0f, 2.0f), vec4(1.0f, -1.0f, 2.0f, -1.0f)));
+
+	// mix is exact at both ends
+	assert(equals(mix(a, b, 0.0f), a));
+	assert(equals(mix(a, b, 1.0f), b));
+	assert(equals(mix(a, b, 0.5f), vec4(3.0f, 2.0f, -2.0f, 2.0f)));
+
+	assert(equals(step(1.0f, a), vec4(1.0f, 0.0f, 1.0f, 0.0f)));
+	assert(equals(smoothstep(0.0f, 4.0f, vec4(-1.0f, 0.0f, 2.0f, 5.0f)), vec4(0.0f, 0.0f, 0.5f, 1.0f)));
+
+	/*
+	 * The smaller vectors use the same code
+	 */
+
+	{
+		vec2 u = vec2(1.0f, -2.0f);
+		vec2 v = vec2(3.0f, 4.0f);
+
+		assert(equals(add(u, v), vec2(4.0f, 2.0f)));
+		assert(equals(min(u, v), vec2(1.0f, -2.0f)));
+		assert(equals(vabs(u), vec2(1.0f, 2.0f)));
+		assert(equals(clamp(v, 0.0f, 3.5f), vec2(3.0f, 3.5f)));
+		assert(equals(step(2.0f, v), vec2(1.0f, 1.0f)));
+	}
+
+	{
+		vec3 u = vec3(1.0f, -2.0f, 3.0f);
+		vec3 v = vec3(3.0f, 4.0f, -5.0f);
+
+		assert(equals(sub(u, v), vec3(-2.0f, -6.0f, 8.0f)));
+		assert(equals(max(u, v), vec3(3.0f, 4.0f, 3.0f)));
+		assert(equals(mix(u, v, 0.5f), vec3(2.0f, 1.0f, -1.0f)));
+		assert(equals(smoothstep(-1.0f, 1.0f, u), vec3(1.0f, 0.0f, 1.0f)));
+
+		// the padding lane stays zero, even where the same operation on a
+		// zero lane wouldn't give zero
+		const vec3 results[] = {
+			add(u, v), sub(u, v), mul(u, v), vdiv(u, v), scale(u, 2.0f), vfma(u, v, u),
+			min(u, v), max(u, v), vabs(u), mix(u, v, 0.25f),
+			clamp(vec3(0.5f), 0.25f, 1.0f), clamp(u, -3.0f, -1.0f),
+			step(-1.0f, u), smoothstep(-1.0f, 1.0f, u), smoothstep(1.0f, -1.0f, u),
+		};
+		for (size_t i = 0; i < sizeof(results) / sizeof(results[0]); i++)
+			assert(results[i]._v[3] == 0.0f);
+
+		vec3 r[2];
+		divv3_array(r, (vec3[]) { u, v }, (vec3[]) { v, u }, 2);
+		assert(r[0]._v[3] == 0.0f && r[1]._v[3] == 0.0f);
+	}
+
+	/*
+	 * Array variants, including in place
+	 */
+
+	{
+		vec4 x[3] = { a, b, vec4(0.0f) };
+		vec4 y[3] = { b, a, vec4(1.0f) };
+		vec4 r[3];
+
+		addv4_array(r, x, y, 3);
+		for (int i = 0; i < 3; i++)
+			assert(equals(r[i], add(x[i], y[i])));
+
+		mixv4_array(r, x, y, 0.25f, 3);
+		for (int i = 0; i < 3; i++)
+			assert(equals(r[i], mix(x[i], y[i], 0.25f)));
+
+		clampv4_array(x, x, 0.0f, 1.0f, 3);
+		assert(equals(x[0], vec4(1.0f, 0.0f, 1.0f, 0.0f)));
+		assert(equals(x[1], vec4(1.0f, 1.0f, 0.0f, 1.0f)));
+		assert(equals(x[2], vec4(0.0f)));
+	}
+}
+
+void
+test_sincos(void) {
+	// the documented bound is 2^-23 for |x| <= 8192
+	const double bound = 1.0 / (1 << 23);
+
+	for (int i = -100000; i <= 100000; i++) {
+		const float x = (float) i * 0.0819f;
+		vec4 s, c;
+
+		sincosv4(vec4(x, -x, x * 0.001f, x + 0.5f), &s, &c);
+
+		for (int k = 0; k < 4; k++) {
+			const double xk = (double) (k == 0 ? x : k == 1 ? -x : k == 2 ? x * 0.001f : x + 0.5f);
+
+			assert(fabs(s._v[k] - sin(xk)) <= bound);
+			assert(fabs(c._v[k] - cos(xk)) <= bound);
+		}
+	}
+
+	// the array version handles a partial last block
+	{
+		float x[7], s[7], c[7];
+
+		for (int i = 0; i < 7; i++)
+			x[i] = (float) i - 3.0f;
+
+		sincos_array(s, c, x, 7);
+
+		for (int i = 0; i < 7; i++) {
+			assert(fabs(s[i] - sin(x[i])) <= bound);
+			assert(fabs(c[i] - cos(x[i])) <= bound);
+		}
+	}
+
+	// lanes whose octant wouldn't fit in an int are NaN, and leave the others be
+	{
+		vec4 s, c;
+
+		sincosv4(vec4(INFINITY, NAN, -3e9f, 0.5f), &s, &c);
+		for (int k = 0; k < 3; k++)
+			assert(isnan(s._v[k]) && isnan(c._v[k]));
+		assert(fabs(s.w - sin(0.5)) <= bound && fabs(c.w - cos(0.5)) <= bound);
+
+		sincosv4(vec4(0x1p30f, -0x1p30f, 1e9f, 8192.0f), &s, &c);
+		for (int k = 0; k < 4; k++)
+			assert(isfinite(s._v[k]) && isfinite(c._v[k]));
+	}
+}
+
+/* The rotation matrix of a unit quaternion */
+static mat3
+mat3_from_quat(quat q) {
+	const float x = q.x, y = q.y, z = q.z, w = q.w;
+
+	return mat3(
+		1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y),
+		2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x),
+		2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y)
+	);
+}
+
+void
+test_rotations(void) {
+	enum { N = 11 };
+
+	vec3 angles[N];
+	vec3 axes[N];
+	float axis_angles[N];
+
+	for (int i = 0; i < N; i++) {
+		angles[i] = vec3(0.3f * (float) i - 1.0f, 2.0f - 0.7f * (float) i, 0.45f * (float) i);
+		axes[i] = normalize(vec3(1.0f + (float) i, -2.0f, 0.5f * (float) i));
+		axis_angles[i] = 0.9f * (float) i - 4.0f;
+	}
+
+	mat3 m3[N];
+	mat4 m4[N];
+	quat q[N];
+
+	eulerm3_array(m3, angles, N);
+	eulerm4_array(m4, angles, N);
+	eulerq_array(q, angles, N);
+
+	for (int i = 0; i < N; i++) {
+		const float sx = sinf(angles[i].x), cx = cosf(angles[i].x);
+		const float sy = sinf(angles[i].y), cy = cosf(angles[i].y);
+		const float sz = sinf(angles[i].z), cz = cosf(angles[i].z);
+
+		const mat3 rx = mat3(1.0f, 0.0f, 0.0f, 0.0f, cx, sx, 0.0f, -sx, cx);
+		const mat3 ry = mat3(cy, 0.0f, -sy, 0.0f, 1.0f, 0.0f, sy, 0.0f, cy);
+		const mat3 rz = mat3(cz, sz, 0.0f, -sz, cz, 0.0f, 0.0f, 0.0f, 1.0f);
+
+		const mat4 expected = mat4(mult(rz, mult(ry, rx)));
+
+		assert(equals(mat4(m3[i]), expected));
+		assert(equals(m4[i], expected));
+		assert(equals(mat4(mat3_from_quat(q[i])), expected));
+		assert(fabsf(length(q[i]) - 1.0f) < 1e-6f);
+	}
+
+	axis_anglem3_array(m3, axes, axis_angles, N);
+	axis_anglem4_array(m4, axes, axis_angles, N);
+	axis_angleq_array(q, axes, axis_angles, N);
+
+	for (int i = 0; i < N; i++) {
+		// the axis is left where it is, and the rotation is orthonormal
+		const vec3 a = axes[i];
+		const mat3 mt = transpose(m3[i]);
+		const vec3 ra = vec3(dot(mt.cols[0], a), dot(mt.cols[1], a), dot(mt.cols[2], a));
+
+		assert(equals(vec4(ra, 0.0f), vec4(a, 0.0f)));
+		assert(equals(mat4(mult(mt, m3[i])), mat4(1.0f)));
+		assert(fabsf(determinant(m3[i]) - 1.0f) < 1e-5f);
+
+		assert(equals(m4[i], mat4(m3[i])));
+		assert(equals(mat4(mat3_from_quat(q[i])), mat4(m3[i])));
+	}
+
+	// about the z axis, anticlockwise
+	{
+		const vec3 z = vec3(0.0f, 0.0f, 1.0f);
+		const float quarter = 1.57079632679f;
+
+		axis_anglem3_array(m3, &z, &quarter, 1);
+		assert(equals(mat4(m3[0]), mat4(mat3(
+			0.0f, 1.0f, 0.0f,
+			-1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f
+		))));
+	}
+}
+
+void
+test_profile(void) {
+	struct profile_entry entries[256];
+
+	profile_reset();
+
+	const vec4 a = vec4(1.0f);
+	const vec4 b = add(a, a);
+	vec4 c[8];
+
+	for (int i = 0; i < 10; i++)
+		c[i % 8] = add(a, b);
+
+	addv4_array(c, c, c, 8);
+	assert(c[0].x == 6.0f);
+
+	const size_t n = profile_snapshot(entries, 256);
+
+#ifdef MATRIX_PROFILE
+	uint64_t add_calls = 0, array_calls = 0;
+
+	assert(n > 0 && n <= 256);
+
+	for (size_t i = 0; i < n; i++) {
+		if (strcmp(entries[i].name, "addv4") == 0)
+			add_calls = entries[i].calls;
+		if (strcmp(entries[i].name, "addv4_array") == 0)
+			array_calls = entries[i].calls;
+
+		// most expensive first
+		assert(i == 0 || entries[i - 1].cycles >= entries[i].cycles);
+	}
+
+	// the array variant calls addv4 for each element
+	assert(add_calls == 1 + 10 + 8);
+	assert(array_calls == 1);
+
+	profile_reset();
+	profile_snapshot(entries, 256);
+	assert(entries[0].calls == 0 && entries[0].cycles == 0);
+#else
+	assert(n == 0);
+#endif
+}
+
+void
+test_alloc(void) {
+	mat4 *m = alloc_array(mat4, 3);
+	assert(m != NULL && (uintptr_t) m % ALLOC_ALIGNMENT == 0);
+	m[2] = mat4(1.0f);
+	alloc_free(m);
+
+	m = alloc_array(mat4, SIZE_MAX / 2);
+	assert(m == NULL);
+
+	struct arena a;
+	int err = arena_init(&a, 1024);
+	assert(err == 0);
+
+	// each allocation starts on its own cache line
+	vec3 *v = arena_array(&a, vec3, 1);
+	vec4 *w = arena_array(&a, vec4, 5);
+	assert((uintptr_t) v % ALLOC_ALIGNMENT == 0 && (uintptr_t) w % ALLOC_ALIGNMENT == 0);
+	assert((unsigned char *) w - (unsigned char *) v == ALLOC_ALIGNMENT);
+	assert(a.used == 3 * ALLOC_ALIGNMENT);
+
+	// full, and it stays so
+	void *q = arena_alloc(&a, 1024);
+	assert(q == NULL);
+	q = arena_alloc(&a, SIZE_MAX);
+	assert(q == NULL);
+	q = arena_array(&a, mat4, SIZE_MAX / 8);
+	assert(q == NULL);
+	q = arena_alloc(&a, 1024 - 3 * ALLOC_ALIGNMENT);
+	assert(q != NULL);
+	q = arena_alloc(&a, 1);
+	assert(q == NULL);
+	assert(a.used == 1024 && a.peak == 1024);
+
+	// the next frame starts again from the front, keeping the peak
+	arena_reset(&a);
+	q = arena_array(&a, vec3, 1);
+	assert(q == v);
+	assert(a.used == ALLOC_ALIGNMENT && a.peak == 1024);
+
+	arena_destroy(&a);
+
+	struct pool p;
+	err = pool_init(&p, sizeof(mat4), 3);
+	assert(err == 0);
+
+	mat4 *p0 = pool_alloc(&p), *p1 = pool_alloc(&p), *p2 = pool_alloc(&p);
+	q = pool_alloc(&p);
+	assert(p0 != NULL && p1 != NULL && p2 != NULL && q == NULL);
+	assert((uintptr_t) p1 % ALLOC_ALIGNMENT == 0 && p1 != p0 && p2 != p1);
+	assert(p.used == 3 && p.peak == 3);
+
+	// freed objects come back, most recent first
+	pool_free(&p, p1);
+	pool_free(&p, p0);
+	assert(p.used == 1 && p.peak == 3);
+	q = pool_alloc(&p);
+	assert(q == p0);
+	q = pool_alloc(&p);
+	assert(q == p1);
+
+	pool_destroy(&p);
+}
+
+void
+test_trs(void) {
+	enum { N = 6 };
+
+	const vec3 angles[N] = {
+		vec3(0.0f, 0.0f, 0.0f),
+		vec3(0.3f, -1.2f, 2.0f),
+		vec3(3.14159265f, 0.0f, 0.0f),  // half turns, where w is about 0
+		vec3(0.0f, 3.14159265f, 1.0f),
+		vec3(-2.5f, 0.7f, -3.0f),
+		vec3(1.0f, 1.5f, 0.25f),
+	};
+	const vec3 scales[N] = {
+		vec3(1.0f, 1.0f, 1.0f),
+		vec3(2.0f, 0.5f, 3.0f),
+		vec3(1.0f, 4.0f, 1.0f),
+		vec3(0.25f, 0.25f, 0.25f),
+		vec3(-2.0f, 1.0f, 3.0f),        // a reflection
+		vec3(10.0f, 1e-2f, 1.0f),
+	};
+
+	struct trs src[N], back[N];
+	quat q[N];
+	mat4 r[N], m[N], again[N];
+
+	eulerq_array(q, angles, N);
+	eulerm4_array(r, angles, N);
+
+	for (int i = 0; i < N; i++)
+		src[i] = (struct trs) { vec3(i, -2.0f * i, 0.5f), q[i], scales[i] };
+
+	trs_compose_array(m, src, N);
+
+	for (int i = 0; i < N; i++) {
+		const mat4 t = mat4(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			src[i].translation.x, src[i].translation.y, src[i].translation.z, 1.0f
+		);
+		const mat4 scale = mat4(
+			src[i].scale.x, 0.0f, 0.0f, 0.0f,
+			0.0f, src[i].scale.y, 0.0f, 0.0f,
+			0.0f, 0.0f, src[i].scale.z, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f
+		);
+
+		assert(equals(m[i], mult(t, mult(r[i], scale))));
+	}
+
+	// the affine form is the top three rows
+	float affine[12 * N + 1], rows[12 * N];
+	trs_compose_affine_array(affine + 1, src, N);
+	to_row_major_affinem4_array(rows, m, N);
+	assert(memcmp(affine + 1, rows, sizeof(rows)) == 0);
+
+	// and back again
+	trs_decompose_array(back, m, N);
+
+	for (int i = 0; i < N; i++) {
+		const vec3 dt = sub(back[i].translation, src[i].translation);
+		const vec3 ds = sub(back[i].scale, src[i].scale);
+
+		assert(dot(dt, dt) < 1e-10f && dot(ds, ds) < 1e-10f);
+		assert(back[i].rotation.w >= 0.0f && back[i].scale._v[3] == 0.0f);
+
+		// q and -q are the same rotation
+		assert(fabsf(fabsf(dot(back[i].rotation, src[i].rotation)) - 1.0f) < 1e-6f);
+	}
+
+	// to within rounding of the largest scale
+	trs_compose_array(again, back, N);
+	for (int i = 0; i < N; i++)
+		for (int c = 0; c < 4; c++)
+			for (int k = 0; k < 4; k++)
+				assert(fabsf(again[i].cols[c]._v[k] - m[i].cols[c]._v[k]) < 1e-6f * 10.0f);
+
+	// a zero scale loses its axis but nothing else
+	src[0].scale = vec3(0.0f, 1.0f, 1.0f);
+	trs_compose_array(m, src, 1);
+	trs_decompose_array(back, m, 1);
+	assert(back[0].scale.x == 0.0f && isfinite(back[0].rotation.x));
+	trs_compose_array(again, back, 1);
+	assert(equals(again[0], m[0]));
+}
+
+void
+test_transforms(void) {
+	enum { COUNT = 6 };
+	struct transforms t;
+	struct transforms_handle h[COUNT];
+
+	int err = transforms_init(&t, COUNT);
+	assert(err == 0);
+
+	for (int i = 0; i < COUNT; i++) {
+		h[i] = transforms_add(&t, vec3((float) i, 0.0f, 0.0f), vec4(0.0f, 0.0f, 0.0f, 1.0f), vec3(1.0f));
+		assert(h[i].generation != 0 && transforms_index(&t, h[i]) == (size_t) i);
+	}
+
+	// full
+	errno = 0;
+	const struct transforms_handle full = transforms_add(&t, vec3(0.0f), vec4(0.0f), vec3(0.0f));
+	assert(full.generation == 0 && errno == ENOMEM);
+
+	// removing 1 moves the last into its place, and leaves the others alone
+	err = transforms_remove(&t, h[1]);
+	assert(err == 0);
+	assert(t.count == COUNT - 1);
+	assert(!transforms_valid(&t, h[1]) && transforms_index(&t, h[1]) == SIZE_MAX);
+	assert(transforms_index(&t, h[COUNT - 1]) == 1 && t.translation[1].x == COUNT - 1);
+	assert(transforms_index(&t, h[2]) == 2 && t.translation[2].x == 2.0f);
+
+	errno = 0;
+	err = transforms_remove(&t, h[1]);
+	assert(err == -1 && errno == EINVAL);
+	err = transforms_remove(&t, (struct transforms_handle) { 0 });
+	assert(err == -1);
+
+	// the slot is reused, but the old handle stays stale
+	const struct transforms_handle again = transforms_add(&t, vec3(9.0f), vec4(0.0f, 0.0f, 0.0f, 1.0f), vec3(2.0f));
+	assert(again.slot == h[1].slot && again.generation != h[1].generation);
+	assert(!transforms_valid(&t, h[1]) && transforms_index(&t, again) == COUNT - 1);
+
+	for (size_t i = 0; i < t.count; i++) {
+		const struct transforms_handle hi = transforms_handle_at(&t, i);
+		assert(transforms_index(&t, hi) == i);
+	}
+
+	// the world matrices are those of trs_compose_array
+	for (size_t i = 0; i < t.count; i++) {
+		const float a = 0.3f * (float) i;
+		t.rotation[i] = vec4(sinf(a) * 0.6f, 0.0f, sinf(a) * 0.8f, cosf(a));
+		t.scale[i] = vec3(1.0f + (float) i, 2.0f, 0.5f);
+	}
+	transforms_update(&t);
+
+	struct trs trs[COUNT];
+	mat4 expected[COUNT];
+	for (size_t i = 0; i < t.count; i++)
+		trs[i] = (struct trs) { t.translation[i], t.rotation[i], t.scale[i] };
+	trs_compose_array(expected, trs, t.count);
+
+	for (size_t i = 0; i < t.count; i++)
+		assert(equals(t.world[i], expected[i]));
+
+	// remove everything, in an awkward order
+	const struct transforms_handle order[] = { h[0], again, h[3], h[5], h[2], h[4] };
+	for (int i = 0; i < COUNT; i++) {
+		err = transforms_remove(&t, order[i]);
+		assert(err == 0);
+		for (int j = i + 1; j < COUNT; j++)
+			assert(transforms_valid(&t, order[j]));
+	}
+	assert(t.count == 0);
+
+	transforms_destroy(&t);
+}
+
+void
+test_anim(void) {
+	const float half = 0.70710678f;
+	const float times[3] = { 0.0f, 1.0f, 2.0f };
+	const vec4 moves[3] = { vec4(0.0f), vec4(2.0f, 0.0f, 0.0f, 0.0f), vec4(2.0f, 4.0f, 0.0f, 0.0f) };
+	const vec4 turn[2] = { vec4(0.0f, 0.0f, 0.0f, 1.0f), vec4(0.0f, 0.0f, half, half) };   // 90 degrees about z
+	const vec4 back_turn[2] = { vec4(0.0f, 0.0f, 0.0f, 1.0f), vec4(0.0f, 0.0f, -half, -half) };
+	const vec4 grow[2] = { vec4(1.0f, 1.0f, 1.0f, 0.0f), vec4(3.0f, 1.0f, 1.0f, 0.0f) };
+
+	for (int how = ANIM_NLERP; how <= ANIM_SLERP; how++) {
+		struct anim_clip clip;
+		struct trs pose[5];
+		mat4 m[5];
+
+		int err = anim_clip_init(&clip, 5, 16, how);
+		assert(err == 0);
+		err = anim_clip_track(&clip, 0, ANIM_TRANSLATION, times, moves, 3);
+		assert(err == 0);
+		err = anim_clip_track(&clip, 0, ANIM_ROTATION, times, turn, 2);
+		assert(err == 0);
+		err = anim_clip_track(&clip, 3, ANIM_SCALE, times + 1, grow, 2);
+		assert(err == 0);
+		err = anim_clip_track(&clip, 4, ANIM_ROTATION, times, back_turn, 2);
+		assert(err == 0);
+
+		// a track only gets one set of keys, and the clip has only so much room
+		err = anim_clip_track(&clip, 0, ANIM_TRANSLATION, times, moves, 3);
+		assert(err == -1);
+		err = anim_clip_track(&clip, 1, ANIM_TRANSLATION, times, moves, 8);
+		assert(err == -1);
+		err = anim_clip_track(&clip, 5, ANIM_TRANSLATION, times, moves, 1);
+		assert(err == -1);
+
+		anim_sample_trs(&clip, 0.5f, pose);
+
+		const vec4 eighth = vec4(0.0f, 0.0f, 0.38268343f, 0.92387953f);   // 45 degrees about z
+
+		assert(equals(pose[0].translation, vec3(1.0f, 0.0f, 0.0f)));
+		assert(equals(pose[0].rotation, eighth));
+		assert(equals(pose[0].scale, vec3(1.0f)));
+
+		// no keys is the identity, and before the first key is the first
+		for (int i = 1; i < 4; i++) {
+			assert(equals(pose[i].translation, vec3(0.0f)));
+			assert(equals(pose[i].rotation, vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+			assert(equals(pose[i].scale, vec3(1.0f)));
+		}
+
+		// the short way round, though the key was given as -q
+		assert(equals(pose[4].rotation, eighth) || equals(pose[4].rotation, scale(eighth, -1.0f)));
+
+		anim_sample_mat4(&clip, 0.5f, m);
+		for (int i = 0; i < 5; i++) {
+			mat4 expected;
+			trs_compose_array(&expected, &pose[i], 1);
+			assert(equals(m[i], expected));
+		}
+
+		// forwards a key at a time, past the end, then back to the start
+		anim_sample_trs(&clip, 1.5f, pose);
+		assert(equals(pose[0].translation, vec3(2.0f, 2.0f, 0.0f)));
+		assert(equals(pose[3].scale, vec3(2.0f, 1.0f, 1.0f)));
+		assert(clip.cursor[ANIM_TRANSLATION] == 1);
+
+		anim_sample_trs(&clip, 7.0f, pose);
+		assert(equals(pose[0].translation, vec3(2.0f, 4.0f, 0.0f)));
+		assert(equals(pose[0].rotation, turn[1]));
+		assert(equals(pose[3].scale, vec3(3.0f, 1.0f, 1.0f)));
+		assert(clip.cursor[ANIM_TRANSLATION] == 2);
+
+		anim_sample_trs(&clip, 0.25f, pose);
+		assert(equals(pose[0].translation, vec3(0.5f, 0.0f, 0.0f)));
+		assert(clip.cursor[ANIM_TRANSLATION] == 0);
+
+		// slerp turns at a constant rate, nlerp a little faster in the middle
+		const float angle = 2.0f * atan2f(pose[0].rotation.z, pose[0].rotation.w);
+		const float expected = 3.14159265f / 8.0f;
+
+		assert(fabsf(length(pose[0].rotation) - 1.0f) < 1e-6f);
+		if (how == ANIM_SLERP)
+			assert(fabsf(angle - expected) < 1e-6f);
+		else
+			assert(angle < expected && angle > expected * 0.9f);
+
+		anim_clip_destroy(&clip);
+	}
+}
+
+void
+test_mapfile(void) {
+	const char *path = "test_mapfile.bin";
+
+	mat4 m[3];
+	for (int i = 0; i < 3; i++)
+		m[i] = mat4((float) i);
+
+	const vec3 v[2] = { vec3(1.0f, 2.0f, 3.0f), vec3(4.0f, 5.0f, 6.0f) };
+
+	struct mapfile mf;
+
+	int err = mapfile_write(path, MAPFILE_MAT4, m, 3);
+	assert(err == 0);
+	err = mapfile_open(path, &mf);
+	assert(err == 0);
+	assert(mf.type == MAPFILE_MAT4 && mf.count == 3);
+	assert(mapfile_data(&mf, MAPFILE_VEC4) == NULL);
+
+	mat4 *mapped = mapfile_data(&mf, MAPFILE_MAT4);
+	assert((uintptr_t) mapped % MAPFILE_ALIGNMENT == 0);
+
+	for (int i = 0; i < 3; i++)
+		assert(equals(mapped[i], m[i]));
+
+	// the mapping is private, so writing to it leaves the file alone
+	mapped[0] = mat4(9.0f);
+	mapfile_close(&mf);
+
+	err = mapfile_open(path, &mf);
+	assert(err == 0);
+	assert(equals(((mat4 *) mf.data)[0], m[0]));
+	mapfile_close(&mf);
+
+	// vec3 keeps its padding lane, so it can be used in place too
+	err = mapfile_write(path, MAPFILE_VEC3, v, 2);
+	assert(err == 0);
+	err = mapfile_open(path, &mf);
+	assert(err == 0);
+	const vec3 *mv = mapfile_data(&mf, MAPFILE_VEC3);
+	assert(mf.count == 2 && equals(mv[1], v[1]));
+	mapfile_close(&mf);
+
+	// replacing a file leaves an existing mapping of it alone
+	err = mapfile_open(path, &mf);
+	assert(err == 0);
+	err = mapfile_write(path, MAPFILE_MAT4, m, 3);
+	assert(err == 0);
+	assert(mf.count == 2 && equals(((const vec3 *) mf.data)[1], v[1]));
+	mapfile_close(&mf);
+
+	// an empty array is fine
+	err = mapfile_write(path, MAPFILE_VEC2, NULL, 0);
+	assert(err == 0);
+	err = mapfile_open(path, &mf);
+	assert(err == 0);
+	assert(mf.count == 0);
+	mapfile_close(&mf);
+
+	// a truncated file is refused
+	err = mapfile_write(path, MAPFILE_MAT4, m, 3);
+	assert(err == 0);
+	FILE *f = fopen(path, "r+b");
+	assert(f != NULL);
+	struct mapfile_header header;
+	size_t items = fread(&header, sizeof(header), 1, f);
+	assert(items == 1);
+	header.count = 4;
+	rewind(f);
+	items = fwrite(&header, sizeof(header), 1, f);
+	assert(items == 1);
+	fclose(f);
+
+	errno = 0;
+	err = mapfile_open(path, &mf);
+	assert(err == -1 && errno == EINVAL);
+
+	// as is a file of the other byte order
+	f = fopen(path, "r+b");
+	assert(f != NULL);
+	header.count = 3;
+	header.byte_order = __builtin_bswap32(MAPFILE_BYTE_ORDER);
+	items = fwrite(&header, sizeof(header), 1, f);
+	assert(items == 1);
+	fclose(f);
+
+	errno = 0;
+	err = mapfile_open(path, &mf);
+	assert(err == -1 && errno == EINVAL);
+
+	// and one whose elements would start inside the header
+	f = fopen(path, "r+b");
+	assert(f != NULL);
+	header.byte_order = MAPFILE_BYTE_ORDER;
+	header.data_offset = 0;
+	items = fwrite(&header, sizeof(header), 1, f);
+	assert(items == 1);
+	fclose(f);
+
+	errno = 0;
+	err = mapfile_open(path, &mf);
+	assert(err == -1 && errno == EINVAL);
+
+	// and ones whose elements wouldn't be aligned: an alignment that isn't a
+	// power of two, and an offset that is only a multiple of the alignment
+	const uint32_t misaligned[][2] = { { 96, 192 }, { 100, 100 } };
+	for (int i = 0; i < 2; i++) {
+		f = fopen(path, "r+b");
+		assert(f != NULL);
+		header.alignment = misaligned[i][0];
+		header.data_offset = misaligned[i][1];
+		header.count = 1;
+		items = fwrite(&header, sizeof(header), 1, f);
+		assert(items == 1);
+		fclose(f);
+
+		errno = 0;
+		err = mapfile_open(path, &mf);
+		assert(err == -1 && errno == EINVAL);
+	}
+
+	remove(path);
+
+	err = mapfile_open(path, &mf);
+	assert(err == -1 && errno == ENOENT);
+}
+
+#define SNAPSHOT_FRAMES 200000
+#define SNAPSHOT_COUNT 64
+
+static void *
+snapshot_writer(void *arg) {
+	struct snapshot *s = arg;
+
+	for (uint64_t frame = 1; frame <= SNAPSHOT_FRAMES; frame++) {
+		mat4 *m = snapshot_write_buffer(s);
+
+		for (int i = 0; i < SNAPSHOT_COUNT; i++)
+			m[i] = mat4((float) frame);
+
+		const uint64_t published = snapshot_publish(s);
+		assert(published == frame);
+	}
+
+	return NULL;
+}
+
+void
+test_snapshot(void) {
+	struct snapshot s;
+	int err = snapshot_init(&s, sizeof(mat4), SNAPSHOT_COUNT);
+	assert(err == 0);
+
+	// nothing published yet
+	const mat4 *m = snapshot_acquire(&s);
+	assert(snapshot_frame(&s) == 0 && equals(m[0], mat4(vec4(0.0f), vec4(0.0f), vec4(0.0f), vec4(0.0f))));
+
+	// the reader sees the newest frame, skipping the ones before
+	for (int frame = 1; frame <= 3; frame++) {
+		mat4 *w = snapshot_write_buffer(&s);
+		w[0] = mat4((float) frame);
+		snapshot_publish(&s);
+	}
+
+	m = snapshot_acquire(&s);
+	assert(snapshot_frame(&s) == 3 && m[0].cols[0].x == 3.0f);
+	const mat4 *again = snapshot_acquire(&s);
+	assert(again == m && snapshot_frame(&s) == 3);
+
+	snapshot_destroy(&s);
+
+	// race a writer against the reader: every frame read must be whole
+	err = snapshot_init(&s, sizeof(mat4), SNAPSHOT_COUNT);
+	assert(err == 0);
+
+	pthread_t writer;
+	err = pthread_create(&writer, NULL, snapshot_writer, &s);
+	assert(err == 0);
+
+	uint64_t last = 0, seen = 0;
+
+	while (last < SNAPSHOT_FRAMES) {
+		m = snapshot_acquire(&s);
+
+		const uint64_t frame = snapshot_frame(&s);
+		assert(frame >= last);
+
+		if (frame == 0)
+			continue;
+
+		for (int i = 0; i < SNAPSHOT_COUNT; i++)
+			assert(equals(m[i], mat4((float) frame)));
+
+		seen += frame != last;
+		last = frame;
+	}
+
+	err = pthread_join(writer, NULL);
+	assert(err == 0);
+	assert(seen > 0);
+
+	snapshot_destroy(&s);
+}
+
+void
+test_palette(void) {
+	enum { COUNT = 40 };
+	mat4 next[COUNT], gpu[COUNT];
+	struct palette p;
+
+	for (int i = 0; i < COUNT; i++) {
+		next[i] = mat4((float) i);
+		gpu[i] = mat4(0.0f);
+	}
+
+	int err = palette_init(&p, COUNT, 0.0f, 2);
+	assert(err == 0);
+
+	// everything is dirty the first time
+	size_t dirty = palette_update(&p, next);
+	assert(dirty == COUNT);
+	assert(p.range_count == 1 && p.ranges[0].first == 0 && p.ranges[0].count == COUNT);
+	size_t bytes = palette_copy_dirty(&p, gpu);
+	assert(bytes == COUNT * sizeof(mat4));
+	assert(memcmp(gpu, next, sizeof(next)) == 0);
+
+	// and nothing when nothing changed
+	dirty = palette_update(&p, next);
+	assert(dirty == 0 && p.range_count == 0 && p.changed == 0);
+
+	// 3 and 5 are 1 apart, so merge; 9 is 3 past 5, so doesn't; 38 and 39 are adjacent
+	const int changed[] = { 3, 5, 9, 38, 39 };
+	for (size_t i = 0; i < sizeof(changed) / sizeof(changed[0]); i++)
+		next[changed[i]].cols[2].w += 1.0f;
+
+	dirty = palette_update(&p, next);
+	assert(dirty == 3 + 1 + 2);
+	assert(p.changed == 5 && p.range_count == 3);
+	assert(p.ranges[0].first == 3 && p.ranges[0].count == 3);
+	assert(p.ranges[1].first == 9 && p.ranges[1].count == 1);
+	assert(p.ranges[2].first == 38 && p.ranges[2].count == 2);
+	bytes = palette_copy_dirty(&p, gpu);
+	assert(bytes == 6 * sizeof(mat4));
+	assert(memcmp(gpu, next, sizeof(next)) == 0);
+
+	// bitwise: -0 is a change
+	next[0].cols[1].x = -0.0f;
+	dirty = palette_update(&p, next);
+	assert(dirty == 1 && p.ranges[0].first == 0);
+
+	palette_invalidate(&p);
+	dirty = palette_update(&p, next);
+	assert(dirty == COUNT);
+
+	palette_destroy(&p);
+
+	// with a tolerance, drifts accumulate until they are big enough
+	err = palette_init(&p, COUNT, 0.01f, 0);
+	assert(err == 0);
+	palette_update(&p, next);
+
+	next[7].cols[3].x += 0.006f;
+	dirty = palette_update(&p, next);
+	assert(dirty == 0);
+	next[7].cols[3].x += 0.006f;
+	dirty = palette_update(&p, next);
+	assert(dirty == 1 && p.ranges[0].first == 7);
+	assert(equals(p.current[7], next[7]));
+
+	next[8].cols[0].y = NAN;
+	dirty = palette_update(&p, next);
+	assert(dirty == 1 && p.ranges[0].first == 8);
+
+	palette_destroy(&p);
+}
+
+static const float *depth_reference;
+
+/* Farthest first, and by index at the same depth */
+static int
+compare_back_to_front(const void *a, const void *b) {
+	const uint32_t i = *(const uint32_t *) a, j = *(const uint32_t *) b;
+	const float di = depth_reference[i], dj = depth_reference[j];
+
+	if (di != dj)
+		return di > dj ? -1 : 1;
+	return i < j ? -1 : i > j;
+}
+
+void
+test_depth(void) {
+	enum { COUNT = 1003 };
+	static vec3 positions[COUNT];
+	static float depth[COUNT];
+	static uint32_t order[COUNT], expected[COUNT];
+	struct depth_sort s;
+
+	// a camera turned and moved
+	const vec3 angles = vec3(0.2f, 0.3f, -0.1f);
+	mat4 view;
+	eulerm4_array(&view, &angles, 1);
+	view.cols[3] = vec4(-1.0f, -2.0f, -3.0f, 1.0f);
+
+	// with repeats, and on both sides of the camera
+	for (int i = 0; i < COUNT; i++)
+		positions[i] = vec3((float) (i % 17) - 8.0f, 0.5f * (float) (i % 5), (float) ((i * 7919) % 101) - 50.0f);
+
+	depth_view_array(depth, view, positions, COUNT);
+	for (int i = 0; i < COUNT; i++)
+		assert(fabsf(depth[i] + mult(view, vec4(positions[i], 1.0f)).z) < 1e-4f);
+
+	int err = depth_sort_init(&s, COUNT);
+	assert(err == 0);
+
+	depth_reference = s.depth;
+	err = depth_sort_view(&s, order, view, positions, COUNT, DEPTH_BACK_TO_FRONT);
+	assert(err == 0);
+	for (uint32_t i = 0; i < COUNT; i++)
+		expected[i] = i;
+	qsort(expected, COUNT, sizeof(expected[0]), compare_back_to_front);
+	assert(memcmp(order, expected, sizeof(order)) == 0);
+
+	// front to back is the reverse, but for the order within equal depths
+	err = depth_sort_array(&s, order, s.depth, COUNT, DEPTH_FRONT_TO_BACK);
+	assert(err == 0);
+	for (int i = 1; i < COUNT; i++) {
+		const float a = s.depth[order[i - 1]], b = s.depth[order[i]];
+		assert(a < b || (a == b && order[i - 1] < order[i]));
+	}
+
+	// signed zeros and infinities
+	const float special[] = { 0.0f, -INFINITY, 1.0f, -0.0f, INFINITY, -1e-30f, 1e-30f, -2.0f };
+	err = depth_sort_array(&s, order, special, 8, DEPTH_FRONT_TO_BACK);
+	assert(err == 0);
+	const uint32_t special_order[] = { 1, 7, 5, 3, 0, 6, 2, 4 };
+	assert(memcmp(order, special_order, sizeof(special_order)) == 0);
+
+	// all at one depth, which skips every pass
+	const float same[5] = { 2.0f, 2.0f, 2.0f, 2.0f, 2.0f };
+	err = depth_sort_array(&s, order, same, 5, DEPTH_BACK_TO_FRONT);
+	assert(err == 0);
+	for (uint32_t i = 0; i < 5; i++)
+		assert(order[i] == i);
+
+	err = depth_sort_array(&s, order, depth, 0, DEPTH_BACK_TO_FRONT);
+	assert(err == 0);
+
+	errno = 0;
+	err = depth_sort_array(&s, order, depth, COUNT + 1, DEPTH_BACK_TO_FRONT);
+	assert(err == -1 && errno == EINVAL);
+
+	depth_sort_destroy(&s);
+}
+
+/* In degrees */
+static float
+angle_between(vec3 a, vec3 b) {
+	return atan2f(length(cross(a, b)), dot(a, b)) * 57.2957795f;
+}
+
+void
+test_normal(void) {
+	enum { COUNT = 4099 };
+	static vec3 n[COUNT], decoded[COUNT];
+	static vec4 t[COUNT], decoded_t[COUNT];
+	static int16_t codes[COUNT * 4];
+
+	const struct {
+		enum normal_format format;
+		size_t size;
+		float bound, tangent_bound;
+	} formats[] = {
+		{ NORMAL_OCT16, 4, 0.004f, 0.006f },
+		{ NORMAL_OCT8, 2, 1.0f, 1.5f },
+		{ NORMAL_SNORM16, 8, 0.002f, 0.002f },
+		{ NORMAL_SNORM8, 4, 0.4f, 0.4f },
+	};
+
+	// a spiral over the sphere, and then the axes, which sit on the folds
+	for (int i = 0; i < COUNT - 6; i++) {
+		const float z = 1.0f - 2.0f * ((float) i + 0.5f) / (float) (COUNT - 6);
+		const float r = sqrtf(1.0f - z * z), a = 2.39996323f * (float) i;
+		n[i] = vec3(r * cosf(a), r * sinf(a), z);
+	}
+	for (int i = 0; i < 6; i++) {
+		n[COUNT - 6 + i] = vec3(0.0f);
+		n[COUNT - 6 + i]._v[i / 2] = i % 2 ? -1.0f : 1.0f;
+	}
+	for (int i = 0; i < COUNT; i++)
+		t[i] = vec4(n[i], i % 3 ? 1.0f : -1.0f);
+
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+		assert(normal_size(formats[f].format) == formats[f].size);
+
+		normal_encode_array(codes, formats[f].format, n, COUNT);
+		normal_decode_array(decoded, formats[f].format, codes, COUNT);
+		for (int i = 0; i < COUNT; i++) {
+			assert(angle_between(n[i], decoded[i]) < formats[f].bound);
+			assert(fabsf(length(decoded[i]) - 1.0f) < 1e-6f && decoded[i]._v[3] == 0.0f);
+		}
+
+		normal_encode_tangent_array(codes, formats[f].format, t, COUNT);
+		normal_decode_tangent_array(decoded_t, formats[f].format, codes, COUNT);
+		for (int i = 0; i < COUNT; i++) {
+			assert(angle_between(vec3(t[i]), vec3(decoded_t[i])) < formats[f].tangent_bound);
+			assert(decoded_t[i].w == t[i].w);
+		}
+	}
+
+	// the axes are exact
+	normal_encode_array(codes, NORMAL_OCT8, &n[COUNT - 6], 6);
+	normal_decode_array(decoded, NORMAL_OCT8, codes, 6);
+	for (int i = 0; i < 6; i++)
+		assert(equals(decoded[i], n[COUNT - 6 + i]));
+
+	// every 8-bit octahedral code decodes to a unit vector, which encodes back
+	// to the same direction; codes on the folds alias their mirror images
+	static int8_t all[65536][2];
+	static vec3 v[65536], again[65536];
+
+	for (int i = 0; i < 65536; i++) {
+		all[i][0] = (int8_t) (i & 0xff);
+		all[i][1] = (int8_t) (i >> 8);
+	}
+	normal_decode_array(v, NORMAL_OCT8, all, 65536);
+	normal_encode_array(all, NORMAL_OCT8, v, 65536);
+	normal_decode_array(again, NORMAL_OCT8, all, 65536);
+	for (int i = 0; i < 65536; i++) {
+		assert(fabsf(length(v[i]) - 1.0f) < 1e-6f);
+		assert(angle_between(v[i], again[i]) < 0.01f);
+	}
+
+	// a zero vector is +z, in every format
+	const vec3 zero = vec3(0.0f);
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+		normal_encode_array(codes, formats[f].format, &zero, 1);
+		normal_decode_array(decoded, formats[f].format, codes, 1);
+		assert(equals(decoded[0], vec3(0.0f, 0.0f, 1.0f)));
+	}
+}
+
+struct pipeline {
+	struct trs *local;
+	mat4 *world;
+	vec4 *points;
+	vec4 *out;
+	size_t n;
+	float total;
+};
+
+static void
+pipeline_nothing(void *arg, size_t first, size_t count) {
+	(void) arg;
+	(void) first;
+	(void) count;
+}
+
+static void
+pipeline_world(void *arg, size_t first, size_t count) {
+	struct pipeline *p = arg;
+	trs_compose_array(p->world + first, p->local + first, count);
+}
+
+static void
+pipeline_transform(void *arg, size_t first, size_t count) {
+	struct pipeline *p = arg;
+	for (size_t i = first; i < first + count; i++)
+		p->out[i] = mult(p->world[i], p->points[i]);
+}
+
+static void
+pipeline_sum(void *arg, size_t first, size_t count) {
+	struct pipeline *p = arg;
+	assert(first == 0 && count == 1);
+
+	p->total = 0.0f;
+	for (size_t i = 0; i < p->n; i++)
+		p->total += p->out[i].x;
+}
+
+void
+test_jobs(void) {
+	enum { COUNT = 1000, WORLD_CHUNK = 64, TRANSFORM_CHUNK = 48 };
+	static struct trs local[COUNT];
+	static mat4 world[COUNT];
+	static vec4 points[COUNT], out[COUNT];
+
+	struct pipeline p = { local, world, points, out, COUNT, 0.0f };
+
+	for (int i = 0; i < COUNT; i++) {
+		local[i] = (struct trs) { vec3((float) i, 1.0f, 2.0f), vec4(0.0f, 0.0f, 0.0f, 1.0f), vec3(2.0f) };
+		points[i] = vec4(1.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	struct jobs_graph g;
+	jobs_graph_init(&g);
+
+	int err = jobs_access(&g, JOBS_READ, local);
+	assert(err == -1 && errno == EINVAL);
+
+	err = jobs_stage(&g, "world", pipeline_world, &p, COUNT, WORLD_CHUNK);
+	assert(err == 0);
+	err = jobs_access(&g, JOBS_READ, local);
+	assert(err == 0);
+	err = jobs_access(&g, JOBS_WRITE, world);
+	assert(err == 0);
+
+	err = jobs_stage(&g, "transform", pipeline_transform, &p, COUNT, TRANSFORM_CHUNK);
+	assert(err == 0);
+	err = jobs_access(&g, JOBS_READ, world);
+	assert(err == 0);
+	err = jobs_access(&g, JOBS_READ, points);
+	assert(err == 0);
+	err = jobs_access(&g, JOBS_WRITE, out);
+	assert(err == 0);
+
+	err = jobs_stage(&g, "sum", pipeline_sum, &p, 1, 0);
+	assert(err == 0);
+	err = jobs_access(&g, JOBS_READ | JOBS_WHOLE, out);
+	assert(err == 0);
+	err = jobs_access(&g, JOBS_WRITE, &p.total);
+	assert(err == 0);
+
+	for (int i = 0; i < JOBS_MAX_ACCESSES - 2; i++) {
+		err = jobs_access(&g, JOBS_READ, &p);
+		assert(err == 0);
+	}
+	err = jobs_access(&g, JOBS_READ, &p);
+	assert(err == -1 && errno == E2BIG);
+
+	struct jobs_pool pool;
+	err = jobs_pool_init(&pool, 4);
+	assert(err == 0);
+
+	// each point is scaled by 2 and moved along x by its index
+	const float expected = (float) COUNT * 2.0f + (float) (COUNT * (COUNT - 1) / 2);
+
+	for (int run = 0; run < 50; run++) {
+		memset(out, 0, sizeof(out));
+		err = jobs_run(&pool, &g);
+		assert(err == 0);
+		assert(p.total == expected);
+
+		const size_t world_jobs = (COUNT + WORLD_CHUNK - 1) / WORLD_CHUNK;
+		const size_t transform_jobs = (COUNT + TRANSFORM_CHUNK - 1) / TRANSFORM_CHUNK;
+		assert(g.job_count == world_jobs + transform_jobs + 1);
+
+		// no job started before the ones it depends on finished
+		uint64_t last_transform = 0;
+
+		for (size_t j = world_jobs; j < world_jobs + transform_jobs; j++) {
+			const struct jobs_trace *t = &g.trace[j];
+			assert(t->stage == 1 && t->count > 0 && t->worker < 4);
+
+			for (size_t k = t->first / WORLD_CHUNK; k <= (t->first + t->count - 1) / WORLD_CHUNK; k++)
+				assert(g.trace[k].stage == 0 && g.trace[k].end <= t->start);
+
+			last_transform = t->end > last_transform ? t->end : last_transform;
+		}
+
+		assert(g.trace[g.job_count - 1].stage == 2 && g.trace[g.job_count - 1].start >= last_transform);
+	}
+
+	// the trace is one event per job
+	FILE *f = tmpfile();
+	assert(f != NULL);
+	err = jobs_trace_write(&g, f);
+	assert(err == 0);
+	assert(ftell(f) > 0);
+	fclose(f);
+
+	// with the stage names escaped
+	struct jobs_graph quoted;
+	jobs_graph_init(&quoted);
+	err = jobs_stage(&quoted, "say \"hi\"\\\n", pipeline_nothing, NULL, 1, 0);
+	assert(err == 0);
+	err = jobs_run(&pool, &quoted);
+	assert(err == 0);
+
+	char trace[512] = { 0 };
+	f = tmpfile();
+	assert(f != NULL);
+	err = jobs_trace_write(&quoted, f);
+	assert(err == 0);
+	rewind(f);
+	const size_t got = fread(trace, 1, sizeof(trace) - 1, f);
+	assert(got > 0);
+	fclose(f);
+	assert(strstr(trace, "\"name\":\"say \\\"hi\\\"\\\\\\u000a\",") != NULL);
+
+	jobs_graph_destroy(&quoted);
+	jobs_pool_destroy(&pool);
+	jobs_graph_destroy(&g);
+}
+
+void
+test_mesh(void) {
+	// a grid of W by H vertices, two triangles to each square, and one vertex on its own
+	enum { W = 9, H = 7, VERTICES = W * H + 1, TRIANGLES = 2 * (W - 1) * (H - 1) };
+	static uint32_t indices[3 * TRIANGLES];
+	static vec3 positions[VERTICES], normals[VERTICES], expected[VERTICES], parallel[VERTICES];
+	static vec2 uvs[VERTICES];
+	static vec4 tangents[VERTICES];
+	struct mesh m;
+
+	size_t t = 0;
+	for (uint32_t y = 0; y + 1 < H; y++) {
+		for (uint32_t x = 0; x + 1 < W; x++) {
+			const uint32_t v = y * W + x;
+			const uint32_t quad[6] = { v, v + 1, v + W + 1, v, v + W + 1, v + W };
+			memcpy(&indices[3 * t], quad, sizeof(quad));
+			t += 2;
+		}
+	}
+
+	const uint32_t bad[3] = { 0, 1, VERTICES };
+	int err = mesh_init(&m, bad, 1, VERTICES, false);
+	assert(err == -1 && errno == EINVAL);
+
+	err = mesh_init(&m, indices, TRIANGLES, VERTICES, true);
+	assert(err == 0);
+	assert(m.vertex_first[VERTICES] == 3 * TRIANGLES);
+	assert(m.vertex_first[VERTICES - 1] == m.vertex_first[VERTICES]);
+
+	// flat, with u along x and v along y
+	for (int i = 0; i < VERTICES; i++) {
+		positions[i] = vec3((float) (i % W), (float) (i / W), 0.0f);
+		uvs[i] = vec2(positions[i].x, positions[i].y);
+	}
+	positions[VERTICES - 1] = vec3(0.0f, 0.0f, 1.0f);
+
+	m.positions = positions;
+	m.uvs = uvs;
+	m.normals = normals;
+	m.tangents = tangents;
+	mesh_update(&m);
+
+	for (int i = 0; i < VERTICES - 1; i++) {
+		assert(equals(normals[i], vec3(0.0f, 0.0f, 1.0f)));
+		assert(equals(tangents[i], vec4(1.0f, 0.0f, 0.0f, 1.0f)));
+	}
+
+	// the vertex on its own has no normal, but still a unit tangent
+	assert(equals(normals[VERTICES - 1], vec3(0.0f)));
+	assert(fabsf(length(vec3(tangents[VERTICES - 1])) - 1.0f) < 1e-6f);
+
+	// mirrored in u, the tangent turns around and so does w
+	for (int i = 0; i < VERTICES; i++)
+		uvs[i].x = -uvs[i].x;
+	mesh_update(&m);
+	for (int i = 0; i < VERTICES - 1; i++)
+		assert(equals(tangents[i], vec4(-1.0f, 0.0f, 0.0f, -1.0f)));
+
+	// bumpy, against adding each triangle's cross product into its corners
+	for (int i = 0; i < VERTICES - 1; i++)
+		positions[i].z = sinf(positions[i].x) * cosf(0.7f * positions[i].y);
+
+	memset(expected, 0, sizeof(expected));
+	for (size_t i = 0; i < TRIANGLES; i++) {
+		const vec3 *p0 = &positions[indices[3 * i]], *p1 = &positions[indices[3 * i + 1]], *p2 = &positions[indices[3 * i + 2]];
+		const vec3 n = cross(sub(*p1, *p0), sub(*p2, *p0));
+
+		for (int c = 0; c < 3; c++)
+			expected[indices[3 * i + c]] = add(expected[indices[3 * i + c]], n);
+	}
+
+	mesh_update(&m);
+	for (int i = 0; i < VERTICES - 1; i++) {
+		const vec3 e = normalize(expected[i]);
+		assert(fabsf(normals[i].x - e.x) < 1e-6f && fabsf(normals[i].y - e.y) < 1e-6f && fabsf(normals[i].z - e.z) < 1e-6f);
+		assert(fabsf(dot(normals[i], vec3(tangents[i]))) < 1e-6f);
+		assert(fabsf(length(vec3(tangents[i])) - 1.0f) < 1e-6f);
+	}
+
+	// the same results from the two passes as jobs, in small chunks
+	struct jobs_graph g;
+	struct jobs_pool pool;
+
+	jobs_graph_init(&g);
+	m.normals = parallel;
+	err = jobs_stage(&g, "faces", mesh_update_faces, &m, m.triangle_count, 5);
+	assert(err == 0);
+	err = jobs_access(&g, JOBS_READ | JOBS_WHOLE, m.positions);
+	assert(err == 0);
+	err = jobs_access(&g, JOBS_WRITE, m.face_normals);
+	assert(err == 0);
+	err = jobs_stage(&g, "vertices", mesh_update_vertices, &m, m.vertex_count, 6);
+	assert(err == 0);
+	err = jobs_access(&g, JOBS_READ | JOBS_WHOLE, m.face_normals);
+	assert(err == 0);
+	err = jobs_access(&g, JOBS_WRITE, m.normals);
+	assert(err == 0);
+
+	err = jobs_pool_init(&pool, 3);
+	assert(err == 0);
+	err = jobs_run(&pool, &g);
+	assert(err == 0);
+	assert(memcmp(parallel, normals, sizeof(normals)) == 0);
+
+	jobs_pool_destroy(&pool);
+	jobs_graph_destroy(&g);
+	mesh_destroy(&m);
+}
+
+/* Deterministic, and roughly uniform on [0, 1) */
+static float
+hash01(int i) {
+	const float x = sinf((float) i * 12.9898f) * 43758.5453f;
+	return x - floorf(x);
+}
+
+/* The least gap over the 15 axes, each normalized, and on which kind of axis */
+static float
+obb_reference(const struct obb *a, const struct obb *b, bool *cross_only) {
+	vec3 axes[15];
+	int count = 0;
+
+	for (int i = 0; i < 3; i++) {
+		axes[count++] = a->axes.cols[i];
+		axes[count++] = b->axes.cols[i];
+	}
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			const vec3 l = cross(a->axes.cols[i], b->axes.cols[j]);
+			if (length(l) > 1e-3f)
+				axes[count++] = normalize(l);
+		}
+	}
+
+	float least = INFINITY, least_face = INFINITY;
+	for (int k = 0; k < count; k++) {
+		float ra = 0.0f, rb = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			ra += a->half_extents._v[i] * fabsf(dot(a->axes.cols[i], axes[k]));
+			rb += b->half_extents._v[i] * fabsf(dot(b->axes.cols[i], axes[k]));
+		}
+
+		const float gap = ra + rb - fabsf(dot(sub(b->center, a->center), axes[k]));
+		least = fminf(least, gap);
+		if (k < 6)
+			least_face = fminf(least_face, gap);
+	}
+
+	*cross_only = least < 0.0f && least_face >= 0.0f;
+	return least;
+}
+
+void
+test_obb(void) {
+	enum { COUNT = 2001 };
+	static vec3 centers[COUNT], half[COUNT], angles[COUNT];
+	static mat3 axes[COUNT];
+	static bool overlap[COUNT];
+	static float depth[COUNT];
+
+	// the same box overlaps itself by its shortest width
+	const struct obb a = { vec3(0.5f, -1.0f, 2.0f), vec3(1.0f, 2.0f, 3.0f), mat3(1.0f) };
+	const struct obb_arrays same = { &a.center, &a.half_extents, &a.axes };
+
+	size_t found = obb_overlap_array(overlap, depth, &a, same, 1);
+	assert(found == 1);
+	assert(overlap[0] && fabsf(depth[0] - 2.0f) < 1e-5f);
+
+	// random boxes, against the axes worked out one by one
+	for (int i = 0; i < COUNT; i++) {
+		centers[i] = vec3(4.0f * hash01(6 * i) - 2.0f, 4.0f * hash01(6 * i + 1) - 2.0f, 4.0f * hash01(6 * i + 2) - 2.0f);
+		half[i] = vec3(0.2f + hash01(6 * i + 3), 0.2f + hash01(6 * i + 4), 0.2f + hash01(6 * i + 5));
+		angles[i] = vec3(7.0f * hash01(3 * i + 100000), 7.0f * hash01(3 * i + 100001), 7.0f * hash01(3 * i + 100002));
+	}
+	eulerm3_array(axes, angles, COUNT);
+
+	const struct obb_arrays boxes = { centers, half, axes };
+	const struct obb b = { centers[0], half[0], axes[0] };
+	int apart = 0, together = 0, cross_only = 0;
+
+	// one against many, and the many against themselves shifted by one
+	const size_t hits = obb_overlap_array(overlap, depth, &b, boxes, COUNT);
+	size_t expected_hits = 0;
+
+	for (int i = 0; i < COUNT; i++) {
+		const struct obb other = { centers[i], half[i], axes[i] };
+		bool only;
+		const float gap = obb_reference(&b, &other, &only);
+
+		expected_hits += overlap[i];
+		if (fabsf(gap) > 1e-3f)
+			assert(overlap[i] == (gap >= 0.0f));
+		assert(fabsf(depth[i] - fmaxf(gap, 0.0f)) < 1e-3f);
+	}
+	assert(hits == expected_hits);
+
+	const struct obb_arrays shifted = { centers + 1, half + 1, axes + 1 };
+	obb_overlap_pairs_array(overlap, depth, boxes, shifted, COUNT - 1);
+
+	for (int i = 0; i < COUNT - 1; i++) {
+		const struct obb first = { centers[i], half[i], axes[i] };
+		const struct obb second = { centers[i + 1], half[i + 1], axes[i + 1] };
+		bool only;
+		const float gap = obb_reference(&first, &second, &only);
+
+		if (fabsf(gap) > 1e-3f)
+			assert(overlap[i] == (gap >= 0.0f));
+		assert(fabsf(depth[i] - fmaxf(gap, 0.0f)) < 1e-3f);
+
+		apart += !overlap[i];
+		together += overlap[i];
+		cross_only += only;
+	}
+
+	// enough of each case to mean something, including separation on an edge axis alone
+	assert(apart > 100 && together > 100 && cross_only > 5);
+
+	// and without depths
+	found = obb_overlap_pairs_array(overlap, NULL, boxes, shifted, COUNT - 1);
+	assert(found == (size_t) together);
+}
+
+void
+test_stream(void) {
+	const mat4 m = mat4(
+		0.0f, 1.0f, 0.0f, 0.0f,
+		-1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		10.0f, 20.0f, 30.0f, 1.0f
+	);
+
+	vec4 v[3] = { vec4(1.0f, 2.0f, 3.0f, 1.0f), vec4(1.0f, 0.0f, 0.0f, 0.0f), vec4(0.0f) };
+	multm4v4_array(v, m, v, 3);
+	assert(equals(v[0], vec4(8.0f, 21.0f, 33.0f, 1.0f)));
+	assert(equals(v[1], vec4(0.0f, 1.0f, 0.0f, 0.0f)));
+	assert(equals(v[2], vec4(0.0f)));
+
+	// 10 points in chunks of 4, so the last chunk is short
+	float points[30], result[30];
+	for (int i = 0; i < 30; i++)
+		points[i] = (float) i;
+
+	FILE *in = tmpfile(), *out = tmpfile();
+	assert(in != NULL && out != NULL);
+	size_t items = fwrite(points, sizeof(points), 1, in);
+	assert(items == 1);
+	rewind(in);
+
+	struct stream_stats stats;
+	int err = stream_transform(in, out, m, STREAM_VEC3, 4, &stats);
+	assert(err == 0);
+	assert(stats.records == 10 && stats.bytes == sizeof(points));
+
+	rewind(out);
+	items = fread(result, sizeof(result), 1, out);
+	assert(items == 1);
+	const int c = fgetc(out);
+	assert(c == EOF);
+
+	for (int i = 0; i < 10; i++) {
+		const float *p = &points[3 * i], *r = &result[3 * i];
+		assert(r[0] == 10.0f - p[1] && r[1] == 20.0f + p[0] && r[2] == 30.0f + p[2]);
+	}
+
+	fclose(in);
+	fclose(out);
+
+	// vec4 records, a whole number of chunks and then an empty input
+	in = tmpfile(), out = tmpfile();
+	items = fwrite(points, sizeof(float), 8, in);
+	assert(items == 8);
+	rewind(in);
+
+	err = stream_transform(in, out, m, STREAM_VEC4, 1, &stats);
+	assert(err == 0);
+	assert(stats.records == 2);
+
+	rewind(out);
+	items = fread(result, sizeof(float), 8, out);
+	assert(items == 8);
+	assert(result[4] == -5.0f + 10.0f * 7.0f && result[7] == 7.0f);
+
+	err = stream_transform(in, out, m, STREAM_VEC4, 1, &stats);
+	assert(err == 0);
+	assert(stats.records == 0);
+
+	fclose(in);
+	fclose(out);
+
+	// a partial record at the end
+	in = tmpfile(), out = tmpfile();
+	items = fwrite(points, sizeof(float), 5, in);
+	assert(items == 5);
+	rewind(in);
+
+	errno = 0;
+	err = stream_transform(in, out, m, STREAM_VEC4, 0, &stats);
+	assert(err == -1 && errno == EINVAL);
+	assert(stats.records == 1);
+
+	fclose(in);
+	fclose(out);
+}
+
 int
 main(void) {
 	test_vector_constructors();
+	test_swizzle();
 
 	test_matrix_constructors();
+	test_row_major();
 	test_matrix_mult();
+	test_matrix_vector_mult();
 	test_matrix_determinant();
 	test_matrix_inverse();
+	test_mat3x2();
+	test_solve();
+	test_eigen();
+	test_orthonormalize();
 
 	test_normalize();
 	test_dot_product();
 	test_cross_product();
+
+	test_common_functions();
+
+	test_sincos();
+	test_rotations();
+	test_trs();
+	test_transforms();
+	test_anim();
+
+	test_alloc();
+	test_mapfile();
+	test_snapshot();
+	test_palette();
+	test_depth();
+	test_normal();
+	test_jobs();
+	test_mesh();
+	test_obb();
+	test_stream();
+
+	test_profile();
 }
 
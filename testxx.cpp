@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Tests of matrix.hpp, checked against the C functions it sits on, and that
+ * the other modules' headers can be used from C++.
+ */
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <type_traits>
+
+#include "matrix.hpp"
+
+#include "alloc.h"
+#include "anim.h"
+#include "depth.h"
+#include "jobs.h"
+#include "mapfile.h"
+#include "mesh.h"
+#include "normal.h"
+#include "obb.h"
+#include "palette.h"
+#include "profile.h"
+#include "snapshot.h"
+#include "stream.h"
+#include "transforms.h"
+#include "trs.h"
+
+static bool
+equals(vec4 a, vec4 b) {
+	const float eps = 1e-5f;
+
+	return std::fabs(a.x - b.x) < eps && std::fabs(a.y - b.y) < eps
+		&& std::fabs(a.z - b.z) < eps && std::fabs(a.w - b.w) < eps;
+}
+
+static bool
+equals(vec3 a, vec3 b) {
+	return equals(vec4(a, 0.0f), vec4(b, 0.0f));
+}
+
+static bool
+equals(mat4 a, mat4 b) {
+	return equals(a.cols[0], b.cols[0]) && equals(a.cols[1], b.cols[1])
+		&& equals(a.cols[2], b.cols[2]) && equals(a.cols[3], b.cols[3]);
+}
+
+static mat4
+numbered(float first) {
+	mat4 m;
+
+	for (int i = 0; i < 16; i++) {
+		m.cols[i / 4]._v[i % 4] = first + (float) i;
+	}
+	return m;
+}
+
+static void
+test_constexpr(void) {
+	constexpr mat4 id = mat4(1.0f);
+	constexpr vec4 v = vec4(vec3(vec2(1.0f, 2.0f), 3.0f), 4.0f);
+	constexpr vec4 w = id * (v * 2.0f + vec4(1.0f));
+
+	static_assert(w._v[0] == 3.0f && w._v[3] == 9.0f, "constexpr arithmetic");
+	static_assert(vec3(5.0f)._v[3] == 0.0f, "vec3 padding lane");
+	static_assert(std::is_trivially_copyable<mat4>::value, "mat4 must stay a plain C type");
+
+	constexpr mat4 twice = mat4(2.0f) * id;
+	static_assert(twice.cols[2]._v[2] == 2.0f && twice.cols[2]._v[1] == 0.0f, "constexpr product");
+}
+
+static void
+test_vector_operators(void) {
+	const vec4 a = vec4(1.0f, -2.0f, 3.0f, -4.0f);
+	const vec4 b = vec4(5.0f, 6.0f, -7.0f, 8.0f);
+
+	assert(equals(a + b, addv4(a, b)));
+	assert(equals(a - b, subv4(a, b)));
+	assert(equals(a * b, mulv4(a, b)));
+	assert(equals(a / b, divv4(a, b)));
+	assert(equals(a * 3.0f, scalev4(a, 3.0f)));
+	assert(equals(3.0f * a, scalev4(a, 3.0f)));
+	assert(equals(-a, scalev4(a, -1.0f)));
+
+	vec4 c = a;
+	c += b;
+	c *= 2.0f;
+	assert(equals(c, scalev4(addv4(a, b), 2.0f)));
+
+	assert(std::fabs(dot(a, b) - dotv4(a, b)) < 1e-6f);
+	assert(equals(min(a, b), minv4(a, b)));
+	assert(equals(abs(a), absv4(a)));
+	assert(equals(normalize(vec3(3.0f, 0.0f, 4.0f)), vec3(0.6f, 0.0f, 0.8f)));
+}
+
+static void
+test_matrix_operators(void) {
+	const mat4 p = numbered(1.0f), v = numbered(-3.0f), m = numbered(0.5f);
+	const vec4 x = vec4(1.0f, 0.5f, -2.0f, 1.0f);
+
+	const mat4 pv = p * v;
+	assert(equals(pv, multm4(p, v)));
+
+	/* Lazy products convert to a matrix, or apply to a vector right to left */
+	const mat4 pvm = p * v * m;
+	assert(equals(pvm, multm4(multm4(p, v), m)));
+	assert(equals(p * (v * m), pvm));
+	assert(equals((p * v) * (v * m), multm4(pv, multm4(v, m))));
+
+	const vec4 y = p * v * m * x;
+	assert(equals(y, multm4v4(pvm, x)));
+	assert(equals(x * p, multv4m4(x, p)));
+
+	mat4 acc = p;
+	acc *= v;
+	assert(equals(acc, pv));
+
+	assert(std::fabs(determinant(p * v) - determinantm4(pv)) < 1e-3f * std::fabs(determinantm4(pv)) + 1e-3f);
+	assert(equals(transpose(p * v), transposem4(pv)));
+}
+
+static void
+test_affine(void) {
+	constexpr mat3x2 a = mat3x2(vec2(2.0f, 1.0f), vec2(1.0f, 1.0f), vec2(3.0f, -4.0f));
+	constexpr mat3x2 b = mat3x2(vec2(0.0f, 1.0f), vec2(-1.0f, 0.0f), vec2(0.5f, 2.0f));
+	constexpr vec2 p = a * vec2(1.0f, 2.0f);
+	static_assert(p._v[0] == 7.0f && p._v[1] == -1.0f, "constexpr point transform");
+
+	const mat3x2 ab = a * b, c = multm3x2(a, b);
+	for (int i = 0; i < 3; i++) {
+		assert(equals(vec4(ab.cols[i], 0.0f, 0.0f), vec4(c.cols[i], 0.0f, 0.0f)));
+	}
+
+	const vec2 q = inverse(a) * (a * vec2(5.0f, -6.0f));
+	assert(equals(vec4(q, 0.0f, 0.0f), vec4(5.0f, -6.0f, 0.0f, 0.0f)));
+	assert(determinant(a) == 1.0f);
+}
+
+static void
+test_array_expressions(void) {
+	enum { n = 37 };
+	vec4 a[n], b[n], out[n], expected[n];
+	vec3 u[n], r3[n];
+	const mat4 p = numbered(1.0f), v = numbered(-3.0f), m = numbered(0.5f);
+
+	for (int i = 0; i < n; i++) {
+		a[i] = vec4((float) i, 1.0f - (float) i, 0.25f * (float) i, 1.0f);
+		b[i] = vec4(2.0f, (float) (i % 5), -1.0f, (float) i);
+		u[i] = vec3((float) i, 2.0f, -(float) i);
+	}
+
+	/* a * s + b */
+	glsl::view(out, n) = glsl::view(a, n) * 3.0f + glsl::view(b, n);
+	for (int i = 0; i < n; i++) {
+		assert(equals(out[i], addv4(scalev4(a[i], 3.0f), b[i])));
+	}
+
+	/* Values broadcast on either side, and unary minus */
+	glsl::view(out, n) = vec4(1.0f) - glsl::view(a, n) / 2.0f + -glsl::view(b, n);
+	for (int i = 0; i < n; i++) {
+		assert(equals(out[i], subv4(subv4(vec4(1.0f), scalev4(a[i], 0.5f)), b[i])));
+	}
+
+	/* P * V * M * v for every element */
+	const mat4 pvm = multm4(multm4(p, v), m);
+	multm4v4_array(expected, pvm, a, n);
+	glsl::view(out, n) = p * v * m * glsl::view(a, n);
+	for (int i = 0; i < n; i++) {
+		assert(equals(out[i], expected[i]));
+	}
+
+	/* Transforms compose with everything else, and views can alias */
+	glsl::array<vec4> o = glsl::view(out, n);
+	o = glsl::view(a, n);
+	o += pvm * glsl::view(b, n);
+	o *= 0.5f;
+	for (int i = 0; i < n; i++) {
+		assert(equals(out[i], scalev4(addv4(a[i], multm4v4(pvm, b[i])), 0.5f)));
+	}
+
+	/* Read-only sources and three dimensions */
+	const vec3 *cu = u;
+	glsl::view(r3, n) = mat3(2.0f) * glsl::view(cu, n) + vec3(1.0f, 0.0f, 0.0f);
+	for (int i = 0; i < n; i++) {
+		assert(equals(r3[i], vec3(2.0f * u[i].x + 1.0f, 2.0f * u[i].y, 2.0f * u[i].z)));
+	}
+}
+
+static void
+double_each(void *arg, size_t first, size_t count) {
+	float *v = static_cast<float *>(arg);
+
+	for (size_t i = first; i < first + count; i++)
+		v[i] *= 2.0f;
+}
+
+/* The structs with atomics in them, laid out by C++ and used by the C code */
+static void
+test_c_modules(void) {
+	struct snapshot s;
+	int err = snapshot_init(&s, sizeof(mat4), 4);
+	assert(err == 0);
+
+	mat4 *w = static_cast<mat4 *>(snapshot_write_buffer(&s));
+	w[3] = mat4(2.0f);
+	const uint64_t frame = snapshot_publish(&s);
+	assert(frame == 1);
+
+	const mat4 *r = static_cast<const mat4 *>(snapshot_acquire(&s));
+	assert(snapshot_frame(&s) == 1 && equals(r[3], mat4(2.0f)));
+	snapshot_destroy(&s);
+
+	float v[100];
+	for (int i = 0; i < 100; i++)
+		v[i] = static_cast<float>(i);
+
+	struct jobs_graph g;
+	jobs_graph_init(&g);
+	err = jobs_stage(&g, "double", double_each, v, 100, 7);
+	assert(err == 0);
+
+	struct jobs_pool pool;
+	err = jobs_pool_init(&pool, 3);
+	assert(err == 0);
+	err = jobs_run(&pool, &g);
+	assert(err == 0);
+	for (int i = 0; i < 100; i++)
+		assert(v[i] == 2.0f * static_cast<float>(i));
+
+	jobs_pool_destroy(&pool);
+	jobs_graph_destroy(&g);
+}
+
+int
+main(void) {
+	test_constexpr();
+	test_vector_operators();
+	test_matrix_operators();
+	test_affine();
+	test_array_expressions();
+	test_c_modules();
+
+	printf("All tests passed!\n");
+
+	return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+
+#include "alloc.h"
+#include "transforms.h"
+#include "trs.h"
+
+int
+transforms_init(struct transforms *t, size_t capacity) {
+	*t = (struct transforms) { 0 };
+
+	/* slot numbers are 32 bits, with capacity itself meaning none */
+	if (capacity >= UINT32_MAX) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	t->translation = alloc_array(vec3, capacity);
+	t->rotation = alloc_array(quat, capacity);
+	t->scale = alloc_array(vec3, capacity);
+	t->world = alloc_array(mat4, capacity);
+	t->owner = alloc_array(uint32_t, capacity);
+	t->index = alloc_array(uint32_t, capacity);
+	t->generation = alloc_array(uint32_t, capacity);
+
+	if (t->translation == NULL || t->rotation == NULL || t->scale == NULL || t->world == NULL
+			|| t->owner == NULL || t->index == NULL || t->generation == NULL) {
+		transforms_destroy(t);
+		return -1;
+	}
+
+	t->capacity = capacity;
+	t->free_slot = (uint32_t) capacity;
+
+	return 0;
+}
+
+void
+transforms_destroy(struct transforms *t) {
+	alloc_free(t->translation);
+	alloc_free(t->rotation);
+	alloc_free(t->scale);
+	alloc_free(t->world);
+	alloc_free(t->owner);
+	alloc_free(t->index);
+	alloc_free(t->generation);
+
+	*t = (struct transforms) { 0 };
+}
+
+struct transforms_handle
+transforms_add(struct transforms *t, vec3 translation, quat rotation, vec3 scale) {
+	uint32_t slot;
+
+	if (t->free_slot < t->capacity) {
+		slot = t->free_slot;
+		t->free_slot = t->index[slot];
+	} else if (t->slots < t->capacity) {
+		slot = t->slots++;
+		t->generation[slot] = 1;
+	} else {
+		errno = ENOMEM;
+		return (struct transforms_handle) { 0 };
+	}
+
+	const size_t i = t->count++;
+
+	t->translation[i] = translation;
+	t->rotation[i] = rotation;
+	t->scale[i] = scale;
+	t->world[i] = mat4(1.0f);
+	t->owner[i] = slot;
+	t->index[slot] = (uint32_t) i;
+
+	return (struct transforms_handle) { slot, t->generation[slot] };
+}
+
+int
+transforms_remove(struct transforms *t, struct transforms_handle h) {
+	const size_t i = transforms_index(t, h);
+
+	if (i == SIZE_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* the last object fills the hole */
+	const size_t last = --t->count;
+
+	if (i != last) {
+		t->translation[i] = t->translation[last];
+		t->rotation[i] = t->rotation[last];
+		t->scale[i] = t->scale[last];
+		t->world[i] = t->world[last];
+		t->owner[i] = t->owner[last];
+		t->index[t->owner[i]] = (uint32_t) i;
+	}
+
+	/* outdate the handle, skipping 0 when the generation wraps */
+	if (++t->generation[h.slot] == 0)
+		t->generation[h.slot] = 1;
+
+	t->index[h.slot] = t->free_slot;
+	t->free_slot = h.slot;
+
+	return 0;
+}
+
+bool
+transforms_valid(const struct transforms *t, struct transforms_handle h) {
+	return transforms_index(t, h) != SIZE_MAX;
+}
+
+size_t
+transforms_index(const struct transforms *t, struct transforms_handle h) {
+	/* a free slot's generation has already moved on from any handle to it */
+	if (h.slot >= t->slots || h.generation != t->generation[h.slot])
+		return SIZE_MAX;
+
+	return t->index[h.slot];
+}
+
+struct transforms_handle
+transforms_handle_at(const struct transforms *t, size_t i) {
+	const uint32_t slot = t->owner[i];
+
+	return (struct transforms_handle) { slot, t->generation[slot] };
+}
+
+void
+transforms_update(struct transforms *t) {
+	trs_compose_soa_array(t->world, t->translation, t->rotation, t->scale, t->count);
+}
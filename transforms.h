@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * A store of transforms for many objects, kept as separate contiguous arrays
+ * of each component rather than one allocation per object, so that a pass
+ * over all of them is a pass over a few arrays that the batch kernels take
+ * directly:
+ *
+ *     eulerq_array(t.rotation, angles, t.count);
+ *     transforms_update(&t);                        // t.world[i] = T * R * S
+ *     multm4v4_array(out, t.world[0], points, n);
+ *
+ * Objects hold a handle rather than a pointer or index. Removing an object
+ * moves the last one into its place to keep the arrays packed, so indices
+ * change, but handles stay valid until their own object is removed. Each
+ * handle carries the generation of its slot, which removal bumps, so a
+ * stale handle is caught rather than finding whatever took its slot.
+ *
+ *     struct transforms_handle h = transforms_add(&t, position, rotation, vec3(1.0f));
+ *     size_t i = transforms_index(&t, h);
+ *     t.translation[i] = ...;
+ */
+
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A generation of 0 is never handed out, so a zeroed handle refers to nothing */
+struct transforms_handle {
+	uint32_t slot;
+	uint32_t generation;
+};
+
+struct transforms {
+	/* count of each, index i being the same object in all of them */
+	vec3 *translation;
+	quat *rotation;
+	vec3 *scale;
+	mat4 *world;            /* as of the last transforms_update() */
+	uint32_t *owner;        /* the slot of each */
+	size_t count;
+	size_t capacity;
+
+	/* by slot: the index of its object, or the next free slot */
+	uint32_t *index;
+	uint32_t *generation;
+	uint32_t free_slot;     /* capacity when there are none */
+	uint32_t slots;         /* handed out at least once */
+};
+
+/* Room for capacity objects: 0 on success, -1 if there isn't enough memory */
+int transforms_init(struct transforms *t, size_t capacity);
+void transforms_destroy(struct transforms *t);
+
+/* A new object, at index count - 1, or a zeroed handle with errno ENOMEM if the store is full */
+struct transforms_handle transforms_add(struct transforms *t, vec3 translation, quat rotation, vec3 scale);
+
+/* 0, or -1 with errno EINVAL if the handle is stale */
+int transforms_remove(struct transforms *t, struct transforms_handle h);
+
+bool transforms_valid(const struct transforms *t, struct transforms_handle h);
+
+/* The index of the object in the arrays, which removals can change, or SIZE_MAX if the handle is stale */
+size_t transforms_index(const struct transforms *t, struct transforms_handle h);
+
+/* The handle of the object at index i */
+struct transforms_handle transforms_handle_at(const struct transforms *t, size_t i);
+
+/* Compose world from the translations, rotations and scales */
+void transforms_update(struct transforms *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "profile.h"
+#include "simd.h"
+#include "trs.h"
+
+/*
+ * Four transforms across the lanes: m[r][c] is row r, column c of each, and
+ * t, q and s the components of the translation, rotation and scale.
+ */
+
+struct trs_block {
+	v4f_t t[3], q[4], s[3];
+};
+
+struct affine_block {
+	v4f_t m[3][4];
+};
+
+/* The components of four transforms, each stride bytes after the last */
+static inline void
+load_components(struct trs_block *b, const v4f_t *t, const v4f_t *q, const v4f_t *s,
+		size_t stride, size_t count) {
+	v4f_t lanes[4];
+
+	v4f_gather(lanes, t, stride, count, v4f_splat(0.0f));
+	b->t[0] = lanes[0], b->t[1] = lanes[1], b->t[2] = lanes[2];
+
+	v4f_gather(b->q, q, stride, count, v4f_splat(0.0f));
+
+	v4f_gather(lanes, s, stride, count, v4f_splat(0.0f));
+	b->s[0] = lanes[0], b->s[1] = lanes[1], b->s[2] = lanes[2];
+}
+
+static inline void
+load_trs(struct trs_block *b, const struct trs *src, size_t count) {
+	load_components(b, &src->translation._v, &src->rotation._v, &src->scale._v, sizeof(*src), count);
+}
+
+static inline void
+store_mat4(mat4 *dst, const struct affine_block *a, size_t count) {
+	for (int c = 0; c < 4; c++) {
+		const v4f_t column[4] = { a->m[0][c], a->m[1][c], a->m[2][c], v4f_splat(c == 3 ? 1.0f : 0.0f) };
+		v4f_scatter(&dst->cols[c]._v, sizeof(mat4), column, count);
+	}
+}
+
+static inline void
+compose_block(struct affine_block *a, const struct trs_block *b) {
+	const v4f_t x = b->q[0], y = b->q[1], z = b->q[2], w = b->q[3];
+
+	const v4f_t xx = x * x, yy = y * y, zz = z * z;
+	const v4f_t xy = x * y, xz = x * z, yz = y * z;
+	const v4f_t wx = w * x, wy = w * y, wz = w * z;
+
+	a->m[0][0] = (1.0f - 2.0f * (yy + zz)) * b->s[0];
+	a->m[1][0] = 2.0f * (xy + wz) * b->s[0];
+	a->m[2][0] = 2.0f * (xz - wy) * b->s[0];
+
+	a->m[0][1] = 2.0f * (xy - wz) * b->s[1];
+	a->m[1][1] = (1.0f - 2.0f * (xx + zz)) * b->s[1];
+	a->m[2][1] = 2.0f * (yz + wx) * b->s[1];
+
+	a->m[0][2] = 2.0f * (xz + wy) * b->s[2];
+	a->m[1][2] = 2.0f * (yz - wx) * b->s[2];
+	a->m[2][2] = (1.0f - 2.0f * (xx + yy)) * b->s[2];
+
+	a->m[0][3] = b->t[0];
+	a->m[1][3] = b->t[1];
+	a->m[2][3] = b->t[2];
+}
+
+void
+trs_compose_array(mat4 *dst, const struct trs *src, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		struct trs_block b;
+		struct affine_block a;
+
+		load_trs(&b, src + i, count);
+		compose_block(&a, &b);
+		store_mat4(dst + i, &a, count);
+	}
+}
+
+void
+trs_compose_soa_array(mat4 *dst, const vec3 *translation, const quat *rotation, const vec3 *scale, size_t n) {
+	PROFILE_FUNCTION();
+
+	static_assert(sizeof(vec3) == sizeof(quat), "the components are gathered with one stride");
+
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		struct trs_block b;
+		struct affine_block a;
+
+		load_components(&b, &translation[i]._v, &rotation[i]._v, &scale[i]._v, sizeof(vec3), count);
+		compose_block(&a, &b);
+		store_mat4(dst + i, &a, count);
+	}
+}
+
+void
+trs_compose_affine_array(float *dst, const struct trs *src, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		struct trs_block b;
+		struct affine_block a;
+
+		load_trs(&b, src + i, count);
+		compose_block(&a, &b);
+
+		/* transposing a row gives that row of each of the four */
+		for (int r = 0; r < 3; r++) {
+			v4f_t m0 = a.m[r][0], m1 = a.m[r][1], m2 = a.m[r][2], m3 = a.m[r][3];
+			v4f_transpose(&m0, &m1, &m2, &m3);
+
+			const v4f_t rows[4] = { m0, m1, m2, m3 };
+			for (size_t k = 0; k < count; k++)
+				v4f_store(&dst[12 * (i + k) + 4 * r], rows[k]);
+		}
+	}
+}
+
+/*
+ * Rotation matrix to quaternion, after Shepperd: of the four ways to get it,
+ * use the one whose divisor is largest, picked per lane.
+ */
+static inline void
+quat_from_rotation(v4f_t q[4], const v4f_t m[3][4]) {
+	const v4f_t m00 = m[0][0], m11 = m[1][1], m22 = m[2][2];
+
+	/* 4 w^2, 4 x^2, 4 y^2 and 4 z^2 */
+	const v4f_t tw = 1.0f + m00 + m11 + m22;
+	const v4f_t tx = 1.0f + m00 - m11 - m22;
+	const v4f_t ty = 1.0f - m00 + m11 - m22;
+	const v4f_t tz = 1.0f - m00 - m11 + m22;
+
+	const v4f_t sum_yz = m[2][1] + m[1][2], diff_yz = m[2][1] - m[1][2];
+	const v4f_t sum_xz = m[0][2] + m[2][0], diff_xz = m[0][2] - m[2][0];
+	const v4f_t sum_xy = m[1][0] + m[0][1], diff_xy = m[1][0] - m[0][1];
+
+	/* start with w and take over where another is larger */
+	v4f_t t = tw;
+	v4f_t x = diff_yz, y = diff_xz, z = diff_xy, w = tw;
+
+	v4i_t use = tx > t;
+	t = v4f_select(use, tx, t);
+	x = v4f_select(use, tx, x);
+	y = v4f_select(use, sum_xy, y);
+	z = v4f_select(use, sum_xz, z);
+	w = v4f_select(use, diff_yz, w);
+
+	use = ty > t;
+	t = v4f_select(use, ty, t);
+	x = v4f_select(use, sum_xy, x);
+	y = v4f_select(use, ty, y);
+	z = v4f_select(use, sum_yz, z);
+	w = v4f_select(use, diff_xz, w);
+
+	use = tz > t;
+	t = v4f_select(use, tz, t);
+	x = v4f_select(use, sum_xz, x);
+	y = v4f_select(use, sum_yz, y);
+	z = v4f_select(use, tz, z);
+	w = v4f_select(use, diff_xy, w);
+
+	/* t >= 1 for a rotation; it only isn't if the matrix was all zero */
+	const v4f_t f = 0.5f / v4f_sqrt(v4f_max(t, v4f_splat(1.0f)));
+
+	/* keep w >= 0, so equal rotations give equal quaternions */
+	const v4u_t flip = (v4u_t) w & (v4u_t) v4f_splat(-0.0f);
+
+	q[0] = (v4f_t) ((v4u_t) (x * f) ^ flip);
+	q[1] = (v4f_t) ((v4u_t) (y * f) ^ flip);
+	q[2] = (v4f_t) ((v4u_t) (z * f) ^ flip);
+	q[3] = (v4f_t) ((v4u_t) (w * f) ^ flip);
+}
+
+void
+trs_decompose_array(struct trs *dst, const mat4 *src, size_t n) {
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < n; i += 4) {
+		const size_t count = BLOCK_COUNT(i, n);
+		struct affine_block a;
+		struct trs_block b;
+
+		for (int c = 0; c < 4; c++) {
+			v4f_t column[4];
+			v4f_gather(column, &src[i].cols[c]._v, sizeof(mat4), count, v4f_splat(0.0f));
+
+			for (int r = 0; r < 3; r++)
+				a.m[r][c] = column[r];
+		}
+
+		for (int r = 0; r < 3; r++)
+			b.t[r] = a.m[r][3];
+
+		for (int c = 0; c < 3; c++)
+			b.s[c] = v4f_sqrt(a.m[0][c] * a.m[0][c] + a.m[1][c] * a.m[1][c] + a.m[2][c] * a.m[2][c]);
+
+		/* a reflection goes into the x scale */
+		const v4f_t det = a.m[0][0] * (a.m[1][1] * a.m[2][2] - a.m[2][1] * a.m[1][2])
+			+ a.m[1][0] * (a.m[2][1] * a.m[0][2] - a.m[0][1] * a.m[2][2])
+			+ a.m[2][0] * (a.m[0][1] * a.m[1][2] - a.m[1][1] * a.m[0][2]);
+		b.s[0] = (v4f_t) ((v4u_t) b.s[0] | ((v4u_t) det & (v4u_t) v4f_splat(-0.0f)));
+
+		for (int c = 0; c < 3; c++) {
+			const v4f_t s = v4f_select(v4f_abs(b.s[c]) > 0.0f, b.s[c], v4f_splat(1.0f));
+
+			for (int r = 0; r < 3; r++)
+				a.m[r][c] /= s;
+		}
+
+		quat_from_rotation(b.q, a.m);
+
+		const v4f_t t[4] = { b.t[0], b.t[1], b.t[2], v4f_splat(0.0f) };
+		const v4f_t s[4] = { b.s[0], b.s[1], b.s[2], v4f_splat(0.0f) };
+
+		v4f_scatter(&dst[i].translation._v, sizeof(struct trs), t, count);
+		v4f_scatter(&dst[i].rotation._v, sizeof(struct trs), b.q, count);
+		v4f_scatter(&dst[i].scale._v, sizeof(struct trs), s, count);
+	}
+}
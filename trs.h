@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2017 Ned Hoy
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Translation, rotation and scale.
+ *
+ * The matrix of a TRS is T * R * S: it scales along the axes, then rotates,
+ * then translates. The kernels work on four transforms at once, one per lane.
+ */
+
+#ifndef TRS_H
+#define TRS_H
+
+#include <stddef.h>
+
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct trs {
+	vec3 translation;
+	quat rotation;  /* of unit length */
+	vec3 scale;
+};
+
+/* dst[i] = T * R * S */
+void trs_compose_array(mat4 *dst, const struct trs *src, size_t n);
+
+/* The same, from separate arrays of each component */
+void trs_compose_soa_array(mat4 *dst, const vec3 *translation, const quat *rotation, const vec3 *scale, size_t n);
+
+/* The same, as the 12 floats of a row-major 3x4 affine matrix each */
+void trs_compose_affine_array(float *dst, const struct trs *src, size_t n);
+
+/*
+ * Split affine matrices back up. The last row of each is ignored, and so is
+ * any shear, which a TRS can't hold.
+ *
+ * The scale is the length of each of the first three columns. A reflection
+ * can't be a rotation, so when the matrix has one the x scale is negated.
+ * Where a scale is zero the rotation about it is lost, and the rotation comes
+ * out of whatever is left. The quaternions have w >= 0.
+ */
+void trs_decompose_array(struct trs *dst, const mat4 *src, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif